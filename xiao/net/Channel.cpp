@@ -8,3 +8,97 @@
  * @copyright Copyright (c) 2024
  *
  */
+#include <xiao/net/Channel.h>
+#include <xiao/net/EventLoop.h>
+#include <assert.h>
+
+#ifdef _WIN32
+#include "Wepoll.h"
+#define POLLIN EPOLLIN
+#define POLLPRI EPOLLPRI
+#define POLLOUT EPOLLOUT
+#define POLLHUP EPOLLHUP
+#define POLLNVAL 0
+#define POLLERR EPOLLERR
+#else
+#include <poll.h>
+#endif
+
+namespace xiao
+{
+    const int Channel::xNoneEvent = 0;
+    const int Channel::xReadEvent = POLLIN | POLLPRI;
+    const int Channel::xWriteEvent = POLLOUT;
+    const int Channel::xErrorEvent = POLLERR;
+
+    Channel::Channel(EventLoop *loop, int fd)
+        : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false)
+    {
+    }
+
+    void Channel::remove()
+    {
+        assert(events_ == xNoneEvent);
+        loop_->removeChannel(this);
+    }
+
+    void Channel::update()
+    {
+        loop_->updateChannel(this);
+    }
+
+    void Channel::handleEvent()
+    {
+        if (events_ == xNoneEvent)
+            return;
+        if (tied_)
+        {
+            std::shared_ptr<void> guard = tie_.lock();
+            if (guard)
+            {
+                handleEventSafely();
+            }
+        }
+        else
+        {
+            handleEventSafely();
+        }
+    }
+
+    void Channel::handleEventSafely()
+    {
+        if (eventCallback_)
+        {
+            eventCallback_();
+            return;
+        }
+        if ((revents_ & POLLHUP) && !(revents_ & POLLIN))
+        {
+            if (closeCallback_)
+                closeCallback_();
+        }
+        if (revents_ & (POLLNVAL | POLLERR))
+        {
+            if (errorCallback_)
+                errorCallback_();
+        }
+#ifdef __linux__
+        if (revents_ & (POLLIN | POLLPRI | POLLRDHUP))
+#else
+        if (revents_ & (POLLIN | POLLPRI))
+#endif
+        {
+            if (readCallback_)
+                readCallback_();
+        }
+#ifdef _WIN32
+        if ((revents_ & POLLOUT) && !(revents_ & POLLHUP))
+#else
+        if (revents_ & POLLOUT)
+#endif
+        {
+            if (writeCallback_)
+                writeCallback_();
+        }
+    }
+} // namespace xiao
@@ -215,6 +215,39 @@ namespace xiao
             update();
         }
 
+        /**
+         * @brief Enable the error event on the socket. It keeps the socket in
+         * the poller when no other event is enabled, e.g. to read the
+         * completions of MSG_ZEROCOPY sends from the error queue.
+         *
+         */
+        void enableErrorEvent()
+        {
+            events_ |= xErrorEvent;
+            update();
+        }
+
+        /**
+         * @brief Disable the error event on the socket.
+         *
+         */
+        void disableErrorEvent()
+        {
+            events_ &= ~xErrorEvent;
+            update();
+        }
+
+        /**
+         * @brief Check whether the error event is enabled on the socket.
+         *
+         * @return true
+         * @return false
+         */
+        bool isWatchingErrors() const
+        {
+            return events_ & xErrorEvent;
+        }
+
         /**
          * @brief Check whether the write event is enabled on the socket.
          *
@@ -237,6 +270,37 @@ namespace xiao
             return events_ & xReadEvent;
         }
 
+        /**
+         * @brief Set the events that occurred on the socket. This method is
+         * usually used by the poller.
+         *
+         * @param revt
+         */
+        void setRevents(int revt)
+        {
+            revents_ = revt;
+        }
+
+        /**
+         * @brief Return the state of the channel in the poller.
+         *
+         * @return int
+         */
+        int index()
+        {
+            return index_;
+        }
+
+        /**
+         * @brief Set the state of the channel in the poller.
+         *
+         * @param index
+         */
+        void setIndex(int index)
+        {
+            index_ = index;
+        }
+
         /**
          * @brief Set and update the events enabled.
          *
@@ -266,8 +330,22 @@ namespace xiao
         static const int xNoneEvent;
         static const int xReadEvent;
         static const int xWriteEvent;
+        static const int xErrorEvent;
 
     private:
+        friend class EventLoop;
+        friend class TcpConnectionImpl;
+        // Reuse the channel for another fd, it must not be in the poller.
+        void resetFd(int fd)
+        {
+            fd_ = fd;
+            events_ = 0;
+            revents_ = 0;
+            tie_.reset();
+            tied_ = false;
+        }
+        void handleEvent();
+        void handleEventSafely();
         void update();
         EventLoop *loop_;
         EventCallback readCallback_;
@@ -275,7 +353,7 @@ namespace xiao
         EventCallback closeCallback_;
         EventCallback errorCallback_;
         EventCallback eventCallback_;
-        const int fd_;
+        int fd_;
         int events_;
         int revents_;
         int index_;
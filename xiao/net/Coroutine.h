@@ -0,0 +1,527 @@
+/**
+ * @file Coroutine.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#include <xiao/net/EventLoop.h>
+#include <xiao/net/Channel.h>
+#include <xiao/utils/Logger.h>
+#include <assert.h>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace xiao
+{
+    template <typename T = void>
+    class Task;
+
+    namespace internal
+    {
+        /**
+         * @brief The part of the promise shared by all the tasks, it resumes the
+         * awaiting coroutine when the task finishes.
+         *
+         */
+        class TaskPromiseBase
+        {
+        public:
+            struct FinalAwaiter
+            {
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(
+                    std::coroutine_handle<Promise> handle) noexcept
+                {
+                    auto &promise = handle.promise();
+                    if (promise.continuation_)
+                        return promise.continuation_;
+                    if (promise.detached_)
+                    {
+                        if (promise.exception_)
+                        {
+                            LOG_ERROR << "Unhandled exception in a detached "
+                                         "coroutine";
+                        }
+                        handle.destroy();
+                    }
+                    return std::noop_coroutine();
+                }
+                void await_resume() const noexcept
+                {
+                }
+            };
+
+            std::suspend_always initial_suspend() const noexcept
+            {
+                return {};
+            }
+            FinalAwaiter final_suspend() const noexcept
+            {
+                return {};
+            }
+            void unhandled_exception() noexcept
+            {
+                exception_ = std::current_exception();
+            }
+
+            std::coroutine_handle<> continuation_;
+            std::exception_ptr exception_;
+            bool detached_{false};
+        };
+
+        template <typename T>
+        class TaskPromise : public TaskPromiseBase
+        {
+        public:
+            Task<T> get_return_object() noexcept;
+            template <typename U>
+            void return_value(U &&value)
+            {
+                value_.emplace(std::forward<U>(value));
+            }
+            T result()
+            {
+                if (exception_)
+                    std::rethrow_exception(exception_);
+                return std::move(*value_);
+            }
+
+        private:
+            std::optional<T> value_;
+        };
+
+        template <>
+        class TaskPromise<void> : public TaskPromiseBase
+        {
+        public:
+            Task<void> get_return_object() noexcept;
+            void return_void() const noexcept
+            {
+            }
+            void result()
+            {
+                if (exception_)
+                    std::rethrow_exception(exception_);
+            }
+        };
+    } // namespace internal
+
+    /**
+     * @brief This class template represents a lazy coroutine, it starts when it
+     * is awaited or spawned on an event loop. The awaitables in this file
+     * resume the coroutine in the thread of an event loop, so the code between
+     * two suspensions runs in the loop that owns the coroutine, as a callback
+     * would.
+     *
+     * @code
+       xiao::Task<> echo(xiao::EventLoop *loop, int fd)
+       {
+           char buf[4096];
+           while (true)
+           {
+               co_await xiao::readable(loop, fd);
+               auto n = ::read(fd, buf, sizeof(buf));
+               if (n <= 0)
+                   break;
+               ...
+           }
+       }
+       xiao::spawn(loop, echo(loop, fd));
+       @endcode
+     */
+    template <typename T>
+    class Task : NonCopyable
+    {
+    public:
+        using promise_type = internal::TaskPromise<T>;
+        using Handle = std::coroutine_handle<promise_type>;
+
+        explicit Task(Handle handle) noexcept : handle_(handle)
+        {
+        }
+        Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr))
+        {
+        }
+        Task &operator=(Task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (handle_)
+                    handle_.destroy();
+                handle_ = std::exchange(other.handle_, nullptr);
+            }
+            return *this;
+        }
+        ~Task()
+        {
+            if (handle_)
+                handle_.destroy();
+        }
+
+        auto operator co_await() && noexcept
+        {
+            struct Awaiter
+            {
+                Handle handle_;
+                bool await_ready() const noexcept
+                {
+                    return !handle_ || handle_.done();
+                }
+                std::coroutine_handle<> await_suspend(
+                    std::coroutine_handle<> awaiting) noexcept
+                {
+                    handle_.promise().continuation_ = awaiting;
+                    return handle_;
+                }
+                T await_resume()
+                {
+                    return handle_.promise().result();
+                }
+            };
+            return Awaiter{handle_};
+        }
+
+        /**
+         * @brief Give up the ownership of the coroutine, it destroys itself when
+         * it finishes.
+         *
+         * @return Handle
+         */
+        Handle detach() noexcept
+        {
+            auto handle = std::exchange(handle_, nullptr);
+            if (handle)
+                handle.promise().detached_ = true;
+            return handle;
+        }
+
+    private:
+        Handle handle_;
+    };
+
+    namespace internal
+    {
+        template <typename T>
+        inline Task<T> TaskPromise<T>::get_return_object() noexcept
+        {
+            return Task<T>{std::coroutine_handle<TaskPromise<T>>::from_promise(*this)};
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object() noexcept
+        {
+            return Task<void>{
+                std::coroutine_handle<TaskPromise<void>>::from_promise(*this)};
+        }
+    } // namespace internal
+
+    /**
+     * @brief Start a task in the given event loop without waiting for it. The
+     * task destroys itself when it finishes, an exception escaping from it is
+     * logged.
+     *
+     * @param loop
+     * @param task
+     */
+    template <typename T>
+    inline void spawn(EventLoop *loop, Task<T> &&task)
+    {
+        auto handle = task.detach();
+        if (!handle)
+            return;
+        loop->runInLoop([handle]()
+                        { handle.resume(); });
+    }
+
+    /**
+     * @brief The awaitable returned by sleepFor(), it resumes the coroutine from
+     * the timer queue of the event loop.
+     *
+     */
+    class SleepAwaiter
+    {
+    public:
+        SleepAwaiter(EventLoop *loop, double delay) : loop_(loop), delay_(delay)
+        {
+        }
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            loop_->runAfter(delay_, [handle]()
+                            { handle.resume(); });
+        }
+        void await_resume() const noexcept
+        {
+        }
+
+    private:
+        EventLoop *loop_;
+        double delay_;
+    };
+
+    /**
+     * @brief Suspend the coroutine for the given time.
+     *
+     * @param loop The event loop resuming the coroutine.
+     * @param delay in seconds.
+     * @return SleepAwaiter
+     */
+    inline SleepAwaiter sleepFor(EventLoop *loop, double delay)
+    {
+        return SleepAwaiter(loop, delay);
+    }
+    inline SleepAwaiter sleepFor(EventLoop *loop,
+                                 const std::chrono::duration<double> &delay)
+    {
+        return SleepAwaiter(loop, delay.count());
+    }
+
+    /**
+     * @brief The awaitable returned by readable() and writable(). The result of
+     * co_await is the events that occurred on the socket, so a hang-up or an
+     * error can be told apart from readiness.
+     *
+     * @note The event callback of the channel is replaced while the coroutine
+     * waits. The coroutine is resumed at the end of the loop iteration, through
+     * EventLoop::runBeforePoll(), because the channel may be destroyed by the
+     * resumed coroutine. If the coroutine is destroyed while it waits, the
+     * awaitable stops watching the channel, and removes it from the loop when
+     * it owns it.
+     */
+    class ChannelAwaiter
+    {
+    public:
+        ChannelAwaiter(Channel &channel, bool writing, bool owned = false)
+            : channel_(channel), writing_(writing), owned_(owned)
+        {
+        }
+        ~ChannelAwaiter()
+        {
+            if (!handle_)
+                return;
+            if (pending_)
+                unlinkPending();
+            else if (owned_)
+                channel_.disableAll();
+            else if (writing_)
+                channel_.disableWriting();
+            else
+                channel_.disableReading();
+            channel_.setEventCallback(Channel::EventCallback());
+            if (owned_ && channel_.index() != -1)
+                channel_.remove();
+        }
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            handle_ = handle;
+            channel_.setEventCallback([this]()
+                                      {
+                revents_ = channel_.revents();
+                if (owned_)
+                    channel_.disableAll();
+                else if (writing_)
+                    channel_.disableWriting();
+                else
+                    channel_.disableReading();
+                if (!pendingHead_)
+                    channel_.ownerLoop()->runBeforePoll(&ChannelAwaiter::resumePending);
+                linkPending(); });
+            if (writing_)
+                channel_.enableWriting();
+            else
+                channel_.enableReading();
+        }
+        int await_resume() const noexcept
+        {
+            return revents_;
+        }
+
+    private:
+        // The hook resumes the awaitables of the thread whose channel fired,
+        // instead of capturing them, so one destroyed meanwhile only has to
+        // leave the list.
+        static void resumePending()
+        {
+            while (auto awaiter = pendingHead_)
+            {
+                awaiter->unlinkPending();
+                awaiter->resume();
+            }
+        }
+        void linkPending()
+        {
+            pending_ = true;
+            prevPending_ = pendingTail_;
+            nextPending_ = nullptr;
+            if (pendingTail_)
+                pendingTail_->nextPending_ = this;
+            else
+                pendingHead_ = this;
+            pendingTail_ = this;
+        }
+        void unlinkPending()
+        {
+            pending_ = false;
+            if (prevPending_)
+                prevPending_->nextPending_ = nextPending_;
+            else
+                pendingHead_ = nextPending_;
+            if (nextPending_)
+                nextPending_->prevPending_ = prevPending_;
+            else
+                pendingTail_ = prevPending_;
+        }
+        void resume()
+        {
+            channel_.setEventCallback(Channel::EventCallback());
+            if (owned_)
+                channel_.remove();
+            std::exchange(handle_, nullptr).resume();
+        }
+
+        static inline thread_local ChannelAwaiter *pendingHead_{nullptr};
+        static inline thread_local ChannelAwaiter *pendingTail_{nullptr};
+
+        Channel &channel_;
+        bool writing_;
+        bool owned_;
+        bool pending_{false};
+        int revents_{0};
+        std::coroutine_handle<> handle_;
+        ChannelAwaiter *prevPending_{nullptr};
+        ChannelAwaiter *nextPending_{nullptr};
+    };
+
+    namespace internal
+    {
+        // Constructed before the ChannelAwaiter base, which refers to it.
+        struct FdChannelHolder
+        {
+            FdChannelHolder(EventLoop *loop, int fd) : ownedChannel_(loop, fd)
+            {
+            }
+            Channel ownedChannel_;
+        };
+    } // namespace internal
+
+    /**
+     * @brief The awaitable waiting for a socket that has no channel yet. The
+     * channel lives in the awaitable, which lives in the coroutine frame, so
+     * waiting allocates nothing.
+     *
+     */
+    class FdAwaiter : private internal::FdChannelHolder, public ChannelAwaiter
+    {
+    public:
+        FdAwaiter(EventLoop *loop, int fd, bool writing)
+            : internal::FdChannelHolder(loop, fd),
+              ChannelAwaiter(ownedChannel_, writing, true)
+        {
+        }
+    };
+
+    /**
+     * @brief Suspend the coroutine until the socket is readable.
+     *
+     * @param loop The event loop resuming the coroutine.
+     * @param fd The socket, it must not have another channel in the loop.
+     * @return FdAwaiter
+     */
+    inline FdAwaiter readable(EventLoop *loop, int fd)
+    {
+        return FdAwaiter(loop, fd, false);
+    }
+
+    /**
+     * @brief Suspend the coroutine until the socket is writable.
+     *
+     * @param loop The event loop resuming the coroutine.
+     * @param fd The socket, it must not have another channel in the loop.
+     * @return FdAwaiter
+     */
+    inline FdAwaiter writable(EventLoop *loop, int fd)
+    {
+        return FdAwaiter(loop, fd, true);
+    }
+
+    /**
+     * @brief Suspend the coroutine until the socket of the channel is readable.
+     *
+     * @param channel
+     * @return ChannelAwaiter
+     */
+    inline ChannelAwaiter readable(Channel &channel)
+    {
+        return ChannelAwaiter(channel, false);
+    }
+
+    /**
+     * @brief Suspend the coroutine until the socket of the channel is writable.
+     *
+     * @param channel
+     * @return ChannelAwaiter
+     */
+    inline ChannelAwaiter writable(Channel &channel)
+    {
+        return ChannelAwaiter(channel, true);
+    }
+
+    /**
+     * @brief The awaitable returned by switchTo().
+     *
+     */
+    class LoopAwaiter
+    {
+    public:
+        explicit LoopAwaiter(EventLoop *loop) : loop_(loop)
+        {
+        }
+        bool await_ready() const noexcept
+        {
+            return loop_->isInLoopThread();
+        }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            loop_->queueInLoop([handle]()
+                               { handle.resume(); });
+        }
+        void await_resume() const noexcept
+        {
+        }
+
+    private:
+        EventLoop *loop_;
+    };
+
+    /**
+     * @brief Move the coroutine to the given event loop, the code after the
+     * co_await runs in the thread of that loop.
+     *
+     * @param loop
+     * @return LoopAwaiter
+     */
+    inline LoopAwaiter switchTo(EventLoop *loop)
+    {
+        return LoopAwaiter(loop);
+    }
+} // namespace xiao
+#endif
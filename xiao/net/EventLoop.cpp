@@ -9,15 +9,38 @@
  *
  */
 #include <xiao/net/EventLoop.h>
+#include <xiao/net/Channel.h>
+#include <xiao/utils/Logger.h>
 
+#include "Poller.h"
+#include "SignalWatcher.h"
+#include "TimerQueue.h"
+
+#include <assert.h>
+#ifdef _WIN32
+#include <windows.h>
+using ssize_t = long long;
+#else
+#include <poll.h>
+#endif
+#include <iostream>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#include <algorithm>
+#include <fcntl.h>
 #include <thread>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 namespace xiao
 {
 #ifdef __linux__
     int createEventfd()
     {
-        it evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
-        int(evtfd < 0)
+        int evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (evtfd < 0)
         {
             std::cout << "Failed in eventfd" << std::endl;
             abort();
@@ -29,9 +52,611 @@ namespace xiao
 #endif
     thread_local EventLoop *t_loopInThisThread = nullptr;
 
-    // EventLoop::EventLoop()
-    //     : looping_(false),
-    //       threadId_(std::this_thread::get_id());
-    //       quit_(false),
+    namespace
+    {
+        template <typename F>
+        struct ScopeExit
+        {
+            ScopeExit(F &&f) : f_(std::forward<F>(f))
+            {
+            }
+            ~ScopeExit()
+            {
+                f_();
+            }
+            F f_;
+        };
+
+        template <typename F>
+        ScopeExit<F> makeScopeExit(F &&f)
+        {
+            return ScopeExit<F>(std::forward<F>(f));
+        }
+
+        inline int64_t steadyMicroSeconds()
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
+        inline uint64_t elapsed(int64_t from, int64_t to)
+        {
+            return to > from ? static_cast<uint64_t>(to - from) : 0;
+        }
+    } // namespace
+
+    EventLoop::EventLoop()
+        : looping_(false),
+          threadId_(std::this_thread::get_id()),
+          quit_(false),
+          poller_(Poller::newPoller(this)),
+          currentActiveChannel_(nullptr),
+          eventHandling_(false),
+          timerQueue_(new TimerQueue(this)),
+          metrics_(new EventLoopMetrics),
+#ifdef __linux__
+          wakeupFd_(createEventfd()),
+          wakeupChannelPtr_(new Channel(this, wakeupFd_)),
+#endif
+          threadLocalLoopPtr_(&t_loopInThisThread)
+    {
+        if (t_loopInThisThread)
+        {
+            LOG_FATAL << "There is already an EventLoop in this thread";
+            exit(-1);
+        }
+        t_loopInThisThread = this;
+#ifdef __linux__
+        wakeupChannelPtr_->setReadCallback(std::bind(&EventLoop::wakeupRead, this));
+        wakeupChannelPtr_->enableReading();
+#elif !defined _WIN32
+        auto r = pipe(wakeupFd_);
+        (void)r;
+        assert(!r);
+        fcntl(wakeupFd_[0], F_SETFL, O_NONBLOCK | O_CLOEXEC);
+        fcntl(wakeupFd_[1], F_SETFL, O_NONBLOCK | O_CLOEXEC);
+        wakeupChannelPtr_ =
+            std::unique_ptr<Channel>(new Channel(this, wakeupFd_[0]));
+        wakeupChannelPtr_->setReadCallback(std::bind(&EventLoop::wakeupRead, this));
+        wakeupChannelPtr_->enableReading();
+#else
+        poller_->setEventCallback([](uint64_t event)
+                                  { assert(event == 1); (void)event; });
+#endif
+    }
+
+#ifdef __linux__
+    void EventLoop::resetTimerQueue()
+    {
+        assertInLoopThread();
+        assert(!looping_.load(std::memory_order_acquire));
+        timerQueue_->reset();
+    }
+
+    void EventLoop::setSignalCallback(int signo, const Func &cb)
+    {
+        setSignalCallback(signo, Func(cb));
+    }
+
+    void EventLoop::setSignalCallback(int signo, Func &&cb)
+    {
+        assertInLoopThread();
+        if (!signalWatcher_)
+        {
+            signalWatcher_.reset(new SignalWatcher(this));
+        }
+        signalWatcher_->setCallback(signo, std::move(cb));
+    }
+
+    void EventLoop::removeSignalCallback(int signo)
+    {
+        assertInLoopThread();
+        if (signalWatcher_)
+        {
+            signalWatcher_->removeCallback(signo);
+        }
+    }
+#endif
+
+    void EventLoop::resetAfterFork()
+    {
+        poller_->resetAfterFork();
+#ifdef __linux__
+        // The eventfd is shared with the parent process too, a wakeup in one
+        // process would wake the other one up.
+        wakeupChannelPtr_->disableAll();
+        wakeupChannelPtr_->remove();
+        close(wakeupFd_);
+        wakeupFd_ = createEventfd();
+        wakeupChannelPtr_.reset(new Channel(this, wakeupFd_));
+        wakeupChannelPtr_->setReadCallback(std::bind(&EventLoop::wakeupRead, this));
+        wakeupChannelPtr_->enableReading();
+#endif
+    }
+
+    EventLoop::~EventLoop()
+    {
+#ifdef _WIN32
+        DWORD delay = 1; /* 1 msec */
+#else
+        struct timespec delay = {0, 1000000}; /* 1 msec */
+#endif
+
+        quit();
+
+        // Spin waiting for the loop to exit because this may take some time to
+        // complete. We assume the loop thread will *always* exit.
+        while (looping_.load(std::memory_order_acquire))
+        {
+#ifdef _WIN32
+            Sleep(delay);
+#else
+            nanosleep(&delay, nullptr);
+#endif
+        }
+
+        t_loopInThisThread = nullptr;
+#ifdef __linux__
+        close(wakeupFd_);
+#elif defined _WIN32
+#else
+        close(wakeupFd_[0]);
+        close(wakeupFd_[1]);
+#endif
+    }
+
+    EventLoop *EventLoop::getEventLoopOfCurrentThread()
+    {
+        return t_loopInThisThread;
+    }
+
+    void EventLoop::updateChannel(Channel *channel)
+    {
+        assert(channel->ownerLoop() == this);
+        assertInLoopThread();
+        poller_->updateChannel(channel);
+    }
+
+    void EventLoop::removeChannel(Channel *channel)
+    {
+        assert(channel->ownerLoop() == this);
+        assertInLoopThread();
+        if (eventHandling_)
+        {
+            assert(currentActiveChannel_ == channel ||
+                   std::find(activeChannels_.begin(),
+                             activeChannels_.end(),
+                             channel) == activeChannels_.end());
+        }
+        poller_->removeChannel(channel);
+    }
+
+    void EventLoop::quit()
+    {
+        quit_.store(true, std::memory_order_release);
+
+        if (!isInLoopThread())
+        {
+            wakeup();
+        }
+    }
+
+    void EventLoop::loop()
+    {
+        assert(!looping_);
+        assertInLoopThread();
+        looping_.store(true, std::memory_order_release);
+        quit_.store(false, std::memory_order_release);
+
+        std::exception_ptr loopException;
+        try
+        { // Scope where the loop flag is set
+
+            auto loopFlagCleaner = makeScopeExit(
+                [this]()
+                {
+                    if (heartbeat_.load(std::memory_order_relaxed) & 1)
+                        beat();
+                    looping_.store(false, std::memory_order_release);
+                });
+            while (!quit_.load(std::memory_order_acquire))
+            {
+                const bool measuring =
+                    metricsEnabled_.load(std::memory_order_relaxed);
+                int64_t pollStart = 0;
+                int64_t handlingStart = 0;
+                uint64_t timersFired = 0;
+                activeChannels_.clear();
+                if (measuring)
+                {
+                    pollStart = steadyMicroSeconds();
+                }
+                // Leftover bulk functions must not wait for the next event.
+                const bool bulkPending = !bulkFuncs_.empty();
+#ifdef __linux__
+                poller_->poll(bulkPending ? 0 : xPollTimeMs, &activeChannels_);
+#else
+                poller_->poll(bulkPending
+                                  ? 0
+                                  : static_cast<int>(timerQueue_->getTimeout()),
+                              &activeChannels_);
+#endif
+                beat();
+                if (measuring)
+                {
+                    handlingStart = steadyMicroSeconds();
+                    metrics_->pollTimeUs.record(elapsed(pollStart, handlingStart));
+                    metrics_->activeChannels.record(activeChannels_.size());
+                    timersFired = timerQueue_->firedCount();
+                }
+#ifndef __linux__
+                timerQueue_->processTimers();
+#endif
+                eventHandling_ = true;
+                for (auto it = activeChannels_.begin(); it != activeChannels_.end();
+                     ++it)
+                {
+                    currentActiveChannel_ = *it;
+                    currentActiveChannel_->handleEvent();
+                }
+                currentActiveChannel_ = nullptr;
+                eventHandling_ = false;
+                if (measuring)
+                {
+                    int64_t funcsStart = steadyMicroSeconds();
+                    metrics_->channelTimeUs.record(
+                        elapsed(handlingStart, funcsStart));
+                    metrics_->timersFired.record(timerQueue_->firedCount() -
+                                                 timersFired);
+                    doRunInLoopFuncs(true);
+                    doRunBulkFuncs();
+                    int64_t beforePollStart = steadyMicroSeconds();
+                    metrics_->funcsTimeUs.record(
+                        elapsed(funcsStart, beforePollStart));
+                    doRunBeforePollFuncs();
+                    metrics_->beforePollTimeUs.record(
+                        elapsed(beforePollStart, steadyMicroSeconds()));
+                    metrics_->iterations.store(
+                        metrics_->iterations.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+                }
+                else
+                {
+                    doRunInLoopFuncs(false);
+                    doRunBulkFuncs();
+                    doRunBeforePollFuncs();
+                }
+                beat();
+            }
+            // loopFlagCleaner clean up before running functions
+        }
+        catch (std::exception &e)
+        {
+            LOG_WARN << "Exception thrown from event loop: " << e.what();
+            loopException = std::current_exception();
+        }
+
+        // Run the quit functions even if exceptions were thrown
+        Func f;
+        while (funcsOnQuit_.dequeue(f))
+        {
+            f();
+        }
+
+        // Throw the exception from the end
+        if (loopException)
+        {
+            LOG_WARN << "Rethrowing exception from event loop";
+            std::rethrow_exception(loopException);
+        }
+    }
+
+    void EventLoop::abortNotInLoopThread()
+    {
+        LOG_FATAL << "It is forbidden to run loop on threads other than event-loop "
+                     "thread";
+        exit(1);
+    }
+
+    void EventLoop::markFuncQueued()
+    {
+        if (metricsEnabled_.load(std::memory_order_relaxed))
+        {
+            int64_t expected = 0;
+            oldestFuncQueuedUs_.compare_exchange_strong(expected,
+                                                        steadyMicroSeconds(),
+                                                        std::memory_order_relaxed);
+        }
+    }
+
+    void EventLoop::queueInLoop(const Func &cb)
+    {
+        markFuncQueued();
+        funcs_.enqueue(cb);
+        if (!isInLoopThread() || !looping_.load(std::memory_order_acquire))
+        {
+            wakeup();
+        }
+    }
+
+    void EventLoop::queueInLoop(Func &&cb)
+    {
+        markFuncQueued();
+        funcs_.enqueue(std::move(cb));
+        if (!isInLoopThread() || !looping_.load(std::memory_order_acquire))
+        {
+            wakeup();
+        }
+    }
+
+    void EventLoop::queueInLoop(const Func &cb, FuncPriority priority)
+    {
+        queueInLoop(Func(cb), priority);
+    }
+
+    void EventLoop::queueInLoop(Func &&cb, FuncPriority priority)
+    {
+        markFuncQueued();
+        switch (priority)
+        {
+            case FuncPriority::xUrgent:
+                urgentFuncs_.enqueue(std::move(cb));
+                break;
+            case FuncPriority::xBulk:
+                bulkFuncs_.enqueue(std::move(cb));
+                break;
+            default:
+                funcs_.enqueue(std::move(cb));
+                break;
+        }
+        if (!isInLoopThread() || !looping_.load(std::memory_order_acquire))
+        {
+            wakeup();
+        }
+    }
+
+    void EventLoop::queueTask(LoopTask *task)
+    {
+        markFuncQueued();
+        tasks_.enqueue(task);
+        if (!isInLoopThread() || !looping_.load(std::memory_order_acquire))
+        {
+            wakeup();
+        }
+    }
+
+    TimerId EventLoop::runAt(const Date &time, const Func &cb)
+    {
+        auto microSeconds =
+            time.microSecondsSinceEpoch() - Date::now().microSecondsSinceEpoch();
+        std::chrono::steady_clock::time_point tp =
+            std::chrono::steady_clock::now() +
+            std::chrono::microseconds(microSeconds);
+        return timerQueue_->addTimer(cb, tp, std::chrono::microseconds(0));
+    }
+
+    TimerId EventLoop::runAt(const Date &time, Func &&cb)
+    {
+        auto microSeconds =
+            time.microSecondsSinceEpoch() - Date::now().microSecondsSinceEpoch();
+        std::chrono::steady_clock::time_point tp =
+            std::chrono::steady_clock::now() +
+            std::chrono::microseconds(microSeconds);
+        return timerQueue_->addTimer(std::move(cb),
+                                     tp,
+                                     std::chrono::microseconds(0));
+    }
+
+    TimerId EventLoop::runAfter(double delay, const Func &cb)
+    {
+        return runAt(Date::date().after(delay), cb);
+    }
+
+    TimerId EventLoop::runAfter(double delay, Func &&cb)
+    {
+        return runAt(Date::date().after(delay), std::move(cb));
+    }
+
+    TimerId EventLoop::runEvery(double interval, const Func &cb)
+    {
+        std::chrono::microseconds dur(
+            static_cast<std::chrono::microseconds::rep>(interval * 1000000));
+        auto tp = std::chrono::steady_clock::now() + dur;
+        return timerQueue_->addTimer(cb, tp, dur);
+    }
+
+    TimerId EventLoop::runEvery(double interval, Func &&cb)
+    {
+        std::chrono::microseconds dur(
+            static_cast<std::chrono::microseconds::rep>(interval * 1000000));
+        auto tp = std::chrono::steady_clock::now() + dur;
+        return timerQueue_->addTimer(std::move(cb), tp, dur);
+    }
+
+    void EventLoop::invalidateTimer(TimerId id)
+    {
+        if (isRunning() && timerQueue_)
+            timerQueue_->invalidateTimer(id);
+    }
+
+    void EventLoop::doRunInLoopFuncs(bool measuring)
+    {
+        callingFuncs_ = true;
+        {
+            // the destructor for the Func may itself insert a new entry into the
+            // queue
+            auto callingFuncsCleaner = makeScopeExit([this]()
+                                                     { callingFuncs_ = false; });
+            if (measuring)
+            {
+                int64_t queued =
+                    oldestFuncQueuedUs_.exchange(0, std::memory_order_relaxed);
+                if (queued != 0)
+                {
+                    metrics_->funcLagUs.record(
+                        elapsed(queued, steadyMicroSeconds()));
+                }
+            }
+            doRunUrgentFuncs();
+            doRunTasks();
+            while (!funcs_.empty() || !tasks_.empty())
+            {
+                Func func;
+                while (funcs_.dequeue(func))
+                {
+                    // The tasks queued before the function run before it.
+                    doRunTasks();
+                    func();
+                    doRunUrgentFuncs();
+                }
+                doRunTasks();
+            }
+        }
+    }
+
+    void EventLoop::doRunTasks()
+    {
+        while (auto task = tasks_.dequeue())
+        {
+            task->run();
+            doRunUrgentFuncs();
+        }
+    }
+
+    void EventLoop::doRunUrgentFuncs()
+    {
+        while (!urgentFuncs_.empty())
+        {
+            Func func;
+            while (urgentFuncs_.dequeue(func))
+            {
+                func();
+            }
+        }
+    }
+
+    // Called once per iteration from loop(), so the budget is spent at most
+    // once per iteration.
+    void EventLoop::doRunBulkFuncs()
+    {
+        if (bulkFuncs_.empty())
+            return;
+        const auto deadline = std::chrono::steady_clock::now() + bulkFuncsMaxTime_;
+        Func func;
+        for (size_t count = 0; count < bulkFuncsMaxCount_; ++count)
+        {
+            if (!bulkFuncs_.dequeue(func))
+                break;
+            func();
+            doRunUrgentFuncs();
+            // Functions queued in the normal lane by the bulk work run in this
+            // iteration too, they must not wait for the next event.
+            doRunTasks();
+            while (funcs_.dequeue(func))
+            {
+                doRunTasks();
+                func();
+                doRunUrgentFuncs();
+            }
+            doRunTasks();
+            if (std::chrono::steady_clock::now() >= deadline)
+                break;
+        }
+    }
+
+    void EventLoop::runBeforePoll(const Func &f)
+    {
+        assertInLoopThread();
+        beforePollFuncs_.push_back(f);
+    }
 
-}
\ No newline at end of file
+    void EventLoop::runBeforePoll(Func &&f)
+    {
+        assertInLoopThread();
+        beforePollFuncs_.push_back(std::move(f));
+    }
+
+    void EventLoop::doRunBeforePollFuncs()
+    {
+        while (!beforePollFuncs_.empty())
+        {
+            // Swap with a second vector so both keep their capacity.
+            runningBeforePollFuncs_.swap(beforePollFuncs_);
+            for (auto &func : runningBeforePollFuncs_)
+            {
+                func();
+            }
+            runningBeforePollFuncs_.clear();
+            // The functions above may queue functions in the loop thread, which
+            // does not wake the loop up, so run them before polling.
+            if (!funcs_.empty() || !urgentFuncs_.empty() || !tasks_.empty())
+            {
+                doRunInLoopFuncs(false);
+            }
+        }
+    }
+
+    void EventLoop::wakeup()
+    {
+        uint64_t tmp = 1;
+#ifdef __linux__
+        int ret = write(wakeupFd_, &tmp, sizeof(tmp));
+        (void)ret;
+#elif defined _WIN32
+        poller_->postEvent(1);
+#else
+        int ret = write(wakeupFd_[1], &tmp, sizeof(tmp));
+        (void)ret;
+#endif
+    }
+
+    void EventLoop::wakeupRead()
+    {
+        ssize_t ret = 0;
+#ifdef __linux__
+        uint64_t tmp;
+        ret = read(wakeupFd_, &tmp, sizeof(tmp));
+#elif defined _WIN32
+#else
+        uint64_t tmp;
+        ret = read(wakeupFd_[0], &tmp, sizeof(tmp));
+#endif
+        if (ret < 0)
+            LOG_SYSERR << "wakeup read error";
+    }
+
+    void EventLoop::moveToCurrentThread()
+    {
+        if (isRunning())
+        {
+            LOG_FATAL << "EventLoop cannot be moved when running";
+            exit(-1);
+        }
+        if (isInLoopThread())
+        {
+            LOG_WARN << "This EventLoop is already in the current thread";
+            return;
+        }
+        if (t_loopInThisThread)
+        {
+            LOG_FATAL << "There is already an EventLoop in this thread, you cannot "
+                         "move another in";
+            exit(-1);
+        }
+        *threadLocalLoopPtr_ = nullptr;
+        t_loopInThisThread = this;
+        threadLocalLoopPtr_ = &t_loopInThisThread;
+        threadId_ = std::this_thread::get_id();
+    }
+
+    void EventLoop::runOnQuit(Func &&cb)
+    {
+        funcsOnQuit_.enqueue(std::move(cb));
+    }
+
+    void EventLoop::runOnQuit(const Func &cb)
+    {
+        funcsOnQuit_.enqueue(cb);
+    }
+} // namespace xiao
@@ -8,13 +8,18 @@
  * @copyright Copyright (c) 2024
  *
  */
+#pragma once
 
 #include <vector>
 #include <memory>
 #include <functional>
 #include <thread>
+#include <chrono>
+#include <limits>
 #include <xiao/utils/NonCopyable.h>
 #include <xiao/utils/Date.h>
+#include <xiao/utils/LockFreeQueue.h>
+#include <xiao/net/EventLoopMetrics.h>
 #include <atomic>
 
 namespace xiao
@@ -22,6 +27,7 @@ namespace xiao
     class Poller;
     class TimerQueue;
     class Channel;
+    class SignalWatcher;
     using ChannelList = std::vector<Channel *>;
     using Func = std::function<void()>;
     using TimerId = uint64_t;
@@ -30,6 +36,32 @@ namespace xiao
         InvalidTimerId = 0
     };
 
+    /**
+     * @brief The lanes of the functions queued in an event loop.
+     *
+     */
+    enum class FuncPriority
+    {
+        /// Run before any other queued function, e.g. cancellation or close.
+        xUrgent,
+        /// The default FIFO lane, drained completely in every iteration.
+        xNormal,
+        /// Background work, drained within a per-iteration budget.
+        xBulk
+    };
+
+    /**
+     * @brief A task queued in an event loop without allocating, it is meant to
+     * be embedded in the object it works on (see EventLoop::queueTask()).
+     *
+     */
+    class XIAO_EXPORT LoopTask : public MpscHook
+    {
+    public:
+        virtual ~LoopTask() = default;
+        virtual void run() = 0;
+    };
+
     /**
      * @brief As the name implies, this class represents an event loop runs in
      * a perticular thread. The event loop can handle network I/O events and timers
@@ -75,6 +107,31 @@ namespace xiao
          *
          */
         void resetTimerQueue();
+
+        /**
+         * @brief Run the callback in the event loop whenever the signal is
+         * received. The signal is read from a signalfd polled by the loop, so
+         * the callback runs in the loop thread as a regular I/O event.
+         *
+         * @param signo The signal number, e.g. SIGTERM, SIGHUP or SIGUSR1.
+         * @param cb
+         * @note This method must be called in the thread of the event loop. The
+         * signal is blocked in that thread, and it must be blocked in every
+         * other thread of the process too, otherwise the kernel delivers it to
+         * them. The simplest way is to register the signals before any other
+         * thread is created, threads inherit the signal mask.
+         */
+        void setSignalCallback(int signo, const Func &cb);
+        void setSignalCallback(int signo, Func &&cb);
+
+        /**
+         * @brief Stop handling the signal in the event loop and unblock it in
+         * the loop thread. This method must be called in the thread of the event
+         * loop.
+         *
+         * @param signo
+         */
+        void removeSignalCallback(int signo);
 #endif
         /**
          * @brief Make the event loop works after calling the fork() function.
@@ -133,6 +190,62 @@ namespace xiao
         void queueInLoop(const Func &f);
         void queueInLoop(Func &&f);
 
+        /**
+         * @brief Run the function f in the thread of the event loop, in the lane
+         * of the given priority.
+         *
+         * @param f
+         * @param priority
+         * @note In every iteration the urgent lane is drained first, and again
+         * before each function of the other lanes. Then the normal lane is
+         * drained completely, and the bulk lane is drained until the budget set
+         * by setBulkFuncsBudget() runs out. Bulk functions left over run in the
+         * next iteration, which then polls without blocking.
+         */
+        void queueInLoop(const Func &f, FuncPriority priority);
+        void queueInLoop(Func &&f, FuncPriority priority);
+
+        /**
+         * @brief Run a task in the thread of the event loop, in the normal lane,
+         * without allocating.
+         *
+         * @param task
+         * @note The task can be queued again once it runs, not before, and must
+         * stay alive until then. The tasks still queued when the loop is
+         * destroyed don't run.
+         */
+        void queueTask(LoopTask *task);
+
+        /**
+         * @brief Set how many bulk functions, and for how long, one iteration
+         * runs. This method must be called in the thread of the event loop or
+         * before the loop runs.
+         *
+         * @param maxCount The maximum number of bulk functions per iteration.
+         * @param maxTime The time after which no more bulk functions are started
+         * in the iteration.
+         */
+        void setBulkFuncsBudget(size_t maxCount, std::chrono::microseconds maxTime)
+        {
+            bulkFuncsMaxCount_ = maxCount;
+            bulkFuncsMaxTime_ = maxTime;
+        }
+
+        /**
+         * @brief Run the function f once at the end of the current iteration,
+         * after the channel callbacks and the queued functions, right before the
+         * event loop polls again.
+         *
+         * @param f
+         * @note This method must be called in the thread of the event loop. It
+         * lets a connection written several times in one iteration register a
+         * single flush, so the pending data goes out with one writev() call
+         * instead of one write() per send. Functions registered by these
+         * functions run in the same iteration.
+         */
+        void runBeforePoll(const Func &f);
+        void runBeforePoll(Func &&f);
+
         /**
          * @brief Run a function at a time point.
          *
@@ -240,6 +353,30 @@ namespace xiao
             index_ = index;
         }
 
+        /**
+         * @brief Get the index of the event loop.
+         *
+         * @return size_t
+         */
+        size_t index()
+        {
+            return index_;
+        }
+
+        /**
+         * @brief Return the heartbeat of the event loop. The heartbeat is bumped
+         * when the loop returns from polling and again when the iteration ends,
+         * so an odd value means the loop is running callbacks and an even value
+         * means it is waiting for events (or not running at all).
+         *
+         * @return uint64_t
+         * @note This method can be called in any thread.
+         */
+        uint64_t heartbeat() const
+        {
+            return heartbeat_.load(std::memory_order_acquire);
+        }
+
         /**
          * @brief Return true if the event loop is running.
          *
@@ -272,16 +409,89 @@ namespace xiao
         void runOnQuit(const Func &cb);
         void runOnQuit(Func &&cb);
 
+        /**
+         * @brief Enable or disable the per-iteration metrics of the event loop.
+         * This method can be called in any thread, the change takes effect from
+         * the next iteration.
+         *
+         * @param enable
+         * @note The metrics are disabled by default. When enabled, an iteration
+         * costs five extra steady clock reads and a few relaxed atomic stores.
+         */
+        void enableMetrics(bool enable = true)
+        {
+            metricsEnabled_.store(enable, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Return true if the per-iteration metrics are enabled.
+         *
+         * @return true
+         * @return false
+         */
+        bool metricsEnabled() const
+        {
+            return metricsEnabled_.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Get the per-iteration metrics of the event loop. The histograms
+         * can be read in any thread.
+         *
+         * @return const EventLoopMetrics&
+         */
+        const EventLoopMetrics &metrics() const
+        {
+            return *metrics_;
+        }
+
     private:
         void abortNotInLoopThread();
+        void wakeup();
+        void wakeupRead();
+        void doRunInLoopFuncs(bool measuring);
+        void doRunBeforePollFuncs();
+        void doRunUrgentFuncs();
+        void doRunBulkFuncs();
+        void doRunTasks();
+        void markFuncQueued();
+        void beat()
+        {
+            heartbeat_.store(heartbeat_.load(std::memory_order_relaxed) + 1,
+                             std::memory_order_release);
+        }
         std::atomic<bool> looping_;
-        std::atomic<bool> quit_;
         std::thread::id threadId_;
+        std::atomic<bool> quit_;
+        std::unique_ptr<Poller> poller_;
+
+        ChannelList activeChannels_;
+        Channel *currentActiveChannel_;
+
+        bool eventHandling_;
+        MpscQueue<Func> funcs_;
+        MpscQueue<Func> urgentFuncs_;
+        MpscQueue<Func> bulkFuncs_;
+        IntrusiveMpscQueue<LoopTask> tasks_;
+        size_t bulkFuncsMaxCount_{128};
+        std::chrono::microseconds bulkFuncsMaxTime_{1000};
+        std::unique_ptr<TimerQueue> timerQueue_;
+        MpscQueue<Func> funcsOnQuit_;
         bool callingFuncs_{false};
+        std::vector<Func> beforePollFuncs_;
+        std::vector<Func> runningBeforePollFuncs_;
+
+        std::atomic<bool> metricsEnabled_{false};
+        std::unique_ptr<EventLoopMetrics> metrics_;
+        // Microseconds on the steady clock when the oldest function still in
+        // funcs_ was queued, 0 if none was queued with the metrics enabled.
+        std::atomic<int64_t> oldestFuncQueuedUs_{0};
+        std::atomic<uint64_t> heartbeat_{0};
 
 #ifdef __linux__
         int wakeupFd_;
         std::unique_ptr<Channel> wakeupChannelPtr_;
+        std::unique_ptr<SignalWatcher> signalWatcher_;
 #elif defined _WIN32
 #else
         int wakeupFd_[2];
@@ -293,5 +503,6 @@ namespace xiao
 #else
         size_t index_{std::numeric_limits<size_t>::max()};
 #endif
+        EventLoop **threadLocalLoopPtr_;
     };
 }
\ No newline at end of file
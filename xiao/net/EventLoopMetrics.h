@@ -0,0 +1,48 @@
+/**
+ * @file EventLoopMetrics.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/utils/Histogram.h>
+#include <atomic>
+#include <cstdint>
+
+namespace xiao
+{
+    /**
+     * @brief This struct holds the per-iteration counters of an event loop.
+     * Every histogram gets one sample per loop iteration while the metrics are
+     * enabled, except funcLagUs which gets one sample per batch of queued
+     * functions.
+     *
+     * @note The loop thread is the only writer, other threads read the counters
+     * through Histogram::snapshot().
+     */
+    struct EventLoopMetrics
+    {
+        /// Microseconds blocked in Poller::poll().
+        Histogram pollTimeUs;
+        /// Number of active channels returned by one poll.
+        Histogram activeChannels;
+        /// Microseconds spent in the callbacks of the active channels.
+        Histogram channelTimeUs;
+        /// Microseconds spent draining the functions queued by queueInLoop().
+        Histogram funcsTimeUs;
+        /// Microseconds spent in the runBeforePoll() functions, including the
+        /// functions they queue.
+        Histogram beforePollTimeUs;
+        /// Number of timers fired in one iteration.
+        Histogram timersFired;
+        /// Microseconds the oldest queued function waited before it was run.
+        Histogram funcLagUs;
+        /// Number of measured iterations.
+        std::atomic<uint64_t> iterations{0};
+    };
+} // namespace xiao
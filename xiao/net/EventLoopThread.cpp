@@ -0,0 +1,97 @@
+/**
+ * @file EventLoopThread.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopThread.h>
+#include <xiao/utils/CpuAffinity.h>
+#include <xiao/utils/Logger.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+namespace xiao
+{
+    EventLoopThread::EventLoopThread(const std::string &threadName, int cpu)
+        : loop_(nullptr),
+          loopThreadName_(threadName),
+          cpu_(cpu),
+          thread_([this]()
+                  { loopFuncs(); })
+    {
+        auto f = promiseForLoopPointer_.get_future();
+        loop_ = f.get();
+    }
+
+    EventLoopThread::~EventLoopThread()
+    {
+        run();
+        std::shared_ptr<EventLoop> loop;
+        {
+            std::unique_lock<std::mutex> lk(loopMutex_);
+            loop = loop_;
+        }
+        if (loop)
+        {
+            loop->quit();
+        }
+        if (thread_.joinable())
+        {
+            thread_.join();
+        }
+    }
+
+    void EventLoopThread::wait()
+    {
+        thread_.join();
+    }
+
+    void EventLoopThread::loopFuncs()
+    {
+#ifdef __linux__
+        ::prctl(PR_SET_NAME, loopThreadName_.c_str());
+#endif
+        if (cpu_ >= 0)
+        {
+            // Pin before the event loop is created, so the loop and everything
+            // it allocates are first touched on the local NUMA node.
+            if (!utils::setCurrentThreadCpu(cpu_))
+            {
+                LOG_WARN << "Failed to pin " << loopThreadName_ << " to CPU "
+                         << cpu_;
+            }
+            else
+            {
+                utils::useLocalNumaMemory();
+            }
+        }
+        thread_local static std::shared_ptr<EventLoop> loop =
+            std::make_shared<EventLoop>();
+        loop->queueInLoop([this]()
+                          { promiseForLoop_.set_value(1); });
+        promiseForLoopPointer_.set_value(loop);
+        auto f = promiseForRun_.get_future();
+        (void)f.get();
+        loop->loop();
+        {
+            std::unique_lock<std::mutex> lk(loopMutex_);
+            loop_ = nullptr;
+        }
+    }
+
+    void EventLoopThread::run()
+    {
+        std::call_once(once_, [this]()
+                       {
+            auto f = promiseForLoop_.get_future();
+            promiseForRun_.set_value(1);
+            // Make sure the event loop loops before returning.
+            (void)f.get(); });
+    }
+} // namespace xiao
@@ -0,0 +1,88 @@
+/**
+ * @file EventLoopThread.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/EventLoop.h>
+#include <xiao/utils/NonCopyable.h>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <condition_variable>
+#include <future>
+
+namespace xiao
+{
+    /**
+     * @brief This class represents an event loop thread.
+     *
+     */
+    class XIAO_EXPORT EventLoopThread : NonCopyable
+    {
+    public:
+        /**
+         * @brief Construct a new event loop thread.
+         *
+         * @param threadName The name of the thread.
+         * @param cpu The CPU the thread is pinned to, -1 to let it float. When
+         * the thread is pinned, the memory of its event loop is allocated from
+         * the NUMA node of that CPU.
+         */
+        explicit EventLoopThread(const std::string &threadName = "EventLoopThread",
+                                 int cpu = -1);
+        ~EventLoopThread();
+
+        /**
+         * @brief Wait for the event loop to exit.
+         * @note This method blocks the current thread until the event loop exits.
+         */
+        void wait();
+
+        /**
+         * @brief Get the pointer of the event loop of the thread.
+         *
+         * @return EventLoop*
+         */
+        EventLoop *getLoop() const
+        {
+            return loop_.get();
+        }
+
+        /**
+         * @brief Get the CPU the thread is pinned to, -1 if it is not pinned.
+         *
+         * @return int
+         */
+        int cpu() const
+        {
+            return cpu_;
+        }
+
+        /**
+         * @brief Run the event loop of the thread. This method doesn't block the
+         * current thread.
+         *
+         */
+        void run();
+
+    private:
+        std::shared_ptr<EventLoop> loop_;
+        std::mutex loopMutex_;
+
+        std::string loopThreadName_;
+        int cpu_;
+        void loopFuncs();
+        std::promise<std::shared_ptr<EventLoop>> promiseForLoopPointer_;
+        std::promise<int> promiseForRun_;
+        std::promise<int> promiseForLoop_;
+        std::once_flag once_;
+        std::thread thread_;
+    };
+} // namespace xiao
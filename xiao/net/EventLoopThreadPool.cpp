@@ -0,0 +1,118 @@
+/**
+ * @file EventLoopThreadPool.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopThreadPool.h>
+#include <xiao/utils/CpuAffinity.h>
+
+namespace xiao
+{
+    EventLoopThreadPool::EventLoopThreadPool(size_t threadNum,
+                                             const std::string &name,
+                                             CpuPlacement placement,
+                                             const std::vector<int> &cpus)
+        : loopIndex_(0)
+    {
+        auto threadCpus = placeThreads(threadNum, placement, cpus);
+        for (size_t i = 0; i < threadNum; ++i)
+        {
+            loopThreadVector_.emplace_back(
+                std::make_shared<EventLoopThread>(name, threadCpus[i]));
+            loopThreadVector_[i]->getLoop()->setIndex(i);
+        }
+    }
+
+    std::vector<int> EventLoopThreadPool::placeThreads(size_t threadNum,
+                                                       CpuPlacement placement,
+                                                       const std::vector<int> &cpus)
+    {
+        std::vector<int> threadCpus(threadNum, -1);
+        if (placement == CpuPlacement::xNone)
+            return threadCpus;
+        if (placement == CpuPlacement::xExplicit)
+        {
+            if (cpus.empty())
+                return threadCpus;
+            for (size_t i = 0; i < threadNum; ++i)
+                threadCpus[i] = cpus[i % cpus.size()];
+            return threadCpus;
+        }
+        auto nodes = utils::numaNodeCpus();
+        if (placement == CpuPlacement::xCompact)
+        {
+            std::vector<int> all;
+            for (auto &node : nodes)
+                all.insert(all.end(), node.begin(), node.end());
+            for (size_t i = 0; i < threadNum; ++i)
+                threadCpus[i] = all[i % all.size()];
+        }
+        else
+        {
+            for (size_t i = 0; i < threadNum; ++i)
+            {
+                auto &node = nodes[i % nodes.size()];
+                threadCpus[i] = node[(i / nodes.size()) % node.size()];
+            }
+        }
+        return threadCpus;
+    }
+
+    void EventLoopThreadPool::start()
+    {
+        for (unsigned int i = 0; i < loopThreadVector_.size(); ++i)
+        {
+            loopThreadVector_[i]->run();
+        }
+    }
+
+    void EventLoopThreadPool::wait()
+    {
+        for (unsigned int i = 0; i < loopThreadVector_.size(); ++i)
+        {
+            loopThreadVector_[i]->wait();
+        }
+    }
+
+    EventLoop *EventLoopThreadPool::getNextLoop()
+    {
+        if (loopThreadVector_.size() > 0)
+        {
+            size_t index = loopIndex_.fetch_add(1, std::memory_order_relaxed);
+            EventLoop *loop =
+                loopThreadVector_[index % loopThreadVector_.size()]->getLoop();
+            return loop;
+        }
+        return nullptr;
+    }
+
+    EventLoop *EventLoopThreadPool::getLoop(size_t id)
+    {
+        if (id < loopThreadVector_.size())
+            return loopThreadVector_[id]->getLoop();
+        return nullptr;
+    }
+
+    std::vector<EventLoop *> EventLoopThreadPool::getLoops() const
+    {
+        std::vector<EventLoop *> ret;
+        for (auto &loopThread : loopThreadVector_)
+        {
+            ret.push_back(loopThread->getLoop());
+        }
+        return ret;
+    }
+
+    int EventLoopThreadPool::getCpu(size_t id) const
+    {
+        if (id < loopThreadVector_.size())
+            return loopThreadVector_[id]->cpu();
+        return -1;
+    }
+} // namespace xiao
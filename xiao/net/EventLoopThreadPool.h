@@ -0,0 +1,130 @@
+/**
+ * @file EventLoopThreadPool.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/EventLoopThread.h>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+namespace xiao
+{
+    /**
+     * @brief This enum decides how the threads of an EventLoopThreadPool are
+     * placed on the CPUs.
+     *
+     */
+    enum class CpuPlacement
+    {
+        /// The threads are not pinned.
+        xNone,
+        /// Fill the CPUs of one NUMA node before using the next one.
+        xCompact,
+        /// Distribute the threads round-robin over the NUMA nodes.
+        xSpread,
+        /// Use the CPUs given by the user, in order.
+        xExplicit
+    };
+
+    /**
+     * @brief This class represents a pool of EventLoopThread objects
+     *
+     */
+    class XIAO_EXPORT EventLoopThreadPool : NonCopyable
+    {
+    public:
+        EventLoopThreadPool() = delete;
+
+        /**
+         * @brief Construct a new event loop thread pool instance.
+         *
+         * @param threadNum The number of threads
+         * @param name The name of the EventLoopThreadPool object.
+         * @param placement How the threads are pinned to the CPUs.
+         * @param cpus The CPUs used by CpuPlacement::xExplicit, the i-th thread
+         * is pinned to cpus[i % cpus.size()].
+         */
+        EventLoopThreadPool(size_t threadNum,
+                            const std::string &name = "EventLoopThreadPool",
+                            CpuPlacement placement = CpuPlacement::xNone,
+                            const std::vector<int> &cpus = {});
+
+        /**
+         * @brief Run all event loops in the pool.
+         * @note This function doesn't block the current thread.
+         */
+        void start();
+
+        /**
+         * @brief Wait for all event loops in the pool to quit.
+         *
+         * @note This function blocks the current thread.
+         */
+        void wait();
+
+        /**
+         * @brief Return the number of the event loop.
+         *
+         * @return size_t
+         */
+        size_t size()
+        {
+            return loopThreadVector_.size();
+        }
+
+        /**
+         * @brief Get the next event loop in the pool.
+         *
+         * @return EventLoop*
+         */
+        EventLoop *getNextLoop();
+
+        /**
+         * @brief Get the event loop in the `id` position in the pool.
+         *
+         * @param id The id of the first event loop is zero. If the id >= the
+         * number of event loops, nullptr is returned.
+         * @return EventLoop*
+         */
+        EventLoop *getLoop(size_t id);
+
+        /**
+         * @brief Get all event loops in the pool.
+         *
+         * @return std::vector<EventLoop *>
+         */
+        std::vector<EventLoop *> getLoops() const;
+
+        /**
+         * @brief Get the CPU the `id`-th thread is pinned to, -1 if it floats.
+         *
+         * @param id
+         * @return int
+         */
+        int getCpu(size_t id) const;
+
+        /**
+         * @brief Compute the CPU of every thread for a placement policy.
+         *
+         * @param threadNum
+         * @param placement
+         * @param cpus The CPUs used by CpuPlacement::xExplicit.
+         * @return std::vector<int> -1 for the threads that are not pinned.
+         */
+        static std::vector<int> placeThreads(size_t threadNum,
+                                             CpuPlacement placement,
+                                             const std::vector<int> &cpus = {});
+
+    private:
+        std::vector<std::shared_ptr<EventLoopThread>> loopThreadVector_;
+        std::atomic<size_t> loopIndex_;
+    };
+} // namespace xiao
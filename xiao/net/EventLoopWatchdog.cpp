@@ -0,0 +1,261 @@
+/**
+ * @file EventLoopWatchdog.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopWatchdog.h>
+#include <xiao/net/EventLoop.h>
+#include <xiao/utils/Logger.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <utility>
+#ifdef __linux__
+#include <errno.h>
+#include <execinfo.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+namespace xiao
+{
+#ifdef __linux__
+    namespace
+    {
+        const int xMaxFrames = 64;
+        void *g_frames[xMaxFrames];
+        int g_depth{0};
+        // Only one stack can be captured at a time in the process, the
+        // captures are numbered under the lock.
+        std::mutex g_captureMutex;
+        uint64_t g_generation{0};
+        // The capture requested from the thread, 0 when none is. The handler
+        // claims it by resetting it, so a signal delivered late, or to another
+        // thread, can't write the frames of a later capture.
+        std::atomic<uint64_t> g_requested{0};
+        std::atomic<pthread_t> g_target{};
+        // The last capture whose frames are written.
+        std::atomic<uint64_t> g_captured{0};
+
+        void captureStack(int)
+        {
+            int savedErrno = errno;
+            uint64_t gen = g_requested.load(std::memory_order_acquire);
+            if (gen != 0 &&
+                pthread_equal(g_target.load(std::memory_order_relaxed),
+                              pthread_self()) &&
+                g_requested.compare_exchange_strong(gen, 0, std::memory_order_acq_rel))
+            {
+                g_depth = backtrace(g_frames, xMaxFrames);
+                g_captured.store(gen, std::memory_order_release);
+            }
+            errno = savedErrno;
+        }
+    } // namespace
+#endif
+
+    EventLoopWatchdog::EventLoopWatchdog(std::chrono::milliseconds threshold,
+                                         int signo)
+        : threshold_(threshold), signo_(signo)
+    {
+    }
+
+    EventLoopWatchdog::~EventLoopWatchdog()
+    {
+        stop();
+    }
+
+    void EventLoopWatchdog::watch(EventLoop *loop)
+    {
+        loop->runInLoop([this, loop]()
+                        {
+            Entry entry;
+            entry.loop = loop;
+#ifndef _WIN32
+            entry.thread = pthread_self();
+#endif
+            entry.lastBeat = loop->heartbeat();
+            entry.since = std::chrono::steady_clock::now();
+            entry.reported = false;
+            std::lock_guard<std::mutex> lock(mutex_);
+            entries_.push_back(entry); });
+    }
+
+    void EventLoopWatchdog::unwatch(EventLoop *loop)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        entries_.erase(std::remove_if(entries_.begin(),
+                                      entries_.end(),
+                                      [loop](const Entry &entry)
+                                      { return entry.loop == loop; }),
+                       entries_.end());
+        // The loop may be destroyed once this returns, so wait for a report
+        // on it to finish.
+        reportDone_.wait(lock, [this, loop]()
+                         { return reportingLoop_ != loop; });
+    }
+
+    void EventLoopWatchdog::start()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_)
+            return;
+#ifdef __linux__
+        if (signo_ != 0)
+        {
+            // backtrace() loads libgcc on its first call, which is not safe in a
+            // signal handler.
+            void *frame;
+            backtrace(&frame, 1);
+            struct sigaction sa;
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_handler = captureStack;
+            sa.sa_flags = SA_RESTART;
+            sigemptyset(&sa.sa_mask);
+            if (sigaction(signo_, &sa, nullptr) != 0)
+            {
+                LOG_SYSERR << "EventLoopWatchdog sigaction";
+            }
+        }
+#endif
+        running_ = true;
+        thread_ = std::thread([this]()
+                              { run(); });
+    }
+
+    void EventLoopWatchdog::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_)
+                return;
+            running_ = false;
+        }
+        cond_.notify_all();
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    void EventLoopWatchdog::run()
+    {
+        // A stall is measured from the first tick that saw the heartbeat, so it
+        // is reported at most a quarter of the threshold late.
+        auto tick = std::max<std::chrono::milliseconds>(threshold_ / 4,
+                                                        std::chrono::milliseconds(1));
+        std::vector<std::pair<Entry, std::chrono::milliseconds>> stalledEntries;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_)
+        {
+            cond_.wait_for(lock, tick);
+            if (!running_)
+                break;
+            auto now = std::chrono::steady_clock::now();
+            stalledEntries.clear();
+            for (auto &entry : entries_)
+            {
+                auto beat = entry.loop->heartbeat();
+                if (beat != entry.lastBeat)
+                {
+                    entry.lastBeat = beat;
+                    entry.since = now;
+                    entry.reported = false;
+                    continue;
+                }
+                // An even heartbeat means the loop is waiting for events.
+                if ((beat & 1) == 0 || entry.reported)
+                    continue;
+                auto stalled = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    now - entry.since);
+                if (stalled >= threshold_)
+                {
+                    entry.reported = true;
+                    stalledEntries.emplace_back(entry, stalled);
+                }
+            }
+            // The stacks are captured without the lock, which can take up to
+            // 100ms per loop, so watch() and unwatch() don't wait for them.
+            for (auto &stalled : stalledEntries)
+            {
+                auto loop = stalled.first.loop;
+                if (std::none_of(entries_.begin(),
+                                 entries_.end(),
+                                 [loop](const Entry &entry)
+                                 { return entry.loop == loop; }))
+                    continue;
+                reportingLoop_ = loop;
+                lock.unlock();
+                report(stalled.first, stalled.second);
+                lock.lock();
+                reportingLoop_ = nullptr;
+                reportDone_.notify_all();
+                if (!running_)
+                    break;
+            }
+        }
+    }
+
+    void EventLoopWatchdog::report(const Entry &entry,
+                                   std::chrono::milliseconds stalled)
+    {
+        LOG_ERROR << "EventLoop " << entry.loop->index()
+                  << " has been stuck in callbacks for " << stalled.count()
+                  << "ms";
+#ifdef __linux__
+        if (signo_ == 0)
+            return;
+        std::lock_guard<std::mutex> lock(g_captureMutex);
+        uint64_t gen = ++g_generation;
+        g_target.store(entry.thread, std::memory_order_relaxed);
+        g_requested.store(gen, std::memory_order_release);
+        if (pthread_kill(entry.thread, signo_) != 0)
+        {
+            LOG_SYSERR << "EventLoopWatchdog pthread_kill";
+            g_requested.store(0, std::memory_order_relaxed);
+            return;
+        }
+        bool captured = false;
+        for (int i = 0; i < 100 && !captured; ++i)
+        {
+            captured = g_captured.load(std::memory_order_acquire) == gen;
+            if (!captured)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (!captured)
+        {
+            // Withdraw the request, unless the handler has claimed it, in which
+            // case it is writing the frames and is waited for, so the lock is
+            // not released while it runs.
+            uint64_t expected = gen;
+            if (g_requested.compare_exchange_strong(expected, 0, std::memory_order_acq_rel))
+            {
+                LOG_WARN << "Failed to capture the stack of EventLoop "
+                         << entry.loop->index();
+                return;
+            }
+            while (g_captured.load(std::memory_order_acquire) != gen)
+                std::this_thread::yield();
+        }
+        int depth = g_depth;
+        if (depth <= 0)
+            return;
+        char **symbols = backtrace_symbols(g_frames, depth);
+        if (!symbols)
+            return;
+        std::string stack;
+        // Skip the frames of the signal handler itself.
+        for (int i = 2; i < depth; ++i)
+        {
+            stack.append("\n    #").append(std::to_string(i - 2)).append(" ");
+            stack.append(symbols[i]);
+        }
+        free(symbols);
+        LOG_ERROR << "Stack of EventLoop " << entry.loop->index() << ":" << stack;
+#endif
+    }
+} // namespace xiao
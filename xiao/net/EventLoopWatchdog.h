@@ -0,0 +1,112 @@
+/**
+ * @file EventLoopWatchdog.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/exports.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+namespace xiao
+{
+    class EventLoop;
+
+    /**
+     * @brief This class implements a watchdog thread that reports event loops
+     * stuck in their callbacks. Each watched loop bumps its heartbeat twice per
+     * iteration, when the watchdog sees the same odd heartbeat for longer than
+     * the threshold, it logs the loop index, the stall duration and (on Linux)
+     * a stack trace of the stuck thread captured through a signal.
+     *
+     * @note A stall is reported once, the next report for the same loop needs
+     * the loop to make progress first.
+     */
+    class XIAO_EXPORT EventLoopWatchdog : NonCopyable
+    {
+    public:
+        /**
+         * @brief Construct a new watchdog.
+         *
+         * @param threshold The time a loop can stay in one iteration's callbacks
+         * before it is reported.
+         * @param signo The signal used to capture the stack of a stuck thread.
+         * Pass 0 to disable the stack capture.
+         */
+#ifdef _WIN32
+        explicit EventLoopWatchdog(std::chrono::milliseconds threshold,
+                                   int signo = 0);
+#else
+        explicit EventLoopWatchdog(std::chrono::milliseconds threshold,
+                                   int signo = SIGUSR2);
+#endif
+        ~EventLoopWatchdog();
+
+        /**
+         * @brief Watch the given event loop. The loop is registered from its own
+         * thread, so it starts being watched once it runs its queued functions.
+         *
+         * @param loop
+         * @note The loop must be unwatched before it is destroyed.
+         */
+        void watch(EventLoop *loop);
+
+        /**
+         * @brief Stop watching the given event loop.
+         *
+         * @param loop
+         */
+        void unwatch(EventLoop *loop);
+
+        /**
+         * @brief Start the watchdog thread.
+         *
+         */
+        void start();
+
+        /**
+         * @brief Stop the watchdog thread.
+         *
+         */
+        void stop();
+
+    private:
+        struct Entry
+        {
+            EventLoop *loop;
+#ifndef _WIN32
+            pthread_t thread;
+#endif
+            uint64_t lastBeat;
+            std::chrono::steady_clock::time_point since;
+            bool reported;
+        };
+        void run();
+        void report(const Entry &entry, std::chrono::milliseconds stalled);
+
+        const std::chrono::milliseconds threshold_;
+        const int signo_;
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::vector<Entry> entries_;
+        // The loop whose stack is being captured, unwatch() waits for it.
+        EventLoop *reportingLoop_{nullptr};
+        std::condition_variable reportDone_;
+        std::thread thread_;
+        bool running_{false};
+    };
+} // namespace xiao
@@ -0,0 +1,450 @@
+/**
+ * @file HotRestart.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/HotRestart.h>
+#ifdef __linux__
+#include <xiao/net/EventLoop.h>
+#include <xiao/net/Channel.h>
+#include <xiao/utils/Logger.h>
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace xiao
+{
+    namespace
+    {
+        // The messages of the handover, on a SOCK_SEQPACKET socket:
+        //   old -> new: xFdsMessage, then the NUL-terminated names of the fds
+        //               carried in SCM_RIGHTS, repeated as many times as needed
+        //   old -> new: xEndMessage
+        //   new -> old: xAckMessage
+        const char xFdsMessage = 'F';
+        const char xEndMessage = 'E';
+        const char xAckMessage = 'A';
+        const size_t xMaxFdsPerMessage = 64;
+        const size_t xMaxMessageSize = 64 * 1024;
+        // The time the new process has to receive the fds and acknowledge them.
+        const double xHandoverTimeout = 5.0;
+        // The name of the fds of the connections.
+        const char xConnectionFdName[] = "conn";
+
+        bool makeAddress(const std::string &path, struct sockaddr_un &addr)
+        {
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(addr.sun_path))
+            {
+                LOG_ERROR << "The hot restart socket path is too long: " << path;
+                return false;
+            }
+            memcpy(addr.sun_path, path.data(), path.size());
+            return true;
+        }
+
+        void setTimeout(int fd, int option, double seconds)
+        {
+            struct timeval tv;
+            tv.tv_sec = static_cast<time_t>(seconds);
+            tv.tv_usec = static_cast<suseconds_t>((seconds - tv.tv_sec) * 1000000);
+            ::setsockopt(fd, SOL_SOCKET, option, &tv, sizeof(tv));
+        }
+
+        bool sendFds(int sockfd, const InheritedFd *fds, size_t count)
+        {
+            std::string payload(1, xFdsMessage);
+            for (size_t i = 0; i < count; ++i)
+            {
+                payload.append(fds[i].name).push_back('\0');
+            }
+            if (payload.size() > xMaxMessageSize)
+            {
+                LOG_ERROR << "The names of the handed over fds are too long";
+                return false;
+            }
+            struct iovec iov;
+            iov.iov_base = &payload[0];
+            iov.iov_len = payload.size();
+            char control[CMSG_SPACE(sizeof(int) * xMaxFdsPerMessage)];
+            memset(control, 0, sizeof(control));
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+            auto cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+            auto data = reinterpret_cast<int *>(CMSG_DATA(cmsg));
+            for (size_t i = 0; i < count; ++i)
+            {
+                data[i] = fds[i].fd;
+            }
+            return ::sendmsg(sockfd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT) ==
+                   static_cast<ssize_t>(payload.size());
+        }
+
+        void closeFds(std::vector<InheritedFd> &fds)
+        {
+            for (auto &fd : fds)
+            {
+                ::close(fd.fd);
+            }
+            fds.clear();
+        }
+    } // namespace
+
+    HotRestart::HotRestart(EventLoop *loop, const std::string &path)
+        : loop_(loop), path_(path)
+    {
+    }
+
+    HotRestart::~HotRestart()
+    {
+        if (!handedOver_ && listenFd_ >= 0)
+        {
+            struct stat st;
+            if (::stat(path_.c_str(), &st) == 0 &&
+                static_cast<unsigned long>(st.st_ino) == inode_)
+            {
+                ::unlink(path_.c_str());
+            }
+        }
+        if (timerId_ != InvalidTimerId)
+            loop_->invalidateTimer(timerId_);
+        closeConnectionFds();
+        auto listenChlPtr = listenChannelPtr_;
+        auto listenFd = listenFd_;
+        auto connChlPtr = connChannelPtr_;
+        auto connFd = connFd_;
+        loop_->runInLoop([listenChlPtr, listenFd, connChlPtr, connFd]()
+                         {
+            if (listenChlPtr)
+            {
+                listenChlPtr->disableAll();
+                listenChlPtr->remove();
+                ::close(listenFd);
+            }
+            if (connChlPtr)
+            {
+                connChlPtr->disableAll();
+                connChlPtr->remove();
+                ::close(connFd);
+            } });
+    }
+
+    bool HotRestart::start()
+    {
+        loop_->assertInLoopThread();
+        assert(listenFd_ < 0);
+        struct sockaddr_un addr;
+        if (!makeAddress(path_, addr))
+            return false;
+        int fd = ::socket(AF_UNIX,
+                          SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                          0);
+        if (fd < 0)
+        {
+            LOG_SYSERR << "HotRestart socket";
+            return false;
+        }
+        ::unlink(path_.c_str());
+        if (::bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) <
+                0 ||
+            ::listen(fd, 1) < 0)
+        {
+            LOG_SYSERR << "HotRestart bind " << path_;
+            ::close(fd);
+            return false;
+        }
+        struct stat st;
+        if (::stat(path_.c_str(), &st) == 0)
+            inode_ = static_cast<unsigned long>(st.st_ino);
+        listenFd_ = fd;
+        listenChannelPtr_ = std::make_shared<Channel>(loop_, listenFd_);
+        listenChannelPtr_->setReadCallback(std::bind(&HotRestart::handleAccept, this));
+        listenChannelPtr_->enableReading();
+        return true;
+    }
+
+    void HotRestart::handleAccept()
+    {
+        int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+                LOG_SYSERR << "HotRestart accept";
+            return;
+        }
+        if (connFd_ >= 0)
+        {
+            LOG_WARN << "A hot restart is already in progress";
+            ::close(fd);
+            return;
+        }
+        // Only a process of the same user gets the fds.
+        struct ucred cred;
+        socklen_t len = sizeof(cred);
+        if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 ||
+            cred.uid != ::geteuid())
+        {
+            LOG_WARN << "Refused the hot restart of a process of another user";
+            ::close(fd);
+            return;
+        }
+        sendingFds_.clear();
+        if (fdsCallback_)
+            sendingFds_ = fdsCallback_();
+        connectionFds_.clear();
+        if (connectionsCallback_)
+            connectionFds_ = connectionsCallback_();
+        for (auto connFd : connectionFds_)
+        {
+            sendingFds_.push_back({xConnectionFdName, connFd});
+        }
+        nextFd_ = 0;
+        endSent_ = false;
+        connFd_ = fd;
+        connChannelPtr_ = std::make_shared<Channel>(loop_, connFd_);
+        connChannelPtr_->setReadCallback(std::bind(&HotRestart::handleAck, this));
+        connChannelPtr_->setWriteCallback(std::bind(&HotRestart::handleWrite, this));
+        connChannelPtr_->enableReading();
+        connChannelPtr_->enableWriting();
+        // The slot is given up if the new process doesn't finish in time.
+        timerId_ = loop_->runAfter(xHandoverTimeout, [this]() {
+            timerId_ = InvalidTimerId;
+            LOG_WARN << "The hot restart timed out";
+            closeConnection();
+        });
+    }
+
+    void HotRestart::handleWrite()
+    {
+        while (nextFd_ < sendingFds_.size())
+        {
+            size_t count = std::min(xMaxFdsPerMessage, sendingFds_.size() - nextFd_);
+            if (!sendFds(connFd_, &sendingFds_[nextFd_], count))
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                    return;
+                LOG_SYSERR << "Failed to send the fds for hot restart";
+                closeConnection();
+                return;
+            }
+            nextFd_ += count;
+        }
+        if (::send(connFd_, &xEndMessage, 1, MSG_NOSIGNAL) != 1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return;
+            LOG_SYSERR << "Failed to send the fds for hot restart";
+            closeConnection();
+            return;
+        }
+        LOG_INFO << "Sent " << sendingFds_.size() << " fds for hot restart";
+        endSent_ = true;
+        connChannelPtr_->disableWriting();
+        // The messages in flight keep the connections open.
+        closeConnectionFds();
+        sendingFds_.clear();
+    }
+
+    void HotRestart::handleAck()
+    {
+        char ack = 0;
+        ssize_t n = ::recv(connFd_, &ack, 1, 0);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR))
+            return;
+        bool acked = endSent_ && n == 1 && ack == xAckMessage;
+        closeConnection();
+        if (!acked)
+        {
+            // The new process failed, this process keeps serving.
+            LOG_WARN << "The new process did not take the fds over";
+            return;
+        }
+        LOG_INFO << "The fds are taken over, draining";
+        handedOver_ = true;
+        closeListener();
+        if (drainCallback_)
+            drainCallback_();
+    }
+
+    void HotRestart::closeConnectionFds()
+    {
+        for (auto fd : connectionFds_)
+        {
+            ::close(fd);
+        }
+        connectionFds_.clear();
+    }
+
+    void HotRestart::closeConnection()
+    {
+        if (timerId_ != InvalidTimerId)
+        {
+            loop_->invalidateTimer(timerId_);
+            timerId_ = InvalidTimerId;
+        }
+        // The detached connections which were not sent are closed.
+        closeConnectionFds();
+        sendingFds_.clear();
+        connChannelPtr_->disableAll();
+        connChannelPtr_->remove();
+        ::close(connFd_);
+        connFd_ = -1;
+        // The channel may be handling the current event, destroy it later.
+        auto chlPtr = std::move(connChannelPtr_);
+        loop_->queueInLoop([chlPtr]() {});
+    }
+
+    void HotRestart::closeListener()
+    {
+        listenChannelPtr_->disableAll();
+        listenChannelPtr_->remove();
+        ::close(listenFd_);
+        listenFd_ = -1;
+        listenChannelPtr_.reset();
+    }
+
+    std::vector<InheritedFd> HotRestart::takeOver(const std::string &path,
+                                                  double timeout)
+    {
+        std::vector<InheritedFd> fds;
+        struct sockaddr_un addr;
+        if (!makeAddress(path, addr))
+            return fds;
+        int sockfd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (sockfd < 0)
+        {
+            LOG_SYSERR << "HotRestart socket";
+            return fds;
+        }
+        if (::connect(sockfd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) <
+            0)
+        {
+            // No process to take over from, this is a cold start.
+            ::close(sockfd);
+            return fds;
+        }
+        setTimeout(sockfd, SO_RCVTIMEO, timeout);
+        std::string payload(xMaxMessageSize, '\0');
+        char control[CMSG_SPACE(sizeof(int) * xMaxFdsPerMessage)];
+        while (true)
+        {
+            struct iovec iov;
+            iov.iov_base = &payload[0];
+            iov.iov_len = payload.size();
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            ssize_t n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+            if (n <= 0)
+            {
+                LOG_SYSERR << "Failed to receive the fds for hot restart";
+                closeFds(fds);
+                break;
+            }
+            size_t first = fds.size();
+            for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            {
+                if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                    continue;
+                size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                auto data = reinterpret_cast<int *>(CMSG_DATA(cmsg));
+                for (size_t i = 0; i < count; ++i)
+                {
+                    fds.push_back({std::string(), data[i]});
+                }
+            }
+            if (payload[0] == xEndMessage)
+            {
+                if (::send(sockfd, &xAckMessage, 1, MSG_NOSIGNAL) != 1)
+                {
+                    LOG_SYSERR << "Failed to acknowledge the hot restart";
+                    closeFds(fds);
+                }
+                break;
+            }
+            // Name the fds of this message.
+            size_t pos = 1;
+            size_t i = first;
+            while (pos < static_cast<size_t>(n) && i < fds.size())
+            {
+                size_t end = payload.find('\0', pos);
+                if (end == std::string::npos || end >= static_cast<size_t>(n))
+                    break;
+                fds[i++].name = payload.substr(pos, end - pos);
+                pos = end + 1;
+            }
+            if (payload[0] != xFdsMessage || (msg.msg_flags & MSG_CTRUNC) ||
+                i != fds.size())
+            {
+                LOG_ERROR << "Malformed hot restart message";
+                closeFds(fds);
+                break;
+            }
+        }
+        ::close(sockfd);
+        return fds;
+    }
+
+    std::unique_ptr<TcpServer> HotRestart::adoptListener(
+        EventLoop *loop,
+        const std::vector<InheritedFd> &fds,
+        const std::string &name,
+        std::string serverName)
+    {
+        auto iter = std::find_if(fds.begin(), fds.end(), [&name](const InheritedFd &fd) {
+            return fd.name == name;
+        });
+        if (iter == fds.end())
+            return nullptr;
+        int fd = ::fcntl(iter->fd, F_DUPFD_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            LOG_SYSERR << "Failed to adopt the listening socket " << name;
+            return nullptr;
+        }
+        return std::unique_ptr<TcpServer>(new TcpServer(loop, fd, std::move(serverName)));
+    }
+
+    size_t HotRestart::adoptConnections(TcpServer *server, std::vector<InheritedFd> &fds)
+    {
+        size_t count = 0;
+        auto iter = fds.begin();
+        while (iter != fds.end())
+        {
+            if (iter->name != xConnectionFdName)
+            {
+                ++iter;
+                continue;
+            }
+            server->adoptConnection(iter->fd);
+            iter = fds.erase(iter);
+            ++count;
+        }
+        LOG_INFO << "Adopted " << count << " connections for hot restart";
+        return count;
+    }
+} // namespace xiao
+#endif
@@ -0,0 +1,208 @@
+/**
+ * @file HotRestart.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#ifdef __linux__
+#include <xiao/net/TcpServer.h>
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/exports.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace xiao
+{
+    class EventLoop;
+    class Channel;
+
+    /**
+     * @brief A file descriptor handed over from the old process to the new one.
+     * The name lets the new process tell the fds apart, e.g. "listen:8080".
+     *
+     */
+    struct InheritedFd
+    {
+        std::string name;
+        int fd;
+    };
+
+    /**
+     * @brief This class implements the hot restart, the listening sockets (and
+     * optionally the idle connections) of a running process are passed to its
+     * replacement over a Unix socket with SCM_RIGHTS, so there is no time
+     * during a deploy when connections are refused.
+     *
+     * The old process serves the handover on a Unix socket path from its event
+     * loop, to processes of the same user only. The new process calls
+     * takeOver() with the same path before it starts accepting, adopts the fds
+     * it receives into its event loops, and then serves the path itself for
+     * the next restart. Once the new process acknowledges the fds, the drain
+     * callback runs in the old process, which should stop accepting, close the
+     * listening fds it handed over and quit when its remaining connections are
+     * done.
+     *
+     * The idle connections are detached from the old process (see
+     * TcpServer::detachIdleConnections()), so it stops polling them before
+     * they are sent, and the new process adopts them into a server with
+     * adoptConnections().
+     *
+     * @code
+       // In the new process, before creating the listening sockets:
+       auto fds = xiao::HotRestart::takeOver("/run/app.sock");
+       auto server = xiao::HotRestart::adoptListener(&loop, fds, "listen:8080",
+                                                     "app");
+       if (!server)
+           server.reset(new xiao::TcpServer(&loop, addr, "app"));
+       ...
+       server->start();
+       xiao::HotRestart::adoptConnections(server.get(), fds);
+       xiao::HotRestart restart(&loop, "/run/app.sock");
+       restart.setFdsCallback([&]() { return listeningFds; });
+       restart.setConnectionsCallback(
+           [&]() { return server->detachIdleConnections(); });
+       restart.setDrainCallback([&]() { stopAccepting(); });
+       restart.start();
+       @endcode
+     */
+    class XIAO_EXPORT HotRestart : NonCopyable
+    {
+    public:
+        using FdsCallback = std::function<std::vector<InheritedFd>()>;
+        using ConnectionsCallback = std::function<std::vector<int>()>;
+        using DrainCallback = std::function<void()>;
+
+        /**
+         * @brief Construct a new hot restart server.
+         *
+         * @param loop The event loop serving the handover.
+         * @param path The path of the Unix socket.
+         */
+        HotRestart(EventLoop *loop, const std::string &path);
+        ~HotRestart();
+
+        /**
+         * @brief Set the callback returning the fds to hand over, it is called
+         * in the loop thread when a new process connects. The fds stay open in
+         * this process.
+         *
+         * @param cb
+         */
+        void setFdsCallback(const FdsCallback &cb)
+        {
+            fdsCallback_ = cb;
+        }
+
+        /**
+         * @brief Set the callback returning the fds of the detached connections
+         * to hand over, it is called in the loop thread after the fds callback.
+         * This process owns the fds and closes them once they are sent, or if
+         * the handover fails.
+         *
+         * @param cb
+         */
+        void setConnectionsCallback(const ConnectionsCallback &cb)
+        {
+            connectionsCallback_ = cb;
+        }
+
+        /**
+         * @brief Set the callback called in the loop thread when the new
+         * process has received the fds.
+         *
+         * @param cb
+         */
+        void setDrainCallback(const DrainCallback &cb)
+        {
+            drainCallback_ = cb;
+        }
+
+        /**
+         * @brief Start serving the handover. A stale socket file left at the
+         * path is removed.
+         *
+         * @return true if the Unix socket is listening.
+         */
+        bool start();
+
+        /**
+         * @brief Take the fds over from the process serving the handover on the
+         * given path. It blocks until all the fds are received.
+         *
+         * @param path
+         * @param timeout The maximum time in seconds to wait for the old
+         * process.
+         * @return std::vector<InheritedFd> The received fds, with the
+         * close-on-exec flag set. It is empty when no process serves the path.
+         */
+        static std::vector<InheritedFd> takeOver(const std::string &path,
+                                                 double timeout = 5.0);
+
+        /**
+         * @brief Adopt the listening socket of the given name into a server
+         * accepting in the loop. The server owns a duplicate of the fd, so the
+         * fds can still be handed over to the next process.
+         *
+         * @param loop The event loop of the server.
+         * @param fds The fds received by takeOver() or created by a
+         * WorkerProcessPool.
+         * @param name The name of the fd.
+         * @param serverName The name of the server.
+         * @return std::unique_ptr<TcpServer> nullptr if no fd has the name.
+         */
+        static std::unique_ptr<TcpServer> adoptListener(EventLoop *loop,
+                                                        const std::vector<InheritedFd> &fds,
+                                                        const std::string &name,
+                                                        std::string serverName);
+
+        /**
+         * @brief Adopt the connections received by takeOver() into the server.
+         *
+         * @param server The server, it must be started.
+         * @param fds The fds received, the fds of the connections are removed
+         * from it and owned by the server.
+         * @return size_t The number of the connections adopted.
+         * @note It must be called in the loop of the server.
+         */
+        static size_t adoptConnections(TcpServer *server, std::vector<InheritedFd> &fds);
+
+    private:
+        void handleAccept();
+        // Send the fds as far as the socket takes them, then the end marker.
+        void handleWrite();
+        void handleAck();
+        void closeConnection();
+        void closeConnectionFds();
+        void closeListener();
+
+        EventLoop *loop_;
+        std::string path_;
+        int listenFd_{-1};
+        int connFd_{-1};
+        std::shared_ptr<Channel> listenChannelPtr_;
+        std::shared_ptr<Channel> connChannelPtr_;
+        FdsCallback fdsCallback_;
+        ConnectionsCallback connectionsCallback_;
+        DrainCallback drainCallback_;
+        // The fds of the handover in progress, sent from nextFd_ on.
+        std::vector<InheritedFd> sendingFds_;
+        size_t nextFd_{0};
+        bool endSent_{false};
+        // The fds of the connections handed over, owned by this object.
+        std::vector<int> connectionFds_;
+        TimerId timerId_{InvalidTimerId};
+        // The inode of the socket file, the file is only removed if it has not
+        // been replaced by the new process.
+        unsigned long inode_{0};
+        bool handedOver_{false};
+    };
+} // namespace xiao
+#endif
@@ -0,0 +1,240 @@
+/**
+ * @file InetAddress.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/InetAddress.h>
+#include <algorithm>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+namespace xiao
+{
+    static const in_addr_t xInaddrAny = INADDR_ANY;
+    static const in_addr_t xInaddrLoopback = INADDR_LOOPBACK;
+
+    // the IPv4 private ranges: 10.0.0.0/8, 172.16.0.0/12 and 192.168.0.0/16
+    static bool isIntranetIpV4(uint32_t ip)
+    {
+        return (ip >= 0x0A000000 && ip <= 0x0AFFFFFF) ||
+               (ip >= 0xAC100000 && ip <= 0xAC1FFFFF) ||
+               (ip >= 0xC0A80000 && ip <= 0xC0A8FFFF) || ip == 0x7f000001;
+    }
+
+    InetAddress::InetAddress(uint16_t port, bool loopbackOnly, bool ipv6)
+        : isIpV6_(ipv6)
+    {
+        if (ipv6)
+        {
+            memset(&addr6_, 0, sizeof(addr6_));
+            addr6_.sin6_family = AF_INET6;
+            in6_addr ip = loopbackOnly ? in6addr_loopback : in6addr_any;
+            addr6_.sin6_addr = ip;
+            addr6_.sin6_port = htons(port);
+        }
+        else
+        {
+            memset(&addr_, 0, sizeof(addr_));
+            addr_.sin_family = AF_INET;
+            in_addr_t ip = loopbackOnly ? xInaddrLoopback : xInaddrAny;
+            addr_.sin_addr.s_addr = htonl(ip);
+            addr_.sin_port = htons(port);
+        }
+        isUnspecified_ = false;
+    }
+
+    InetAddress::InetAddress(const std::string &ip, uint16_t port, bool ipv6)
+        : isIpV6_(ipv6)
+    {
+        if (ipv6)
+        {
+            memset(&addr6_, 0, sizeof(addr6_));
+            addr6_.sin6_family = AF_INET6;
+            addr6_.sin6_port = htons(port);
+            if (::inet_pton(AF_INET6, ip.c_str(), &addr6_.sin6_addr) <= 0)
+            {
+                return;
+            }
+        }
+        else
+        {
+            memset(&addr_, 0, sizeof(addr_));
+            addr_.sin_family = AF_INET;
+            addr_.sin_port = htons(port);
+            if (::inet_pton(AF_INET, ip.c_str(), &addr_.sin_addr) <= 0)
+            {
+                return;
+            }
+        }
+        isUnspecified_ = false;
+    }
+
+#ifndef _WIN32
+    InetAddress InetAddress::fromUnixPath(const std::string &path)
+    {
+        InetAddress addr;
+        // The path is NUL terminated.
+        if (path.empty() || path.length() >= sizeof(addr.addrUn_.sun_path))
+        {
+            addr.isUnspecified_ = true;
+            return addr;
+        }
+        memset(&addr.addrUn_, 0, sizeof(addr.addrUn_));
+        addr.addrUn_.sun_family = AF_UNIX;
+        memcpy(addr.addrUn_.sun_path, path.data(), path.length());
+        addr.unixLen_ =
+            static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + path.length() + 1);
+        return addr;
+    }
+
+    InetAddress InetAddress::fromAbstractName(const std::string &name)
+    {
+        InetAddress addr;
+        // The name follows a NUL byte and its length is given by the length
+        // of the address.
+        if (name.length() + 1 > sizeof(addr.addrUn_.sun_path))
+        {
+            addr.isUnspecified_ = true;
+            return addr;
+        }
+        memset(&addr.addrUn_, 0, sizeof(addr.addrUn_));
+        addr.addrUn_.sun_family = AF_UNIX;
+        memcpy(addr.addrUn_.sun_path + 1, name.data(), name.length());
+        addr.unixLen_ =
+            static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + name.length() + 1);
+        return addr;
+    }
+#endif
+
+    void InetAddress::setSockAddr(const struct sockaddr *addr, socklen_t len)
+    {
+        isUnspecified_ = false;
+#ifndef _WIN32
+        if (addr->sa_family == AF_UNIX)
+        {
+            memset(&addrUn_, 0, sizeof(addrUn_));
+            unixLen_ = (std::min)(len, static_cast<socklen_t>(sizeof(addrUn_)));
+            memcpy(&addrUn_, addr, unixLen_);
+            // An unnamed socket has no path.
+            addrUn_.sun_family = AF_UNIX;
+            isIpV6_ = false;
+            return;
+        }
+#endif
+        if (addr->sa_family == AF_INET6)
+        {
+            memcpy(&addr6_, addr, sizeof(addr6_));
+            isIpV6_ = true;
+        }
+        else
+        {
+            memcpy(&addr_, addr, sizeof(addr_));
+            isIpV6_ = false;
+        }
+        (void)len;
+    }
+
+    std::string InetAddress::toIpPort() const
+    {
+        if (isUnixDomain())
+            return toIp();
+        char buf[64] = "";
+        uint16_t port = ntohs(addr_.sin_port);
+        snprintf(buf, sizeof(buf), ":%u", port);
+        return toIp() + std::string(buf);
+    }
+
+    bool InetAddress::isIntranetIp() const
+    {
+        if (isUnixDomain())
+            return true;
+        if (addr_.sin_family == AF_INET)
+        {
+            return isIntranetIpV4(ntohl(addr_.sin_addr.s_addr));
+        }
+        auto addrP = ip6NetEndian();
+        // Loopback ip
+        if (*addrP == 0 && *(addrP + 1) == 0 && *(addrP + 2) == 0 &&
+            ntohl(*(addrP + 3)) == 1)
+            return true;
+        // Privated ip is prefixed by FEC0::/10 or FE80::/10
+        auto i32 = (ntohl(*addrP) & 0xffc00000);
+        if (i32 == 0xfec00000 || i32 == 0xfe800000)
+            return true;
+        if (*addrP == 0 && *(addrP + 1) == 0 && ntohl(*(addrP + 2)) == 0xffff)
+        {
+            // the IPv6 version of an IPv4 IP address
+            return isIntranetIpV4(ntohl(*(addrP + 3)));
+        }
+        return false;
+    }
+
+    bool InetAddress::isLoopbackIp() const
+    {
+        if (isUnixDomain())
+            return true;
+        if (!isIpV6())
+        {
+            return ntohl(addr_.sin_addr.s_addr) == 0x7f000001;
+        }
+        auto addrP = ip6NetEndian();
+        if (*addrP == 0 && *(addrP + 1) == 0 && *(addrP + 2) == 0 &&
+            ntohl(*(addrP + 3)) == 1)
+            return true;
+        // the IPv6 version of an IPv4 loopback address
+        if (*addrP == 0 && *(addrP + 1) == 0 && ntohl(*(addrP + 2)) == 0xffff &&
+            ntohl(*(addrP + 3)) == 0x7f000001)
+            return true;
+        return false;
+    }
+
+    std::string InetAddress::toIp() const
+    {
+        char buf[64] = "";
+        if (addr_.sin_family == AF_INET)
+        {
+            ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof(buf));
+        }
+        else if (addr_.sin_family == AF_INET6)
+        {
+            ::inet_ntop(AF_INET6, &addr6_.sin6_addr, buf, sizeof(buf));
+        }
+#ifndef _WIN32
+        else if (addr_.sin_family == AF_UNIX)
+        {
+            size_t offset = offsetof(struct sockaddr_un, sun_path);
+            if (unixLen_ <= offset)
+                return std::string();
+            size_t len = unixLen_ - offset;
+            if (addrUn_.sun_path[0] == '\0')
+                return "@" + std::string(addrUn_.sun_path + 1, len - 1);
+            return std::string(addrUn_.sun_path, strnlen(addrUn_.sun_path, len));
+        }
+#endif
+        return buf;
+    }
+
+    uint32_t InetAddress::ipNetEndian() const
+    {
+        return addr_.sin_addr.s_addr;
+    }
+
+    const uint32_t *InetAddress::ip6NetEndian() const
+    {
+        return static_cast<const uint32_t *>((const void *)&addr6_.sin6_addr);
+    }
+
+    uint16_t InetAddress::toPort() const
+    {
+        if (isUnixDomain())
+            return 0;
+        return ntohs(portNetEndian());
+    }
+} // namespace xiao
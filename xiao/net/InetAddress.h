@@ -0,0 +1,281 @@
+/**
+ * @file InetAddress.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/exports.h>
+#include <string>
+#include <stdint.h>
+#ifdef _WIN32
+#include <ws2tcpip.h>
+using sa_family_t = unsigned short;
+using in_addr_t = uint32_t;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+namespace xiao
+{
+    /**
+     * @brief Wrapper of sockaddr_in, sockaddr_in6 and sockaddr_un. This is an
+     * POD interface class.
+     *
+     */
+    class XIAO_EXPORT InetAddress
+    {
+    public:
+        /**
+         * @brief Constructs an endpoint with given port number. Mostly used in
+         * TcpServer listening.
+         *
+         * @param port
+         * @param loopbackOnly
+         * @param ipv6
+         */
+        InetAddress(uint16_t port = 0, bool loopbackOnly = false, bool ipv6 = false);
+
+        /**
+         * @brief Constructs an endpoint with given ip and port.
+         *
+         * @param ip A IPv4 or IPv6 address.
+         * @param port
+         * @param ipv6
+         */
+        InetAddress(const std::string &ip, uint16_t port, bool ipv6 = false);
+
+        /**
+         * @brief Constructs an endpoint with given struct `sockaddr_in`. Mostly
+         * used when accepting new connections
+         *
+         * @param addr
+         */
+        explicit InetAddress(const struct sockaddr_in &addr)
+            : addr_(addr), isUnspecified_(false)
+        {
+        }
+
+        /**
+         * @brief Constructs an IPv6 endpoint with given struct `sockaddr_in6`.
+         * Mostly used when accepting new connections
+         *
+         * @param addr
+         */
+        explicit InetAddress(const struct sockaddr_in6 &addr)
+            : addr6_(addr), isIpV6_(true), isUnspecified_(false)
+        {
+        }
+
+#ifndef _WIN32
+        /**
+         * @brief Constructs a Unix domain endpoint with the path of a socket
+         * file.
+         *
+         * @param path
+         * @return InetAddress An unspecified address if the path is too long.
+         */
+        static InetAddress fromUnixPath(const std::string &path);
+
+        /**
+         * @brief Constructs a Unix domain endpoint in the Linux abstract
+         * namespace, which has no file and disappears with the socket.
+         *
+         * @param name The name, without the leading NUL byte.
+         * @return InetAddress An unspecified address if the name is too long.
+         */
+        static InetAddress fromAbstractName(const std::string &name);
+#endif
+
+        /**
+         * @brief Return the sin_family of the endpoint.
+         *
+         * @return sa_family_t
+         */
+        sa_family_t family() const
+        {
+            return addr_.sin_family;
+        }
+
+        /**
+         * @brief Return the IP string of the endpoint, the path of a Unix
+         * domain one, or its name after '@' in the abstract namespace.
+         *
+         * @return std::string
+         */
+        std::string toIp() const;
+
+        /**
+         * @brief Return the IP and port string of the endpoint, as toIp() for
+         * a Unix domain one.
+         *
+         * @return std::string
+         */
+        std::string toIpPort() const;
+
+        /**
+         * @brief Return the port number of the endpoint, 0 for a Unix domain
+         * one.
+         *
+         * @return uint16_t
+         */
+        uint16_t toPort() const;
+
+        /**
+         * @brief Check if the endpoint is IPv6.
+         *
+         * @return true
+         * @return false
+         */
+        bool isIpV6() const
+        {
+            return isIpV6_;
+        }
+
+        /**
+         * @brief Check if the endpoint is a Unix domain one.
+         *
+         * @return true
+         * @return false
+         */
+        bool isUnixDomain() const
+        {
+#ifndef _WIN32
+            return addr_.sin_family == AF_UNIX;
+#else
+            return false;
+#endif
+        }
+
+        /**
+         * @brief Return true if the endpoint is an intranet endpoint, which a
+         * Unix domain one is.
+         *
+         * @return true
+         * @return false
+         */
+        bool isIntranetIp() const;
+
+        /**
+         * @brief Return true if the endpoint is a loopback endpoint, which a
+         * Unix domain one is.
+         *
+         * @return true
+         * @return false
+         */
+        bool isLoopbackIp() const;
+
+        /**
+         * @brief Get the pointer to the sockaddr struct.
+         *
+         * @return const struct sockaddr*
+         */
+        const struct sockaddr *getSockAddr() const
+        {
+            return static_cast<const struct sockaddr *>((void *)(&addr6_));
+        }
+
+        /**
+         * @brief Return the length of the sockaddr struct, as passed to bind()
+         * and connect().
+         *
+         * @return socklen_t
+         */
+        socklen_t getSockAddrLen() const
+        {
+            if (isUnixDomain())
+                return unixLen_;
+            return isIpV6_ ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+        }
+
+        /**
+         * @brief Set the sockaddr_in6 struct in the endpoint.
+         *
+         * @param addr6
+         */
+        void setSockAddrInet6(const struct sockaddr_in6 &addr6)
+        {
+            addr6_ = addr6;
+            isIpV6_ = (addr6_.sin6_family == AF_INET6);
+            isUnspecified_ = false;
+        }
+
+        /**
+         * @brief Set the endpoint from a sockaddr struct of any family, as
+         * returned by accept(), getsockname() or getpeername().
+         *
+         * @param addr
+         * @param len The length of the struct.
+         */
+        void setSockAddr(const struct sockaddr *addr, socklen_t len);
+
+        /**
+         * @brief Return the integer value of the IP(v4) in net endian byte
+         * order.
+         *
+         * @return uint32_t
+         */
+        uint32_t ipNetEndian() const;
+
+        /**
+         * @brief Return the pointer to the integer value of the IP(v6) in net
+         * endian byte order.
+         *
+         * @return const uint32_t*
+         */
+        const uint32_t *ip6NetEndian() const;
+
+        /**
+         * @brief Return the port number in net endian byte order.
+         *
+         * @return uint16_t
+         */
+        uint16_t portNetEndian() const
+        {
+            return addr_.sin_port;
+        }
+
+        /**
+         * @brief Set the port number in net endian byte order.
+         *
+         * @param port
+         */
+        void setPortNetEndian(uint16_t port)
+        {
+            addr_.sin_port = port;
+        }
+
+        /**
+         * @brief Return true if the address is not initalized.
+         *
+         * @return true
+         * @return false
+         */
+        bool isUnspecified() const
+        {
+            return isUnspecified_;
+        }
+
+    private:
+        union
+        {
+            struct sockaddr_in addr_;
+            struct sockaddr_in6 addr6_;
+#ifndef _WIN32
+            struct sockaddr_un addrUn_;
+#endif
+        };
+        bool isIpV6_{false};
+        // The length of a Unix domain address, which depends on the path.
+        socklen_t unixLen_{0};
+        bool isUnspecified_{true};
+    };
+} // namespace xiao
@@ -0,0 +1,175 @@
+/**
+ * @file LengthFieldCodec.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/LengthFieldCodec.h>
+#include <xiao/utils/Funcs.h>
+#include <xiao/utils/Logger.h>
+#include <string.h>
+
+namespace xiao
+{
+    static const size_t xMaxVarintLength = 10;
+
+    LengthFieldCodec::LengthFieldCodec(LengthField field,
+                                       size_t maxFrameSize,
+                                       FrameCallback cb)
+        : field_(field), maxFrameSize_(maxFrameSize), frameCallback_(std::move(cb))
+    {
+        auto width = static_cast<size_t>(field_);
+        if (width > 0 && width < sizeof(uint64_t))
+        {
+            size_t limit = (static_cast<size_t>(1) << (width * 8)) - 1;
+            if (maxFrameSize_ > limit)
+                maxFrameSize_ = limit;
+        }
+    }
+
+    size_t LengthFieldCodec::headerLength(size_t len) const
+    {
+        if (field_ != LengthField::xVarint)
+            return static_cast<size_t>(field_);
+        size_t n = 1;
+        while (len >= 0x80)
+        {
+            len >>= 7;
+            ++n;
+        }
+        return n;
+    }
+
+    size_t LengthFieldCodec::writeHeader(char *header, size_t len) const
+    {
+        if (field_ == LengthField::xVarint)
+        {
+            size_t n = 0;
+            uint64_t value = len;
+            while (value >= 0x80)
+            {
+                header[n++] = static_cast<char>((value & 0x7f) | 0x80);
+                value >>= 7;
+            }
+            header[n++] = static_cast<char>(value);
+            return n;
+        }
+        // The low bytes of the big-endian 64-bit length.
+        auto width = static_cast<size_t>(field_);
+        uint64_t be = hton64(len);
+        memcpy(header, reinterpret_cast<const char *>(&be) + sizeof(be) - width, width);
+        return width;
+    }
+
+    ssize_t LengthFieldCodec::readHeader(const MsgBuffer *buffer, uint64_t &len) const
+    {
+        auto readable = buffer->readableBytes();
+        auto data = buffer->peek();
+        if (field_ == LengthField::xVarint)
+        {
+            uint64_t value = 0;
+            for (size_t i = 0; i < xMaxVarintLength; ++i)
+            {
+                if (i == readable)
+                    return 0;
+                auto byte = static_cast<uint8_t>(data[i]);
+                // The 10th byte may only hold the top bit of the length.
+                if (i == xMaxVarintLength - 1 && byte > 1)
+                    return -1;
+                value |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+                if (!(byte & 0x80))
+                {
+                    len = value;
+                    return static_cast<ssize_t>(i + 1);
+                }
+            }
+            return -1;
+        }
+        auto width = static_cast<size_t>(field_);
+        if (readable < width)
+            return 0;
+        uint64_t be = 0;
+        memcpy(reinterpret_cast<char *>(&be) + sizeof(be) - width, data, width);
+        len = ntoh64(be);
+        return static_cast<ssize_t>(width);
+    }
+
+    void LengthFieldCodec::onMessage(const TcpConnectionPtr &conn, MsgBuffer *buffer)
+    {
+        while (buffer->readableBytes() > 0)
+        {
+            uint64_t len = 0;
+            auto headerLen = readHeader(buffer, len);
+            if (headerLen == 0)
+                return;
+            if (headerLen < 0 || len > maxFrameSize_)
+            {
+                frameError(conn, buffer, headerLen < 0 ? 0 : static_cast<size_t>(len));
+                return;
+            }
+            auto frameLen = static_cast<size_t>(headerLen) + static_cast<size_t>(len);
+            if (buffer->readableBytes() < frameLen)
+            {
+                // Make room for the rest of the frame at once.
+                buffer->ensureWritableBytes(frameLen - buffer->readableBytes());
+                return;
+            }
+            frameCallback_(conn, buffer->peek() + headerLen, static_cast<size_t>(len));
+            buffer->retrieve(frameLen);
+        }
+    }
+
+    void LengthFieldCodec::frameError(const TcpConnectionPtr &conn,
+                                      MsgBuffer *buffer,
+                                      size_t len)
+    {
+        buffer->retrieveAll();
+        if (frameErrorCallback_)
+        {
+            frameErrorCallback_(conn, len);
+            return;
+        }
+        if (len == 0)
+            LOG_ERROR << "Malformed frame length from " << conn->peerAddr().toIpPort();
+        else
+            LOG_ERROR << "Frame of " << len << " bytes from " << conn->peerAddr().toIpPort()
+                      << " is longer than " << maxFrameSize_;
+        conn->forceClose();
+    }
+
+    bool LengthFieldCodec::encode(MsgBuffer &buffer) const
+    {
+        auto len = buffer.readableBytes();
+        if (len > maxFrameSize_)
+            return false;
+        char header[xMaxVarintLength];
+        auto headerLen = writeHeader(header, len);
+        buffer.addInFront(header, headerLen);
+        return true;
+    }
+
+    bool LengthFieldCodec::encode(MsgBuffer &buffer, const char *data, size_t len) const
+    {
+        if (len > maxFrameSize_)
+            return false;
+        auto headerLen = headerLength(len);
+        buffer.ensureWritableBytes(headerLen + len);
+        writeHeader(buffer.beginWrite(), len);
+        buffer.hasWritten(headerLen);
+        buffer.append(data, len);
+        return true;
+    }
+
+    bool LengthFieldCodec::send(const TcpConnectionPtr &conn, MsgBuffer &&buffer) const
+    {
+        if (!encode(buffer))
+            return false;
+        conn->send(std::move(buffer));
+        return true;
+    }
+} // namespace xiao
@@ -0,0 +1,187 @@
+/**
+ * @file LengthFieldCodec.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/TcpConnection.h>
+#include <xiao/net/callbacks.h>
+#include <xiao/utils/MsgBuffer.h>
+#include <xiao/exports.h>
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace xiao
+{
+    /**
+     * @brief This enum decides how the length in front of each frame is
+     * encoded.
+     *
+     */
+    enum class LengthField
+    {
+        /// A base 128 varint, 7 bits per byte with the least significant
+        /// group first, up to 10 bytes.
+        xVarint = 0,
+        /// A big-endian unsigned integer of 1, 2, 4 or 8 bytes.
+        xInt8 = 1,
+        xInt16 = 2,
+        xInt32 = 4,
+        xInt64 = 8
+    };
+
+    /**
+     * @brief This class splits the data received by a connection into frames,
+     * each one preceded by its length, and encodes the frames sent.
+     *
+     * The frames are handed to the frame callback as pointers into the
+     * receiving buffer of the connection, without copying them, and are
+     * removed from the buffer when the callback returns. The header of an
+     * outgoing frame is put into the space reserved in front of the data of a
+     * MsgBuffer, so the body appended to the buffer is not moved.
+     *
+     * @code
+       LengthFieldCodec codec(LengthField::xInt32, 1 << 20,
+                              [](const TcpConnectionPtr &conn,
+                                 const char *data,
+                                 size_t len) { ... });
+       server.setRecvMessageCallback(codec.messageCallback());
+       @endcode
+     *
+     * @note The codec must outlive the connections it decodes for.
+     */
+    class XIAO_EXPORT LengthFieldCodec
+    {
+    public:
+        /**
+         * @brief Called with each complete frame, the data is valid during the
+         * call only.
+         */
+        using FrameCallback = std::function<
+            void(const TcpConnectionPtr &conn, const char *data, size_t len)>;
+
+        /**
+         * @brief Called when a frame longer than the maximum, or a malformed
+         * varint, is received, with the length received (0 for a malformed
+         * varint). The data of the connection is discarded after it.
+         */
+        using FrameErrorCallback =
+            std::function<void(const TcpConnectionPtr &conn, size_t len)>;
+
+        /**
+         * @brief Construct a new codec.
+         *
+         * @param field The encoding of the length.
+         * @param maxFrameSize The longest frame accepted, in bytes, without
+         * the header. It is lowered to the largest length the field can
+         * encode.
+         * @param cb The frame callback.
+         */
+        LengthFieldCodec(LengthField field, size_t maxFrameSize, FrameCallback cb);
+
+        /**
+         * @brief Set the callback called when a frame is too long or its
+         * length is malformed. By default an error is logged and the
+         * connection is closed.
+         *
+         * @param cb
+         */
+        void setFrameErrorCallback(const FrameErrorCallback &cb)
+        {
+            frameErrorCallback_ = cb;
+        }
+        void setFrameErrorCallback(FrameErrorCallback &&cb)
+        {
+            frameErrorCallback_ = std::move(cb);
+        }
+
+        /**
+         * @brief Hand the complete frames in the buffer to the frame
+         * callback, leaving a partial frame in the buffer for the next call.
+         *
+         * @param conn
+         * @param buffer The receiving buffer of the connection.
+         */
+        void onMessage(const TcpConnectionPtr &conn, MsgBuffer *buffer);
+
+        /**
+         * @brief Get a message callback for a connection, a server or a
+         * client, which calls onMessage() of this codec.
+         *
+         * @return RecvMessageCallback
+         */
+        RecvMessageCallback messageCallback()
+        {
+            return [this](const TcpConnectionPtr &conn, MsgBuffer *buffer) {
+                onMessage(conn, buffer);
+            };
+        }
+
+        /**
+         * @brief Make a frame of all the data in the buffer by putting the
+         * header in front of it. The body is not moved when the header fits in
+         * the space reserved in front of the data, which is always the case
+         * for fixed lengths and for varints of lengths below 2^56.
+         *
+         * @param buffer
+         * @return false if the data is longer than the maximum frame size, the
+         * buffer is then left untouched.
+         */
+        bool encode(MsgBuffer &buffer) const;
+
+        /**
+         * @brief Append a frame to the buffer, e.g. to send several frames
+         * with one call.
+         *
+         * @param buffer
+         * @param data
+         * @param len
+         * @return false if the frame is longer than the maximum frame size.
+         */
+        bool encode(MsgBuffer &buffer, const char *data, size_t len) const;
+
+        /**
+         * @brief Encode the buffer as a frame and send it, moving the buffer
+         * into the connection.
+         *
+         * @param conn
+         * @param buffer
+         * @return false if the data is longer than the maximum frame size.
+         */
+        bool send(const TcpConnectionPtr &conn, MsgBuffer &&buffer) const;
+
+        /**
+         * @brief Get the length of the header of a frame.
+         *
+         * @param len The length of the body.
+         * @return size_t
+         */
+        size_t headerLength(size_t len) const;
+
+        size_t maxFrameSize() const
+        {
+            return maxFrameSize_;
+        }
+
+    private:
+        // Write the header of a frame to the buffer, which must have room for
+        // the header, and return its length.
+        size_t writeHeader(char *header, size_t len) const;
+        // Read the header in front of the data, return its length, or 0 if it
+        // is not complete yet, or -1 if it is malformed.
+        ssize_t readHeader(const MsgBuffer *buffer, uint64_t &len) const;
+        void frameError(const TcpConnectionPtr &conn, MsgBuffer *buffer, size_t len);
+
+        LengthField field_;
+        size_t maxFrameSize_;
+        FrameCallback frameCallback_;
+        FrameErrorCallback frameErrorCallback_;
+    };
+} // namespace xiao
@@ -0,0 +1,44 @@
+/**
+ * @file Offloader.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/Offloader.h>
+
+namespace xiao
+{
+    void Offloader::complete(const CompletionsPtr &completions, Func &&f)
+    {
+        if (completions->closed.load(std::memory_order_acquire))
+            return;
+        completions->queue.enqueue(std::move(f));
+        // Only the first completion after a drain wakes the loop up, the
+        // following ones are picked up by the same drain.
+        if (!completions->drainQueued.exchange(true, std::memory_order_acq_rel))
+        {
+            completions->loop->queueInLoop([completions]()
+                                           { drain(completions); });
+        }
+    }
+
+    void Offloader::drain(const CompletionsPtr &completions)
+    {
+        // Cleared before dequeuing, so a completion enqueued after the queue
+        // is found empty queues another drain. The exchange synchronizes with
+        // the completions that found the flag set.
+        completions->drainQueued.exchange(false, std::memory_order_acq_rel);
+        Func f;
+        while (completions->queue.dequeue(f))
+        {
+            // The completions of a destroyed offloader are dropped.
+            if (!completions->closed.load(std::memory_order_acquire))
+                f();
+        }
+    }
+} // namespace xiao
@@ -0,0 +1,189 @@
+/**
+ * @file Offloader.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/EventLoop.h>
+#include <xiao/utils/LockFreeQueue.h>
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/utils/TaskQueue.h>
+#include <xiao/exports.h>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace xiao
+{
+    /**
+     * @brief The handle of a task submitted to an Offloader, it cancels the
+     * task.
+     *
+     */
+    class XIAO_EXPORT OffloadHandle
+    {
+    public:
+        OffloadHandle() = default;
+
+        /**
+         * @brief Cancel the task. The work is skipped if it has not started
+         * yet, and the completion callback is not called.
+         *
+         * @note The completion callback is guaranteed not to run only when this
+         * method is called in the thread of the event loop, e.g. from the close
+         * callback of a connection.
+         */
+        void cancel()
+        {
+            if (cancelled_)
+                cancelled_->store(true, std::memory_order_release);
+        }
+
+        /**
+         * @brief Check whether the task is cancelled.
+         *
+         * @return true
+         * @return false
+         */
+        bool cancelled() const
+        {
+            return cancelled_ && cancelled_->load(std::memory_order_acquire);
+        }
+
+    private:
+        friend class Offloader;
+        explicit OffloadHandle(std::shared_ptr<std::atomic<bool>> cancelled)
+            : cancelled_(std::move(cancelled))
+        {
+        }
+        std::shared_ptr<std::atomic<bool>> cancelled_;
+    };
+
+    /**
+     * @brief This class runs CPU-heavy work (compression, hashing, ...) in a
+     * task queue and delivers the results back to an event loop. The
+     * completions are batched, the loop is woken up once for all the tasks
+     * finished while it was busy.
+     *
+     * @code
+       Offloader offloader(loop, &workers);
+       auto handle = offloader.submit(
+           [data]() { return compress(data); },
+           [conn](std::string compressed) { conn->send(compressed); });
+       // In the close callback of conn:
+       handle.cancel();
+       @endcode
+     *
+     * @note The completions which have not run when the offloader is destroyed
+     * are dropped. Destroy it in the thread of the event loop, so that no
+     * completion callback is running meanwhile.
+     */
+    class XIAO_EXPORT Offloader : NonCopyable
+    {
+    public:
+        /**
+         * @brief Construct a new offloader.
+         *
+         * @param loop The event loop receiving the results.
+         * @param queue The task queue running the work, usually a
+         * ConcurrentTaskQueue shared by several loops.
+         */
+        Offloader(EventLoop *loop, TaskQueue *queue)
+            : queue_(queue), completions_(std::make_shared<Completions>(loop))
+        {
+        }
+        ~Offloader()
+        {
+            completions_->closed.store(true, std::memory_order_release);
+        }
+
+        /**
+         * @brief Run work() in the task queue, then call done() with its result
+         * in the thread of the event loop.
+         *
+         * @param work A callable returning the result, or void.
+         * @param done A callable taking the result, or nothing when work()
+         * returns void.
+         * @return OffloadHandle
+         */
+        template <typename Work, typename Done>
+        OffloadHandle submit(Work &&work, Done &&done)
+        {
+            auto cancelled = std::make_shared<std::atomic<bool>>(false);
+            queue_->runTaskInQueue(
+                [completions = completions_,
+                 cancelled,
+                 work = std::forward<Work>(work),
+                 done = std::forward<Done>(done)]() mutable
+                {
+                    if (cancelled->load(std::memory_order_acquire))
+                        return;
+                    run(completions,
+                        work,
+                        done,
+                        cancelled,
+                        std::is_void<decltype(work())>());
+                });
+            return OffloadHandle(std::move(cancelled));
+        }
+
+    private:
+        // The completions are shared with the tasks and the drains queued in
+        // the loop, which may run after the offloader is destroyed.
+        struct Completions
+        {
+            explicit Completions(EventLoop *l) : loop(l)
+            {
+            }
+            EventLoop *loop;
+            MpscQueue<Func> queue;
+            std::atomic<bool> drainQueued{false};
+            std::atomic<bool> closed{false};
+        };
+        using CompletionsPtr = std::shared_ptr<Completions>;
+
+        template <typename Work, typename Done>
+        static void run(const CompletionsPtr &completions,
+                        Work &work,
+                        Done &done,
+                        const std::shared_ptr<std::atomic<bool>> &cancelled,
+                        std::false_type)
+        {
+            auto result = work();
+            complete(completions,
+                     [cancelled,
+                      done = std::move(done),
+                      result = std::move(result)]() mutable
+                     {
+                if (!cancelled->load(std::memory_order_acquire))
+                    done(std::move(result)); });
+        }
+        template <typename Work, typename Done>
+        static void run(const CompletionsPtr &completions,
+                        Work &work,
+                        Done &done,
+                        const std::shared_ptr<std::atomic<bool>> &cancelled,
+                        std::true_type)
+        {
+            work();
+            complete(completions,
+                     [cancelled, done = std::move(done)]() mutable
+                     {
+                if (!cancelled->load(std::memory_order_acquire))
+                    done(); });
+        }
+
+        static void complete(const CompletionsPtr &completions, Func &&f);
+        static void drain(const CompletionsPtr &completions);
+
+        TaskQueue *queue_;
+        CompletionsPtr completions_;
+    };
+} // namespace xiao
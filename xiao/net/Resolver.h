@@ -0,0 +1,91 @@
+/**
+ * @file Resolver.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/EventLoop.h>
+#include <xiao/net/InetAddress.h>
+#include <xiao/exports.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace xiao
+{
+    /**
+     * @brief This class represents an asynchronous DNS resolver.
+     *
+     * The results are cached for the timeout of the resolver, the names which
+     * can't be resolved for a shorter time, and the lookups of a name made
+     * while it is being resolved share the query in flight.
+     *
+     * @note It must be owned by a shared_ptr.
+     */
+    class XIAO_EXPORT Resolver
+    {
+    public:
+        /**
+         * @brief Called with the first address of the name, or with the
+         * default address 0.0.0.0:0 if it can't be resolved.
+         */
+        using Callback = std::function<void(const InetAddress &)>;
+
+        /**
+         * @brief Called with all the addresses of the name, or with none if
+         * it can't be resolved.
+         */
+        using ResolverResultsCallback =
+            std::function<void(const std::vector<InetAddress> &)>;
+
+        /**
+         * @brief Create a new resolver.
+         *
+         * @param loop The event loop in which the callbacks are called, if
+         * it is nullptr the callbacks are called in the threads of the
+         * resolver.
+         * @param timeout The time for which the results are cached, in
+         * seconds.
+         * @param hostsFile A file in the format of /etc/hosts in which the
+         * names are looked up first, e.g. to resolve without a network. It is
+         * read on each query, and a name listed with 0.0.0.0 or :: can't be
+         * resolved.
+         * @return std::shared_ptr<Resolver>
+         */
+        static std::shared_ptr<Resolver> newResolver(EventLoop *loop = nullptr,
+                                                     size_t timeout = 60,
+                                                     const std::string &hostsFile = "");
+
+        /**
+         * @brief Resolve a name, it can be called in any thread.
+         *
+         * @param hostname
+         * @param callback
+         */
+        virtual void resolve(const std::string &hostname,
+                             const Callback &callback) = 0;
+        virtual void resolve(const std::string &hostname,
+                             const ResolverResultsCallback &callback) = 0;
+
+        virtual ~Resolver()
+        {
+        }
+
+        /**
+         * @brief Check whether the resolver is based on c-ares.
+         *
+         * @return false
+         */
+        static bool isCResSupported()
+        {
+            return false;
+        }
+    };
+} // namespace xiao
@@ -0,0 +1,162 @@
+/**
+ * @file TcpClient.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/TcpClient.h>
+#include <xiao/utils/Logger.h>
+#include "inner/Connector.h"
+#include "inner/Socket.h"
+#include "inner/TcpConnectionImpl.h"
+#include <assert.h>
+
+namespace xiao
+{
+    TcpClient::TcpClient(EventLoop *loop,
+                         const InetAddress &serverAddr,
+                         const std::string &nameArg)
+        : TcpClient(loop, std::vector<InetAddress>{serverAddr}, nameArg)
+    {
+    }
+
+    TcpClient::TcpClient(EventLoop *loop,
+                         const std::vector<InetAddress> &serverAddrs,
+                         const std::string &nameArg)
+        : loop_(loop),
+          connectorPtr_(std::make_shared<Connector>(loop, serverAddrs, false)),
+          name_(nameArg)
+    {
+        // The connector doesn't outlive the client in a callback, the client
+        // stops it when destroyed.
+        connectorPtr_->setNewConnectionCallback(
+            [this](int sockfd) { newConnection(sockfd); });
+        connectorPtr_->setErrorCallback([this]() {
+            if (connectionErrorCallback_)
+                connectionErrorCallback_();
+        });
+        LOG_TRACE << "TcpClient::TcpClient[" << name_ << "] - connector ";
+    }
+
+    TcpClient::~TcpClient()
+    {
+        LOG_TRACE << "TcpClient::~TcpClient[" << name_ << "] - connector ";
+        TcpConnectionImplPtr conn;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            conn = std::static_pointer_cast<TcpConnectionImpl>(connection_);
+        }
+        connectorPtr_->setNewConnectionCallback(nullptr);
+        connectorPtr_->setErrorCallback(nullptr);
+        connectorPtr_->stop();
+        if (conn)
+        {
+            assert(loop_ == conn->getLoop());
+            // The close callback can't reach the client any more.
+            auto loop = loop_;
+            loop_->runInLoop([conn, loop]() {
+                conn->setCloseCallback([loop](const TcpConnectionPtr &connPtr) {
+                    loop->queueInLoop([connPtr]() {
+                        static_cast<TcpConnectionImpl *>(connPtr.get())
+                            ->connectDestroyed();
+                    });
+                });
+            });
+            conn->forceClose();
+        }
+    }
+
+    void TcpClient::connect()
+    {
+        LOG_TRACE << "TcpClient::connect[" << name_ << "] - connecting to "
+                  << serverAddress().toIpPort();
+        connect_ = true;
+        connectorPtr_->setRetry(retry_);
+        connectorPtr_->start();
+    }
+
+    void TcpClient::disconnect()
+    {
+        connect_ = false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (connection_)
+        {
+            connection_->shutdown();
+        }
+    }
+
+    void TcpClient::stop()
+    {
+        connect_ = false;
+        connectorPtr_->stop();
+    }
+
+    void TcpClient::setSockOptCallback(const SockOptCallback &cb)
+    {
+        connectorPtr_->setSockOptCallback(cb);
+    }
+
+    void TcpClient::setAttemptDelay(double seconds)
+    {
+        connectorPtr_->setAttemptDelay(seconds);
+    }
+
+    const InetAddress &TcpClient::serverAddress() const
+    {
+        return connectorPtr_->serverAddress();
+    }
+
+    void TcpClient::newConnection(int sockfd)
+    {
+        loop_->assertInLoopThread();
+        InetAddress peerAddr(Socket::getPeerAddress(sockfd));
+        InetAddress localAddr(Socket::getLocalAddress(sockfd));
+        auto conn = std::make_shared<TcpConnectionImpl>(loop_,
+                                                        sockfd,
+                                                        localAddr,
+                                                        peerAddr);
+        conn->setConnectionCallback(connectionCallback_);
+        conn->setRecvMsgCallback(messageCallback_);
+        conn->setWriteCompleteCallback(writeCompleteCallback_);
+        std::weak_ptr<TcpClient> weakSelf(shared_from_this());
+        conn->setCloseCallback([weakSelf](const TcpConnectionPtr &c) {
+            if (auto self = weakSelf.lock())
+            {
+                self->removeConnection(c);
+            }
+            else
+            {
+                static_cast<TcpConnectionImpl *>(c.get())->connectDestroyed();
+            }
+        });
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            connection_ = conn;
+        }
+        conn->connectEstablished();
+    }
+
+    void TcpClient::removeConnection(const TcpConnectionPtr &conn)
+    {
+        loop_->assertInLoopThread();
+        assert(loop_ == conn->getLoop());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            assert(connection_ == conn);
+            connection_.reset();
+        }
+        auto connImpl = std::static_pointer_cast<TcpConnectionImpl>(conn);
+        loop_->queueInLoop([connImpl]() { connImpl->connectDestroyed(); });
+        if (retry_ && connect_)
+        {
+            LOG_TRACE << "TcpClient::connect[" << name_ << "] - Reconnecting to "
+                      << serverAddress().toIpPort();
+            connectorPtr_->restart();
+        }
+    }
+} // namespace xiao
@@ -0,0 +1,231 @@
+/**
+ * @file TcpClient.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/EventLoop.h>
+#include <xiao/net/InetAddress.h>
+#include <xiao/net/TcpConnection.h>
+#include <xiao/net/callbacks.h>
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/exports.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace xiao
+{
+    class Connector;
+    using ConnectorPtr = std::shared_ptr<Connector>;
+
+    /**
+     * @brief This class represents a TCP client.
+     *
+     * @note It must be owned by a shared_ptr.
+     */
+    class XIAO_EXPORT TcpClient : NonCopyable,
+                                  public std::enable_shared_from_this<TcpClient>
+    {
+    public:
+        /**
+         * @brief Construct a new TCP client instance.
+         *
+         * @param loop The event loop in which the client runs.
+         * @param serverAddr The address of the server, which may be a Unix
+         * domain path or abstract name.
+         * @param nameArg The name of the client.
+         */
+        TcpClient(EventLoop *loop,
+                  const InetAddress &serverAddr,
+                  const std::string &nameArg);
+
+        /**
+         * @brief Construct a new TCP client instance for a server with
+         * several addresses, which are raced when connecting (RFC 8305).
+         *
+         * @param loop The event loop in which the client runs.
+         * @param serverAddrs The addresses of the server, in the order of
+         * preference.
+         * @param nameArg The name of the client.
+         */
+        TcpClient(EventLoop *loop,
+                  const std::vector<InetAddress> &serverAddrs,
+                  const std::string &nameArg);
+        ~TcpClient();
+
+        /**
+         * @brief Connect to the server.
+         *
+         */
+        void connect();
+
+        /**
+         * @brief Shut down the connection to the server.
+         *
+         */
+        void disconnect();
+
+        /**
+         * @brief Stop connecting to the server.
+         *
+         */
+        void stop();
+
+        /**
+         * @brief Get the TCP connection to the server.
+         *
+         * @return TcpConnectionPtr
+         */
+        TcpConnectionPtr connection() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return connection_;
+        }
+
+        /**
+         * @brief Get the event loop.
+         *
+         * @return EventLoop*
+         */
+        EventLoop *getLoop() const
+        {
+            return loop_;
+        }
+
+        /**
+         * @brief Check whether the client reconnects when the connection is
+         * lost or connecting fails.
+         *
+         */
+        bool retry() const
+        {
+            return retry_;
+        }
+
+        /**
+         * @brief Enable reconnecting, it must be called before connect().
+         *
+         */
+        void enableRetry()
+        {
+            retry_ = true;
+        }
+
+        /**
+         * @brief Get the name of the client.
+         *
+         * @return const std::string&
+         */
+        const std::string &name() const
+        {
+            return name_;
+        }
+
+        /**
+         * @brief Get the address of the server, the one connected to when
+         * the server has several.
+         *
+         * @return const InetAddress&
+         */
+        const InetAddress &serverAddress() const;
+
+        /**
+         * @brief Set the time after which the next address of the server is
+         * tried while the previous attempts are pending, 250ms by default.
+         *
+         * @param seconds
+         */
+        void setAttemptDelay(double seconds);
+
+        /**
+         * @brief Set the connection callback.
+         *
+         * @param cb The callback is called when the connection to the server
+         * is established or closed.
+         */
+        void setConnectionCallback(const ConnectionCallback &cb)
+        {
+            connectionCallback_ = cb;
+        }
+        void setConnectionCallback(ConnectionCallback &&cb)
+        {
+            connectionCallback_ = std::move(cb);
+        }
+
+        /**
+         * @brief Set the connection error callback.
+         *
+         * @param cb The callback is called when connecting to the server
+         * fails, and the client doesn't retry.
+         */
+        void setConnectionErrorCallback(const ConnectionErrorCallback &cb)
+        {
+            connectionErrorCallback_ = cb;
+        }
+
+        /**
+         * @brief Set the message callback.
+         *
+         * @param cb The callback is called when some data is received from the
+         * server.
+         */
+        void setMessageCallback(const RecvMessageCallback &cb)
+        {
+            messageCallback_ = cb;
+        }
+        void setMessageCallback(RecvMessageCallback &&cb)
+        {
+            messageCallback_ = std::move(cb);
+        }
+
+        /**
+         * @brief Set the write complete callback.
+         *
+         * @param cb The callback is called when the data to send is sent out
+         * completely.
+         */
+        void setWriteCompleteCallback(const WriteCompleteCallback &cb)
+        {
+            writeCompleteCallback_ = cb;
+        }
+        void setWriteCompleteCallback(WriteCompleteCallback &&cb)
+        {
+            writeCompleteCallback_ = std::move(cb);
+        }
+
+        /**
+         * @brief Set the callback called with the socket before it connects.
+         *
+         * @param cb
+         */
+        void setSockOptCallback(const SockOptCallback &cb);
+
+    private:
+        void newConnection(int sockfd);
+        void removeConnection(const TcpConnectionPtr &conn);
+
+        EventLoop *loop_;
+        ConnectorPtr connectorPtr_;
+        const std::string name_;
+        ConnectionCallback connectionCallback_;
+        ConnectionErrorCallback connectionErrorCallback_;
+        RecvMessageCallback messageCallback_;
+        WriteCompleteCallback writeCompleteCallback_;
+        std::atomic<bool> retry_{false};
+        std::atomic<bool> connect_{true};
+        mutable std::mutex mutex_;
+        TcpConnectionPtr connection_;
+    };
+
+    using TcpClientPtr = std::shared_ptr<TcpClient>;
+} // namespace xiao
@@ -0,0 +1,367 @@
+/**
+ * @file TcpConnection.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/EventLoop.h>
+#include <xiao/net/InetAddress.h>
+#include <xiao/net/AsyncStream.h>
+#include <xiao/net/callbacks.h>
+#include <xiao/utils/MsgBuffer.h>
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/exports.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace xiao
+{
+    /**
+     * @brief This class represents a TCP connection.
+     *
+     */
+    class XIAO_EXPORT TcpConnection
+    {
+    public:
+        TcpConnection() = default;
+        virtual ~TcpConnection(){};
+
+        /**
+         * @brief Send some data to the peer.
+         *
+         * @param msg
+         * @param len
+         * @note The data is queued in the send chain of the connection, the
+         * chain is flushed with one writev() at the end of the current
+         * iteration of the event loop.
+         */
+        virtual void send(const char *msg, size_t len) = 0;
+        virtual void send(const void *msg, size_t len) = 0;
+        virtual void send(const std::string &msg) = 0;
+        virtual void send(std::string &&msg) = 0;
+        virtual void send(const MsgBuffer &buffer) = 0;
+        virtual void send(MsgBuffer &&buffer) = 0;
+
+        /**
+         * @brief Send data shared with other connections or kept by the
+         * caller. The data is not copied, it must not be modified until it is
+         * sent.
+         *
+         * @param msgPtr
+         */
+        virtual void send(const std::shared_ptr<std::string> &msgPtr) = 0;
+        virtual void send(const std::shared_ptr<MsgBuffer> &msgPtr) = 0;
+
+        /**
+         * @brief Send a file to the peer.
+         *
+         * @param fileName in UTF-8
+         * @param offset
+         * @param length
+         */
+        virtual void sendFile(const char *fileName,
+                              long long offset = 0,
+                              long long length = 0) = 0;
+        virtual void sendFile(const std::string &fileName,
+                              long long offset = 0,
+                              long long length = 0)
+        {
+            sendFile(fileName.c_str(), offset, length);
+        }
+
+        /**
+         * @brief Send a stream to the peer.
+         *
+         * @param callback function to retrieve the stream data (stream ends
+         * when a zero size is returned) the callback will be called with
+         * nullptr when the send is finished/interrupted, so that it cleans up
+         * any internal data (ex: close file).
+         * @warning The buffer size should be >= 10 to allow http chunked-encoding
+         * data stream
+         */
+        virtual void sendStream(
+            std::function<std::size_t(char *, std::size_t)> callback) = 0;
+
+        /**
+         * @brief Send a stream to the peer asynchronously.
+         *
+         * @return AsyncStreamPtr The data sent through it goes out in order
+         * with the data sent before and after the call, close() ends the
+         * stream.
+         */
+        virtual AsyncStreamPtr sendAsyncStream() = 0;
+
+        /**
+         * @brief Get the local address of the connection.
+         *
+         * @return const InetAddress&
+         */
+        virtual const InetAddress &localAddr() const = 0;
+
+        /**
+         * @brief Get the remote address of the connection.
+         *
+         * @return const InetAddress&
+         */
+        virtual const InetAddress &peerAddr() const = 0;
+
+        /**
+         * @brief Return true if the connection is established.
+         *
+         * @return true
+         * @return false
+         */
+        virtual bool connected() const = 0;
+
+        /**
+         * @brief Return false if the connection is established.
+         *
+         * @return true
+         * @return false
+         */
+        virtual bool disconnected() const = 0;
+
+        /**
+         * @brief Get the buffer in which the received data stored.
+         *
+         * @return MsgBuffer*
+         */
+        virtual MsgBuffer *getRecvBuffer() = 0;
+
+        /**
+         * @brief Set the high water mark callback
+         *
+         * @param cb The callback is called when the data in sending buffer is
+         * larger than the water mark.
+         * @param markLen The water mark in bytes.
+         */
+        virtual void setHighWaterMarkCallback(const HighWaterMarkCallback &cb,
+                                              size_t markLen) = 0;
+
+        /**
+         * @brief Throttle the reading of the peer connection by the output of
+         * this connection. The reading of the peer is stopped when the data
+         * pending in this connection goes above highMark, and started again
+         * when it drains to lowMark, so the memory used by a proxy from a fast
+         * producer to a slow consumer stays bounded.
+         *
+         * @param peer The connection whose input is sent to this one, nullptr
+         * to unlink it.
+         * @param highMark
+         * @param lowMark
+         */
+        virtual void setBackpressure(const TcpConnectionPtr &peer,
+                                     size_t highMark,
+                                     size_t lowMark) = 0;
+
+        /**
+         * @brief Stop reading from the socket, the data is kept in the kernel
+         * until the reading is started again.
+         *
+         */
+        virtual void stopRecv() = 0;
+
+        /**
+         * @brief Start reading from the socket again after stopRecv().
+         *
+         */
+        virtual void startRecv() = 0;
+
+        /**
+         * @brief Set the TCP_NODELAY option to the socket.
+         *
+         * @param on
+         */
+        virtual void setTcpNoDelay(bool on) = 0;
+
+        /**
+         * @brief Enable/disable sending the large buffers handed over to the
+         * connection (moved strings and buffers, shared pointers) with
+         * MSG_ZEROCOPY. Such a buffer is kept until the kernel reports that
+         * it is sent. Smaller chunks are copied to the socket as usual.
+         *
+         * @param on
+         * @return true if the zero copy mode is enabled.
+         * @return false if the system doesn't support it.
+         * @note The kernel copies the data anyway on the loopback interface,
+         * the mode is turned off by the first completion saying so.
+         */
+        virtual bool setZeroCopy(bool on) = 0;
+
+        /**
+         * @brief Send some data with file descriptors attached to its first
+         * byte (SCM_RIGHTS), on a Unix domain connection. The fds are
+         * duplicated, the caller keeps its own.
+         *
+         * @param msg
+         * @param len It must not be 0, the fds travel with the data.
+         * @param fds
+         * @return false if the connection is not a Unix domain one or the fds
+         * can't be duplicated.
+         */
+        virtual bool sendFds(const char *msg, size_t len, const std::vector<int> &fds) = 0;
+
+        /**
+         * @brief Enable/disable receiving the file descriptors sent with
+         * SCM_RIGHTS, they are closed by the kernel otherwise. It must be
+         * called before the data carrying them arrives, e.g. in the
+         * connection callback.
+         *
+         * @param on
+         */
+        virtual void setRecvFds(bool on) = 0;
+
+        /**
+         * @brief Take the file descriptors received with the data in the
+         * receive buffer, in the order they arrived, in the loop thread. The
+         * caller owns them, the ones not taken are closed with the
+         * connection.
+         *
+         * @return std::vector<int>
+         */
+        virtual std::vector<int> takeRecvFds() = 0;
+
+        /**
+         * @brief Shutdown the connection.
+         * @note This method only closes the writing direction.
+         */
+        virtual void shutdown() = 0;
+
+        /**
+         * @brief Close the connection forcefully.
+         *
+         */
+        virtual void forceClose() = 0;
+
+        /**
+         * @brief Detach the socket of an idle connection, e.g. to hand it over
+         * to another process in a hot restart. The channel is removed from the
+         * poller and the connection is closed in this process as by
+         * forceClose(), but the socket is not shut down.
+         *
+         * @return int A duplicate of the socket, with the close-on-exec flag
+         * set, or -1 if the connection is not connected, or has data to send
+         * or received data not consumed yet.
+         * @note It must be called in the thread of the loop.
+         */
+        virtual int detach() = 0;
+
+        /**
+         * @brief Get the event loop in which the connection I/O is handled.
+         *
+         * @return EventLoop*
+         */
+        virtual EventLoop *getLoop() = 0;
+
+        /**
+         * @brief Set the custom data on the connection.
+         *
+         * @param context
+         */
+        void setContext(const std::shared_ptr<void> &context)
+        {
+            contextPtr_ = context;
+        }
+        void setContext(std::shared_ptr<void> &&context)
+        {
+            contextPtr_ = std::move(context);
+        }
+
+        /**
+         * @brief Get the custom data from the connection.
+         *
+         * @tparam T
+         * @return std::shared_ptr<T>
+         */
+        template <typename T>
+        std::shared_ptr<T> getContext() const
+        {
+            return std::static_pointer_cast<T>(contextPtr_);
+        }
+
+        /**
+         * @brief Return true if the custom data is set by user.
+         *
+         * @return true
+         * @return false
+         */
+        bool hasContext() const
+        {
+            return (bool)contextPtr_;
+        }
+
+        /**
+         * @brief Clear the custom data.
+         *
+         */
+        void clearContext()
+        {
+            contextPtr_.reset();
+        }
+
+        /**
+         * @brief Return the number of bytes sent
+         *
+         * @return size_t
+         */
+        virtual size_t bytesSent() const = 0;
+
+        /**
+         * @brief Return the number of bytes received.
+         *
+         * @return size_t
+         */
+        virtual size_t bytesReceived() const = 0;
+
+        void setRecvMsgCallback(const RecvMessageCallback &cb)
+        {
+            recvMsgCallback_ = cb;
+        }
+        void setRecvMsgCallback(RecvMessageCallback &&cb)
+        {
+            recvMsgCallback_ = std::move(cb);
+        }
+        void setConnectionCallback(const ConnectionCallback &cb)
+        {
+            connectionCallback_ = cb;
+        }
+        void setConnectionCallback(ConnectionCallback &&cb)
+        {
+            connectionCallback_ = std::move(cb);
+        }
+        void setWriteCompleteCallback(const WriteCompleteCallback &cb)
+        {
+            writeCompleteCallback_ = cb;
+        }
+        void setWriteCompleteCallback(WriteCompleteCallback &&cb)
+        {
+            writeCompleteCallback_ = std::move(cb);
+        }
+        void setCloseCallback(const CloseCallback &cb)
+        {
+            closeCallback_ = cb;
+        }
+        void setCloseCallback(CloseCallback &&cb)
+        {
+            closeCallback_ = std::move(cb);
+        }
+
+    protected:
+        RecvMessageCallback recvMsgCallback_;
+        ConnectionCallback connectionCallback_;
+        CloseCallback closeCallback_;
+        WriteCompleteCallback writeCompleteCallback_;
+        HighWaterMarkCallback highWaterMarkCallback_;
+
+    private:
+        std::shared_ptr<void> contextPtr_;
+    };
+} // namespace xiao
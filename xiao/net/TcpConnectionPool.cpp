@@ -0,0 +1,274 @@
+/**
+ * @file TcpConnectionPool.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/TcpConnectionPool.h>
+#include <xiao/utils/Logger.h>
+#include "inner/Socket.h"
+#include "inner/TcpConnectionImpl.h"
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+
+namespace xiao
+{
+    // The idle connections are checked every idleTimeout, within these bounds.
+    static const double xMaxEvictInterval = 1.0;
+    static const double xMinEvictInterval = 0.1;
+
+    // An idle connection has no borrower to read for.
+    static void idleMessageCallback(const TcpConnectionPtr &conn, MsgBuffer *)
+    {
+        LOG_WARN << "Unexpected data on an idle connection to "
+                 << conn->peerAddr().toIpPort();
+        conn->forceClose();
+    }
+
+    TcpConnectionPool::TcpConnectionPool(EventLoop *loop,
+                                         size_t minSize,
+                                         size_t maxSize,
+                                         double idleTimeout)
+        : loop_(loop),
+          minSize_(minSize),
+          maxSize_(maxSize > 0 ? maxSize : 1),
+          idleTimeout_(idleTimeout > 0 ? idleTimeout : 0)
+    {
+        assert(minSize_ <= maxSize_);
+        // A timer of no interval would fire at every iteration.
+        auto interval = (std::max)((std::min)(idleTimeout_, xMaxEvictInterval),
+                                   xMinEvictInterval);
+        evictTimerId_ = loop_->runEvery(interval, [this]() { evictIdle(); });
+    }
+
+    TcpConnectionPool::~TcpConnectionPool()
+    {
+        loop_->assertInLoopThread();
+        loop_->invalidateTimer(evictTimerId_);
+        // The clients close their connections, the callbacks can't reach the
+        // pool any more.
+        hosts_.clear();
+    }
+
+    void TcpConnectionPool::acquire(const InetAddress &addr, const AcquireCallback &cb)
+    {
+        loop_->assertInLoopThread();
+        auto key = addr.toIpPort();
+        auto &host = hosts_[key];
+        host.addr_ = addr;
+        while (!host.idle_.empty())
+        {
+            auto conn = std::move(host.idle_.back().conn_);
+            host.idle_.pop_back();
+            if (isAlive(conn))
+            {
+                lend(key, conn, cb);
+                return;
+            }
+            // The connection callback removes its client.
+            conn->forceClose();
+        }
+        host.waiters_.push_back(cb);
+        fill(key, host);
+    }
+
+    void TcpConnectionPool::release(const TcpConnectionPtr &conn)
+    {
+        loop_->assertInLoopThread();
+        // Usually called in the message callback of the borrower, which
+        // can't be replaced while it runs.
+        auto thisPtr = shared_from_this();
+        loop_->queueInLoop([thisPtr, conn]() { thisPtr->releaseInLoop(conn); });
+    }
+
+    void TcpConnectionPool::releaseInLoop(const TcpConnectionPtr &conn)
+    {
+        auto iter = borrowed_.find(conn.get());
+        if (iter == borrowed_.end())
+            return;
+        auto key = std::move(iter->second);
+        borrowed_.erase(iter);
+        if (!conn->connected() || conn->getRecvBuffer()->readableBytes() > 0)
+        {
+            conn->forceClose();
+            return;
+        }
+        conn->setRecvMsgCallback(idleMessageCallback);
+        conn->setWriteCompleteCallback(nullptr);
+        auto &host = hosts_[key];
+        if (!host.waiters_.empty())
+        {
+            auto cb = std::move(host.waiters_.front());
+            host.waiters_.pop_front();
+            lend(key, conn, cb);
+            return;
+        }
+        host.idle_.push_back(IdleConnection{conn, Clock::now()});
+    }
+
+    size_t TcpConnectionPool::size(const InetAddress &addr) const
+    {
+        loop_->assertInLoopThread();
+        auto iter = hosts_.find(addr.toIpPort());
+        return iter == hosts_.end() ? 0 : iter->second.clients_.size();
+    }
+
+    size_t TcpConnectionPool::idleCount(const InetAddress &addr) const
+    {
+        loop_->assertInLoopThread();
+        auto iter = hosts_.find(addr.toIpPort());
+        return iter == hosts_.end() ? 0 : iter->second.idle_.size();
+    }
+
+    void TcpConnectionPool::connect(const std::string &key, HostPool &host)
+    {
+        auto client = std::make_shared<TcpClient>(loop_, host.addr_, key);
+        std::weak_ptr<TcpConnectionPool> weakSelf = shared_from_this();
+        auto rawClient = client.get();
+        client->setConnectionCallback(
+            [weakSelf, key, rawClient](const TcpConnectionPtr &conn) {
+                auto self = weakSelf.lock();
+                if (!self)
+                    return;
+                if (conn->connected())
+                    self->onConnected(key, conn);
+                else
+                    self->onClosed(key, rawClient, conn);
+            });
+        client->setConnectionErrorCallback([weakSelf, key, rawClient]() {
+            auto self = weakSelf.lock();
+            if (self)
+                self->onConnectError(key, rawClient);
+        });
+        client->setMessageCallback(idleMessageCallback);
+        host.clients_.emplace(rawClient, client);
+        ++host.connecting_;
+        client->connect();
+    }
+
+    void TcpConnectionPool::fill(const std::string &key, HostPool &host)
+    {
+        while (host.clients_.size() < maxSize_ &&
+               (host.clients_.size() < minSize_ ||
+                host.connecting_ < host.waiters_.size()))
+        {
+            connect(key, host);
+        }
+    }
+
+    void TcpConnectionPool::onConnected(const std::string &key,
+                                        const TcpConnectionPtr &conn)
+    {
+        auto &host = hosts_[key];
+        assert(host.connecting_ > 0);
+        --host.connecting_;
+        if (!host.waiters_.empty())
+        {
+            auto cb = std::move(host.waiters_.front());
+            host.waiters_.pop_front();
+            lend(key, conn, cb);
+            return;
+        }
+        host.idle_.push_back(IdleConnection{conn, Clock::now()});
+    }
+
+    void TcpConnectionPool::onClosed(const std::string &key,
+                                     TcpClient *client,
+                                     const TcpConnectionPtr &conn)
+    {
+        borrowed_.erase(conn.get());
+        auto &host = hosts_[key];
+        auto iter = std::find_if(host.idle_.begin(),
+                                 host.idle_.end(),
+                                 [&conn](const IdleConnection &idle) {
+                                     return idle.conn_ == conn;
+                                 });
+        if (iter != host.idle_.end())
+            host.idle_.erase(iter);
+        removeClient(host, client);
+        fill(key, host);
+    }
+
+    void TcpConnectionPool::onConnectError(const std::string &key, TcpClient *client)
+    {
+        auto &host = hosts_[key];
+        assert(host.connecting_ > 0);
+        --host.connecting_;
+        removeClient(host, client);
+        LOG_ERROR << "Failed to connect to " << key;
+        // The other connections being made are left for the other waiters,
+        // the pool doesn't connect again until a request or the timer asks.
+        if (host.waiters_.size() > host.connecting_)
+        {
+            auto cb = std::move(host.waiters_.front());
+            host.waiters_.pop_front();
+            cb(nullptr);
+        }
+    }
+
+    void TcpConnectionPool::lend(const std::string &key,
+                                 const TcpConnectionPtr &conn,
+                                 const AcquireCallback &cb)
+    {
+        borrowed_[conn.get()] = key;
+        cb(conn);
+    }
+
+    void TcpConnectionPool::removeClient(HostPool &host, TcpClient *client)
+    {
+        auto iter = host.clients_.find(client);
+        if (iter == host.clients_.end())
+            return;
+        // Called by the client, it is destroyed after the callback returns.
+        auto clientPtr = std::move(iter->second);
+        host.clients_.erase(iter);
+        loop_->queueInLoop([clientPtr]() {});
+    }
+
+    void TcpConnectionPool::evictIdle()
+    {
+        auto now = Clock::now();
+        auto timeout = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(idleTimeout_));
+        for (auto &item : hosts_)
+        {
+            auto &host = item.second;
+            // Counted before closing any: the connection callback removes the
+            // client of a closed connection, at once or later.
+            size_t excess =
+                host.clients_.size() > minSize_ ? host.clients_.size() - minSize_ : 0;
+            while (excess > 0 && !host.idle_.empty() &&
+                   now - host.idle_.front().since_ >= timeout)
+            {
+                auto conn = std::move(host.idle_.front().conn_);
+                host.idle_.pop_front();
+                conn->forceClose();
+                --excess;
+            }
+            fill(item.first, host);
+        }
+    }
+
+    bool TcpConnectionPool::isAlive(const TcpConnectionPtr &conn)
+    {
+        if (!conn->connected())
+            return false;
+#ifndef _WIN32
+        auto connImpl = static_cast<TcpConnectionImpl *>(conn.get());
+        char c;
+        ssize_t n = ::recv(connImpl->socketPtr_->fd(), &c, 1, MSG_PEEK);
+        // 0 is the end of the stream, data is a stale response.
+        if (n >= 0)
+            return false;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+#else
+        return true;
+#endif
+    }
+} // namespace xiao
@@ -0,0 +1,159 @@
+/**
+ * @file TcpConnectionPool.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/EventLoop.h>
+#include <xiao/net/InetAddress.h>
+#include <xiao/net/TcpClient.h>
+#include <xiao/net/TcpConnection.h>
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/exports.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace xiao
+{
+    /**
+     * @brief This class keeps the connections to servers open to lend them
+     * to one request after another, instead of connecting for each request.
+     * The connections are pooled by the address of the server.
+     *
+     * A pool belongs to one event loop, its connections are handled in the
+     * loop and all its methods must be called in the loop, so a connection
+     * borrowed never crosses threads. Use one pool per loop.
+     *
+     * @note It must be owned by a shared_ptr and destroyed in its loop,
+     * destroying it closes all its connections, the borrowed ones too.
+     */
+    class XIAO_EXPORT TcpConnectionPool
+        : NonCopyable,
+          public std::enable_shared_from_this<TcpConnectionPool>
+    {
+    public:
+        /**
+         * @brief Called with the connection lent, or with nullptr if
+         * connecting to the server failed.
+         */
+        using AcquireCallback = std::function<void(const TcpConnectionPtr &)>;
+
+        /**
+         * @brief Construct a new connection pool.
+         *
+         * @param loop The event loop of the pool.
+         * @param minSize The number of connections to a server kept open, once
+         * the server was used.
+         * @param maxSize The maximum number of connections to a server, the
+         * requests beyond it wait for a connection to be released.
+         * @param idleTimeout The connections beyond minSize idle for this time
+         * are closed, in seconds. They are checked every idleTimeout, between
+         * 0.1 and 1 second, so 0 closes them at the next check.
+         */
+        TcpConnectionPool(EventLoop *loop,
+                          size_t minSize = 0,
+                          size_t maxSize = 16,
+                          double idleTimeout = 60.0);
+        ~TcpConnectionPool();
+
+        /**
+         * @brief Borrow a connection to a server. An idle connection is
+         * checked for liveness and lent at once, otherwise a new connection is
+         * made if the server has less than maxSize connections.
+         *
+         * @param addr The address of the server.
+         * @param cb
+         * @note The borrower sets its own message callback on the connection,
+         * it must not change the connection callback.
+         */
+        void acquire(const InetAddress &addr, const AcquireCallback &cb);
+
+        /**
+         * @brief Return a borrowed connection to the pool, after the current
+         * callback. It is closed if it is not connected or has unread data.
+         *
+         * @param conn
+         */
+        void release(const TcpConnectionPtr &conn);
+
+        /**
+         * @brief Get the number of connections to a server, idle, borrowed or
+         * connecting.
+         *
+         * @param addr
+         * @return size_t
+         */
+        size_t size(const InetAddress &addr) const;
+
+        /**
+         * @brief Get the number of idle connections to a server.
+         *
+         * @param addr
+         * @return size_t
+         */
+        size_t idleCount(const InetAddress &addr) const;
+
+        EventLoop *getLoop() const
+        {
+            return loop_;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct IdleConnection
+        {
+            TcpConnectionPtr conn_;
+            Clock::time_point since_;
+        };
+        struct HostPool
+        {
+            InetAddress addr_;
+            std::unordered_map<TcpClient *, TcpClientPtr> clients_;
+            // The most recently released at the back, which is lent first,
+            // the front ones age out.
+            std::deque<IdleConnection> idle_;
+            std::deque<AcquireCallback> waiters_;
+            size_t connecting_{0};
+        };
+
+        void releaseInLoop(const TcpConnectionPtr &conn);
+        void connect(const std::string &key, HostPool &host);
+        // Connect for the waiters and up to minSize.
+        void fill(const std::string &key, HostPool &host);
+        void onConnected(const std::string &key, const TcpConnectionPtr &conn);
+        void onClosed(const std::string &key,
+                      TcpClient *client,
+                      const TcpConnectionPtr &conn);
+        void onConnectError(const std::string &key, TcpClient *client);
+        void lend(const std::string &key,
+                  const TcpConnectionPtr &conn,
+                  const AcquireCallback &cb);
+        void removeClient(HostPool &host, TcpClient *client);
+        void evictIdle();
+        // Without waiting for the loop to see it, whether the peer closed the
+        // connection or sent data nobody asked for.
+        static bool isAlive(const TcpConnectionPtr &conn);
+
+        EventLoop *loop_;
+        size_t minSize_;
+        size_t maxSize_;
+        double idleTimeout_;
+        std::unordered_map<std::string, HostPool> hosts_;
+        // The server of each borrowed connection.
+        std::unordered_map<TcpConnection *, std::string> borrowed_;
+        TimerId evictTimerId_;
+    };
+
+    using TcpConnectionPoolPtr = std::shared_ptr<TcpConnectionPool>;
+} // namespace xiao
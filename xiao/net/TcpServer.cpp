@@ -0,0 +1,427 @@
+/**
+ * @file TcpServer.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/TcpServer.h>
+#include <xiao/utils/Logger.h>
+#include "inner/Acceptor.h"
+#include "inner/TcpConnectionImpl.h"
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#ifdef __linux__
+#include <linux/filter.h>
+#endif
+
+namespace xiao
+{
+    // The idle connections kept for reuse by each I/O loop.
+    static const size_t xMaxIdleConnections = 1024;
+
+    namespace
+    {
+        // Run f in the loop and wait for it. A loop quitting meanwhile runs it
+        // on its way out. The objects of a loop which has quit can't be
+        // touched from this thread, f is dropped rather than waited for
+        // forever, see the note of TcpServer::stop().
+        void runInLoopAndWait(EventLoop *loop, const std::function<void()> &f)
+        {
+            if (loop->isInLoopThread())
+            {
+                f();
+                return;
+            }
+            auto claimed = std::make_shared<std::atomic<bool>>(false);
+            std::promise<void> done;
+            auto future = done.get_future();
+            auto task = [claimed, &f, &done]() {
+                if (claimed->exchange(true))
+                    return;
+                f();
+                done.set_value();
+            };
+            if (loop->isRunning())
+            {
+                loop->queueInLoop(task);
+                loop->runOnQuit(task);
+                // The loop may have run its quit functions before this one
+                // was added.
+                while (true)
+                {
+                    if (future.wait_for(std::chrono::milliseconds(100)) ==
+                        std::future_status::ready)
+                    {
+                        future.get();
+                        return;
+                    }
+                    if (!loop->isRunning() && !claimed->exchange(true))
+                        break;
+                }
+            }
+            LOG_ERROR << "The event loop has quit before the server was stopped";
+            assert(false);
+        }
+
+#ifdef __linux__
+        // A connection is handed to the socket whose index in the SO_REUSEPORT
+        // group is returned by the program, the socket of loop i is the i-th
+        // of the group. The CPUs of the pinned loops are matched first, the
+        // others go to the CPU number modulo the number of loops.
+        bool attachCpuSteeringProgram(int fd, const std::vector<int> &cpus)
+        {
+            std::vector<struct sock_filter> code;
+            code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                                    static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)));
+            std::vector<size_t> pinned;
+            for (size_t i = 0; i < cpus.size() && pinned.size() < 255; ++i)
+            {
+                if (cpus[i] >= 0)
+                    pinned.push_back(i);
+            }
+            for (size_t i = 0; i < pinned.size(); ++i)
+            {
+                // Jump over the other comparisons and the modulo to return i.
+                code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+                                        static_cast<uint32_t>(cpus[pinned[i]]),
+                                        static_cast<uint8_t>(pinned.size() + 1),
+                                        0));
+            }
+            code.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K,
+                                    static_cast<uint32_t>(cpus.size())));
+            code.push_back(BPF_STMT(BPF_RET | BPF_A, 0));
+            for (auto index : pinned)
+            {
+                code.push_back(BPF_STMT(BPF_RET | BPF_K, static_cast<uint32_t>(index)));
+            }
+            struct sock_fprog prog;
+            prog.len = static_cast<unsigned short>(code.size());
+            prog.filter = code.data();
+            if (::setsockopt(fd,
+                             SOL_SOCKET,
+                             SO_ATTACH_REUSEPORT_CBPF,
+                             &prog,
+                             static_cast<socklen_t>(sizeof(prog))) < 0)
+            {
+                LOG_SYSERR << "SO_ATTACH_REUSEPORT_CBPF failed";
+                return false;
+            }
+            return true;
+        }
+#endif
+    } // namespace
+
+    TcpServer::TcpServer(EventLoop *loop,
+                         const InetAddress &address,
+                         std::string name,
+                         bool reUseAddr,
+                         bool reUsePort)
+        : loop_(loop),
+          acceptorPtr_(new Acceptor(loop, address, reUseAddr, reUsePort)),
+          address_(acceptorPtr_->addr()),
+          serverName_(std::move(name)),
+          ioLoops_({loop})
+    {
+        setupAcceptor();
+    }
+
+    TcpServer::TcpServer(EventLoop *loop, int listenFd, std::string name)
+        : loop_(loop),
+          acceptorPtr_(new Acceptor(loop, listenFd)),
+          address_(acceptorPtr_->addr()),
+          serverName_(std::move(name)),
+          ioLoops_({loop}),
+          adopted_(true)
+    {
+        setupAcceptor();
+    }
+
+    void TcpServer::setupAcceptor()
+    {
+        acceptorPtr_->setNewConnectionCallback(
+            [this](int fd, const InetAddress &peer) {
+                loop_->assertInLoopThread();
+                auto index = nextLoopIdx_++ % ioLoops_.size();
+                newConnection(index, fd, peer);
+            });
+    }
+
+    TcpServer::~TcpServer()
+    {
+        LOG_TRACE << "TcpServer::~TcpServer [" << serverName_ << "] destructing";
+        stop();
+    }
+
+    void TcpServer::setIoLoopNum(size_t num)
+    {
+        assert(!started_);
+        loopPoolPtr_ = std::make_shared<EventLoopThreadPool>(num, serverName_);
+        loopPoolPtr_->start();
+        ioLoops_ = loopPoolPtr_->getLoops();
+    }
+
+    void TcpServer::setIoLoopThreadPool(const std::shared_ptr<EventLoopThreadPool> &pool)
+    {
+        assert(pool->size() > 0);
+        assert(!started_);
+        loopPoolPtr_ = pool;
+        loopPoolPtr_->start();
+        ioLoops_ = loopPoolPtr_->getLoops();
+    }
+
+    void TcpServer::setIoLoops(const std::vector<EventLoop *> &ioLoops)
+    {
+        assert(!ioLoops.empty());
+        assert(!started_);
+        ioLoops_ = ioLoops;
+        loopPoolPtr_.reset();
+    }
+
+    void TcpServer::enableShardedAccept(bool cpuSteering)
+    {
+        assert(!started_);
+        shardedAccept_ = true;
+        cpuSteering_ = cpuSteering;
+    }
+
+    void TcpServer::setAcceptBatch(size_t batch)
+    {
+        assert(!started_);
+        acceptBatch_ = batch;
+        acceptorPtr_->setAcceptBatch(batch);
+    }
+
+    void TcpServer::start()
+    {
+        if (started_)
+            return;
+        started_ = true;
+        connLists_.resize(ioLoops_.size());
+        ioLoopContexts_.clear();
+        for (size_t i = 0; i < ioLoops_.size(); ++i)
+        {
+            ioLoopContexts_.push_back({this, i});
+        }
+        while (connPools_.size() < ioLoops_.size())
+        {
+            auto ioLoop = ioLoops_[connPools_.size()];
+            // A connection released in another thread is deleted there, it
+            // is only recycled in its loop.
+            connPools_.emplace_back(new ObjectPool<TcpConnectionImpl>(
+                xMaxIdleConnections, [ioLoop](TcpConnectionImpl *conn) {
+                    return ioLoop->isInLoopThread() && conn->recycle();
+                }));
+        }
+        if (idleTimeout_ > 0)
+            startTimingWheels();
+        // A Unix domain socket can't be shared with SO_REUSEPORT.
+        if (shardedAccept_ && !adopted_ && !address_.isUnixDomain())
+        {
+            startShards();
+            return;
+        }
+        loop_->runInLoop([this]() { acceptorPtr_->listen(); });
+    }
+
+    void TcpServer::startTimingWheels()
+    {
+        timingWheels_.resize(ioLoops_.size());
+        for (size_t i = 0; i < ioLoops_.size(); ++i)
+        {
+            runInLoopAndWait(ioLoops_[i], [this, i]() {
+                timingWheels_[i].reset(new TimingWheel(
+                    ioLoops_[i], static_cast<double>(idleTimeout_)));
+                timingWheels_[i]->setExpireCallback(
+                    [](const std::vector<TimingWheel::EntryPtr> &expired) {
+                        LOG_TRACE << "kick off " << expired.size()
+                                  << " idle connections";
+                        for (auto &obj : expired)
+                        {
+                            static_cast<TcpConnectionImpl *>(obj.get())->forceClose();
+                        }
+                    });
+            });
+        }
+    }
+
+    void TcpServer::startShards()
+    {
+        // The socket of the server is only bound, it is replaced by the
+        // sockets of the I/O loops.
+        acceptorPtr_.reset();
+        for (size_t i = 0; i < ioLoops_.size(); ++i)
+        {
+            std::unique_ptr<Acceptor> acceptor(
+                new Acceptor(ioLoops_[i], address_, true, true));
+            if (acceptBatch_ > 0)
+                acceptor->setAcceptBatch(acceptBatch_);
+            acceptor->setNewConnectionCallback(
+                [this, i](int fd, const InetAddress &peer) {
+                    newConnection(i, fd, peer);
+                });
+            shardAcceptors_.push_back(std::move(acceptor));
+        }
+        // In order, so that the socket of loop i is the i-th of the group.
+        for (auto &acceptor : shardAcceptors_)
+        {
+            acceptor->listen();
+        }
+        if (!cpuSteering_)
+            return;
+#ifdef __linux__
+        // The program is shared by the sockets of the group.
+        std::vector<int> cpus(ioLoops_.size(), -1);
+        if (loopPoolPtr_)
+        {
+            for (size_t i = 0; i < cpus.size(); ++i)
+                cpus[i] = loopPoolPtr_->getCpu(i);
+        }
+        attachCpuSteeringProgram(shardAcceptors_[0]->fd(), cpus);
+#else
+        LOG_ERROR << "The CPU steering of the connections is not supported";
+#endif
+    }
+
+    void TcpServer::stop()
+    {
+        if (!started_)
+            return;
+        started_ = false;
+        if (acceptorPtr_)
+        {
+            runInLoopAndWait(loop_, [this]() { acceptorPtr_.reset(); });
+        }
+        for (auto &acceptor : shardAcceptors_)
+        {
+            runInLoopAndWait(acceptor->getLoop(), [&acceptor]() { acceptor.reset(); });
+        }
+        shardAcceptors_.clear();
+        for (size_t i = 0; i < ioLoops_.size(); ++i)
+        {
+            runInLoopAndWait(ioLoops_[i], [this, i]() {
+                if (i < timingWheels_.size())
+                    timingWheels_[i].reset();
+                // Closing a connection removes it from the list.
+                auto conns = connLists_[i];
+                for (auto &conn : conns)
+                {
+                    conn->forceClose();
+                }
+            });
+        }
+        timingWheels_.clear();
+        // The connections released after the loops are gone are deleted.
+        connPools_.clear();
+        loopPoolPtr_.reset();
+    }
+
+    void TcpServer::adoptConnection(int fd)
+    {
+        loop_->assertInLoopThread();
+        assert(started_);
+        Socket::setNonBlockAndCloseOnExec(fd);
+        auto index = nextLoopIdx_++ % ioLoops_.size();
+        newConnection(index, fd, Socket::getPeerAddress(fd));
+    }
+
+    std::vector<int> TcpServer::detachIdleConnections()
+    {
+        assert(started_);
+        std::vector<int> fds;
+        for (size_t i = 0; i < ioLoops_.size(); ++i)
+        {
+            runInLoopAndWait(ioLoops_[i], [this, i, &fds]() {
+                // Detaching a connection removes it from the list.
+                auto conns = connLists_[i];
+                for (auto &conn : conns)
+                {
+                    int fd = conn->detach();
+                    if (fd >= 0)
+                        fds.push_back(fd);
+                }
+            });
+        }
+        return fds;
+    }
+
+    void TcpServer::newConnection(size_t loopIndex, int fd, const InetAddress &peer)
+    {
+        auto ioLoop = ioLoops_[loopIndex];
+        LOG_TRACE << "new connection:fd=" << fd << " address=" << peer.toIpPort();
+        InetAddress local(Socket::getLocalAddress(fd));
+        auto newPtr = connPools_[loopIndex]->getObject(
+            [ioLoop, fd, &local, &peer]() {
+                return new TcpConnectionImpl(ioLoop, fd, local, peer);
+            },
+            [fd, &local, &peer](TcpConnectionImpl *conn) {
+                conn->reuse(fd, local, peer);
+            });
+        newPtr->setRecvMsgCallback(recvMessageCallback_);
+        newPtr->setConnectionCallback(connectionCallback_);
+        newPtr->setWriteCompleteCallback(writeCompleteCallback_);
+        newPtr->setCloseCallback([this, loopIndex](const TcpConnectionPtr &closeConnPtr) {
+            connectionClosed(loopIndex, closeConnPtr);
+        });
+        // The task embedded in the connection hands it over to its loop, so
+        // neither a function nor a queue node is allocated.
+        TcpConnectionImpl::queueOwnerTask(std::move(newPtr),
+                                          &TcpServer::establishConnection,
+                                          &ioLoopContexts_[loopIndex]);
+    }
+
+    void TcpServer::establishConnection(void *context,
+                                        const std::shared_ptr<TcpConnectionImpl> &conn)
+    {
+        auto ctx = static_cast<IoLoopContext *>(context);
+        auto server = ctx->server;
+        auto loopIndex = ctx->index;
+        auto &conns = server->connLists_[loopIndex];
+        conn->ownerSlot_ = conns.size();
+        conns.push_back(conn);
+        conn->connectEstablished();
+        auto &wheels = server->timingWheels_;
+        if (loopIndex < wheels.size() && wheels[loopIndex])
+            wheels[loopIndex]->insertEntry(conn, &conn->idleEntry_);
+    }
+
+    void TcpServer::connectionClosed(size_t loopIndex, const TcpConnectionPtr &connectionPtr)
+    {
+        LOG_TRACE << "connectionClosed";
+        assert(ioLoops_[loopIndex]->isInLoopThread());
+        auto conn = static_cast<TcpConnectionImpl *>(connectionPtr.get());
+        auto &conns = connLists_[loopIndex];
+        auto slot = conn->ownerSlot_;
+        assert(slot < conns.size() && conns[slot].get() == conn);
+        // Move the last connection into the slot.
+        if (slot + 1 != conns.size())
+        {
+            conns[slot] = std::move(conns.back());
+            conns[slot]->ownerSlot_ = slot;
+        }
+        conns.pop_back();
+        conn->connectDestroyed();
+    }
+
+    const std::string TcpServer::ipPort() const
+    {
+        return address().toIpPort();
+    }
+
+    const InetAddress &TcpServer::address() const
+    {
+        return address_;
+    }
+
+    int TcpServer::listenFd() const
+    {
+        return acceptorPtr_ ? acceptorPtr_->fd() : -1;
+    }
+} // namespace xiao
@@ -0,0 +1,317 @@
+/**
+ * @file TcpServer.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/EventLoop.h>
+#include <xiao/net/EventLoopThreadPool.h>
+#include <xiao/net/InetAddress.h>
+#include <xiao/net/TcpConnection.h>
+#include <xiao/net/callbacks.h>
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/utils/ObjectPool.h>
+#include <xiao/utils/TimingWheel.h>
+#include <xiao/exports.h>
+#include <assert.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace xiao
+{
+    class Acceptor;
+    class TcpConnectionImpl;
+
+    /**
+     * @brief This class represents a TCP server.
+     *
+     */
+    class XIAO_EXPORT TcpServer : NonCopyable
+    {
+    public:
+        /**
+         * @brief Construct a new TCP server instance.
+         *
+         * @param loop The event loop in which the acceptor of the server is
+         * handled.
+         * @param address The address of the server, which may be a Unix
+         * domain path or abstract name (see InetAddress::fromUnixPath()).
+         * @param name The name of the server.
+         * @param reUseAddr The SO_REUSEADDR option, not for Unix domain.
+         * @param reUsePort The SO_REUSEPORT option, not for Unix domain.
+         */
+        TcpServer(EventLoop *loop,
+                  const InetAddress &address,
+                  std::string name,
+                  bool reUseAddr = true,
+                  bool reUsePort = true);
+
+        /**
+         * @brief Construct a new TCP server accepting on a socket which is
+         * already bound, e.g. created by the master of a WorkerProcessPool or
+         * inherited in a hot restart (see HotRestart::adoptListener()).
+         *
+         * @param loop The event loop in which the acceptor of the server is
+         * handled.
+         * @param listenFd The socket, it is owned and closed by the server.
+         * @param name The name of the server.
+         * @note The sharded accept is not available on such a socket.
+         */
+        TcpServer(EventLoop *loop, int listenFd, std::string name);
+        ~TcpServer();
+
+        /**
+         * @brief Start the server.
+         *
+         */
+        void start();
+
+        /**
+         * @brief Stop the server, the listening sockets and the connections
+         * are closed. The destructor stops the server too.
+         *
+         * @note It waits for the I/O loops and the loop of the server, they
+         * must still be running, i.e. the loops of the user (see
+         * setIoLoops()) must be quit after the server is stopped.
+         */
+        void stop();
+
+        /**
+         * @brief Adopt a connected socket as a connection of the server, e.g.
+         * an idle connection handed over in a hot restart (see
+         * HotRestart::adoptConnections()). The connection callback is called
+         * in its I/O loop as for an accepted one.
+         *
+         * @param fd The socket, it is owned and closed by the connection.
+         * @note It must be called in the loop of the server, after start().
+         */
+        void adoptConnection(int fd);
+
+        /**
+         * @brief Detach the sockets of the idle connections of the server, see
+         * TcpConnection::detach(). It waits for the I/O loops.
+         *
+         * @return std::vector<int> The duplicates of the sockets, owned by the
+         * caller.
+         * @note It must be called after start(), and not from an I/O loop
+         * other than the loop of the server.
+         */
+        std::vector<int> detachIdleConnections();
+
+        /**
+         * @brief Set the number of event loops in which the I/O of the
+         * connections is handled.
+         *
+         * @param num
+         */
+        void setIoLoopNum(size_t num);
+
+        /**
+         * @brief Set the event loop pool in which the I/O of the connections
+         * is handled.
+         *
+         * @param pool
+         */
+        void setIoLoopThreadPool(const std::shared_ptr<EventLoopThreadPool> &pool);
+
+        /**
+         * @brief Set the event loops in which the I/O of the connections is
+         * handled.
+         *
+         * @param ioLoops
+         */
+        void setIoLoops(const std::vector<EventLoop *> &ioLoops);
+
+        /**
+         * @brief Accept the connections in each I/O loop with a SO_REUSEPORT
+         * listening socket of its own, instead of accepting them in the loop
+         * of the server and handing them over to the I/O loops. The kernel
+         * balances the connections over the sockets, and a connection stays in
+         * the loop that accepted it.
+         *
+         * @param cpuSteering Attach a BPF program to the sockets which steers
+         * a connection to the loop running on the CPU that received it, when
+         * the loops are pinned (see EventLoopThreadPool), or to the CPU number
+         * modulo the number of loops otherwise. Linux only.
+         * @note It must be called before start(), reUsePort must be true. It
+         * has no effect on a Unix domain address.
+         */
+        void enableShardedAccept(bool cpuSteering = false);
+
+        /**
+         * @brief Set the maximum number of connections a listening socket
+         * accepts in one readiness event, 64 by default.
+         *
+         * @param batch
+         * @note It must be called before start().
+         */
+        void setAcceptBatch(size_t batch);
+
+        /**
+         * @brief Close the connections idle for the timeout. The connections
+         * of an I/O loop are tracked by one timing wheel, a read or a write
+         * only refreshes the entry of the connection.
+         *
+         * @param timeout in seconds, 0 disables it.
+         * @note It must be called before start().
+         */
+        void kickoffIdleConnections(size_t timeout)
+        {
+            assert(!started_);
+            idleTimeout_ = timeout;
+        }
+
+        /**
+         * @brief Set the message callback.
+         *
+         * @param cb The callback is called when some data is received on a
+         * connection to the server.
+         */
+        void setRecvMessageCallback(const RecvMessageCallback &cb)
+        {
+            recvMessageCallback_ = cb;
+        }
+        void setRecvMessageCallback(RecvMessageCallback &&cb)
+        {
+            recvMessageCallback_ = std::move(cb);
+        }
+
+        /**
+         * @brief Set the connection callback.
+         *
+         * @param cb The callback is called when a connection is established or
+         * closed.
+         */
+        void setConnectionCallback(const ConnectionCallback &cb)
+        {
+            connectionCallback_ = cb;
+        }
+        void setConnectionCallback(ConnectionCallback &&cb)
+        {
+            connectionCallback_ = std::move(cb);
+        }
+
+        /**
+         * @brief Set the write complete callback.
+         *
+         * @param cb The callback is called when the data to send is sent out
+         * completely.
+         */
+        void setWriteCompleteCallback(const WriteCompleteCallback &cb)
+        {
+            writeCompleteCallback_ = cb;
+        }
+        void setWriteCompleteCallback(WriteCompleteCallback &&cb)
+        {
+            writeCompleteCallback_ = std::move(cb);
+        }
+
+        /**
+         * @brief Get the name of the server.
+         *
+         * @return const std::string&
+         */
+        const std::string &name() const
+        {
+            return serverName_;
+        }
+
+        /**
+         * @brief Get the IP and the port string of the server.
+         *
+         * @return const std::string
+         */
+        const std::string ipPort() const;
+
+        /**
+         * @brief Get the address of the server.
+         *
+         * @return const xiao::InetAddress&
+         */
+        const InetAddress &address() const;
+
+        /**
+         * @brief Get the listening socket of the server, e.g. to hand it over
+         * in a hot restart.
+         *
+         * @return int -1 if the server is stopped or accepts in the I/O loops.
+         */
+        int listenFd() const;
+
+        /**
+         * @brief Get the event loop of the server.
+         *
+         * @return EventLoop*
+         */
+        EventLoop *getLoop() const
+        {
+            return loop_;
+        }
+
+        /**
+         * @brief Get the I/O event loops of the server.
+         *
+         * @return std::vector<EventLoop *>
+         */
+        std::vector<EventLoop *> getIoLoops() const
+        {
+            return ioLoops_;
+        }
+
+    private:
+        // The state of an I/O loop passed to the tasks of its connections.
+        struct IoLoopContext
+        {
+            TcpServer *server;
+            size_t index;
+        };
+
+        void newConnection(size_t loopIndex, int fd, const InetAddress &peer);
+        static void establishConnection(void *context,
+                                        const std::shared_ptr<TcpConnectionImpl> &conn);
+        void connectionClosed(size_t loopIndex, const TcpConnectionPtr &connectionPtr);
+        void startShards();
+        void startTimingWheels();
+        void setupAcceptor();
+
+        EventLoop *loop_;
+        std::unique_ptr<Acceptor> acceptorPtr_;
+        // The address bound, with the port chosen by the system if it was 0.
+        InetAddress address_;
+        // The listening sockets of the I/O loops in the sharded mode.
+        std::vector<std::unique_ptr<Acceptor>> shardAcceptors_;
+        std::string serverName_;
+        // The connections of each I/O loop, only used in that loop. A
+        // connection knows its position, so a list keeps its capacity and
+        // adding or removing one doesn't allocate.
+        std::vector<std::vector<std::shared_ptr<TcpConnectionImpl>>> connLists_;
+        std::vector<IoLoopContext> ioLoopContexts_;
+        // The closed connections of each I/O loop, reused for the new ones.
+        std::vector<std::unique_ptr<ObjectPool<TcpConnectionImpl>>> connPools_;
+        // The wheels of the I/O loops when idleTimeout_ is set, only used in
+        // their loops.
+        std::vector<std::unique_ptr<TimingWheel>> timingWheels_;
+        size_t idleTimeout_{0};
+
+        RecvMessageCallback recvMessageCallback_;
+        ConnectionCallback connectionCallback_;
+        WriteCompleteCallback writeCompleteCallback_;
+
+        std::shared_ptr<EventLoopThreadPool> loopPoolPtr_;
+        std::vector<EventLoop *> ioLoops_;
+        size_t nextLoopIdx_{0};
+        size_t acceptBatch_{0};
+        bool shardedAccept_{false};
+        bool cpuSteering_{false};
+        // The socket was handed over, its address can't be bound again.
+        bool adopted_{false};
+        bool started_{false};
+    };
+} // namespace xiao
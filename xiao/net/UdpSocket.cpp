@@ -0,0 +1,515 @@
+/**
+ * @file UdpSocket.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/UdpSocket.h>
+#include <xiao/net/Channel.h>
+#include <xiao/utils/Logger.h>
+#include "inner/Socket.h"
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+#ifdef __linux__
+#include <netinet/udp.h>
+// Older headers miss them, the kernel rejects them if it doesn't know them.
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
+
+namespace xiao
+{
+    static const size_t xDefaultBatchSize = 32;
+    static const size_t xDefaultMaxDatagramSize = 2048;
+    // The datagrams queued are sent out before the end of the loop iteration
+    // when there are this many.
+    static const size_t xFlushThreshold = 1024;
+    // The datagrams queued while the socket is not writable are dropped
+    // beyond this.
+    static const size_t xMaxOutgoing = 16 * 1024;
+    // The send buffer is released when it grows beyond this.
+    static const size_t xMaxIdleSendBuffer = 4 * 1024 * 1024;
+    // A socket is read at most this many batches at a time, so the other
+    // channels of the loop get a turn.
+    static const int xMaxReadRounds = 4;
+#ifdef __linux__
+    // A datagram coalesced by GRO is up to the maximum IP packet.
+    static const size_t xMaxGroSize = 65535;
+    // The limits of the kernel on a segmented datagram (UDP_MAX_SEGMENTS and
+    // the maximum UDP payload).
+    static const size_t xMaxGsoSegments = 64;
+    static const size_t xMaxGsoBytes = 65000;
+    static const size_t xControlSize = CMSG_SPACE(sizeof(int));
+#endif
+
+    struct UdpSocket::RecvRing
+    {
+        RecvRing(size_t count, size_t bufferSize)
+            : bufferSize_(bufferSize), buffer_(count * bufferSize), addrs_(count)
+#ifdef __linux__
+              ,
+              iovecs_(count),
+              msgs_(count),
+              controls_(count * xControlSize)
+#endif
+        {
+#ifdef __linux__
+            for (size_t i = 0; i < count; ++i)
+            {
+                iovecs_[i].iov_base = &buffer_[i * bufferSize_];
+                iovecs_[i].iov_len = bufferSize_;
+            }
+#endif
+        }
+
+        char *data(size_t i)
+        {
+            return &buffer_[i * bufferSize_];
+        }
+
+#ifdef __linux__
+        // recvmmsg() overwrites the lengths.
+        void reset(size_t i)
+        {
+            auto &hdr = msgs_[i].msg_hdr;
+            hdr.msg_name = &addrs_[i];
+            hdr.msg_namelen = sizeof(addrs_[i]);
+            hdr.msg_iov = &iovecs_[i];
+            hdr.msg_iovlen = 1;
+            hdr.msg_control = &controls_[i * xControlSize];
+            hdr.msg_controllen = xControlSize;
+            hdr.msg_flags = 0;
+        }
+#endif
+
+        size_t bufferSize_;
+        std::vector<char> buffer_;
+        std::vector<struct sockaddr_in6> addrs_;
+#ifdef __linux__
+        std::vector<struct iovec> iovecs_;
+        std::vector<struct mmsghdr> msgs_;
+        std::vector<char> controls_;
+#endif
+    };
+
+    struct UdpSocket::SendBatch
+    {
+        explicit SendBatch(size_t count)
+#ifdef __linux__
+            : iovecs_(count), msgs_(count), controls_(count * xControlSize), counts_(count)
+#endif
+        {
+        }
+
+#ifdef __linux__
+        std::vector<struct iovec> iovecs_;
+        std::vector<struct mmsghdr> msgs_;
+        std::vector<char> controls_;
+        // The number of datagrams in each message.
+        std::vector<size_t> counts_;
+#endif
+    };
+
+    UdpSocket::UdpSocket(EventLoop *loop, const InetAddress &localAddr, bool reusePort)
+        : loop_(loop),
+          socketPtr_(new Socket(
+              Socket::createNonblockingDatagramSocketOrDie(localAddr.family()))),
+          channelPtr_(new Channel(loop, socketPtr_->fd())),
+          localAddr_(localAddr),
+          batchSize_(xDefaultBatchSize),
+          maxDatagramSize_(xDefaultMaxDatagramSize)
+    {
+        socketPtr_->setReuseAddr(true);
+        if (reusePort)
+            socketPtr_->setReusePort(true);
+        socketPtr_->bindAddress(localAddr);
+        localAddr_.setSockAddrInet6(Socket::getLocalAddr(socketPtr_->fd()));
+        setGso(true);
+        setGro(true);
+        channelPtr_->setReadCallback([this]() { handleRead(); });
+        channelPtr_->setWriteCallback([this]() { handleWrite(); });
+    }
+
+    UdpSocket::~UdpSocket()
+    {
+        // The channel is only in the poller after start().
+        if (channelPtr_->index() != -1)
+        {
+            loop_->assertInLoopThread();
+            channelPtr_->disableAll();
+            channelPtr_->remove();
+        }
+    }
+
+    void UdpSocket::setBatchSize(size_t batchSize)
+    {
+        assert(!started_);
+        batchSize_ = batchSize > 0 ? batchSize : 1;
+    }
+
+    void UdpSocket::setMaxDatagramSize(size_t size)
+    {
+        assert(!started_);
+        maxDatagramSize_ = size;
+    }
+
+    bool UdpSocket::setGso(bool on)
+    {
+        assert(!started_);
+        gsoEnabled_ = false;
+#ifdef __linux__
+        if (on)
+        {
+            // Probe with a default segment size of 0, the segment size is
+            // given with each message.
+            int gsoSize = 0;
+            gsoEnabled_ = ::setsockopt(socketPtr_->fd(),
+                                       SOL_UDP,
+                                       UDP_SEGMENT,
+                                       &gsoSize,
+                                       sizeof(gsoSize)) == 0;
+        }
+#endif
+        return gsoEnabled_ == on;
+    }
+
+    bool UdpSocket::setGro(bool on)
+    {
+        assert(!started_);
+#ifdef __linux__
+        int value = on ? 1 : 0;
+        if (::setsockopt(socketPtr_->fd(), SOL_UDP, UDP_GRO, &value, sizeof(value)) == 0)
+            groEnabled_ = on;
+        else if (on)
+            groEnabled_ = false;
+#endif
+        return groEnabled_ == on;
+    }
+
+    void UdpSocket::start()
+    {
+        auto thisPtr = shared_from_this();
+        loop_->runInLoop([thisPtr]() { thisPtr->startInLoop(); });
+    }
+
+    void UdpSocket::startInLoop()
+    {
+        if (started_)
+            return;
+        started_ = true;
+        size_t bufferSize = groEnabled_ ? xMaxGroSize : maxDatagramSize_;
+        recvRing_.reset(new RecvRing(batchSize_, bufferSize));
+        sendBatch_.reset(new SendBatch(batchSize_));
+        channelPtr_->tie(shared_from_this());
+        channelPtr_->enableReading();
+    }
+
+    void UdpSocket::stop()
+    {
+        auto thisPtr = shared_from_this();
+        loop_->runInLoop([thisPtr]() {
+            if (!thisPtr->started_)
+                return;
+            thisPtr->started_ = false;
+            thisPtr->channelPtr_->disableAll();
+            thisPtr->outgoing_.clear();
+            thisPtr->sendBuffer_.clear();
+        });
+    }
+
+    bool UdpSocket::send(const char *data, size_t len, const InetAddress &peer)
+    {
+        if (loop_->isInLoopThread())
+            return sendInLoop(data, len, peer);
+        auto thisPtr = shared_from_this();
+        std::string msg(data, len);
+        loop_->queueInLoop([thisPtr, msg, peer]() {
+            thisPtr->sendInLoop(msg.data(), msg.length(), peer);
+        });
+        return true;
+    }
+
+    bool UdpSocket::sendInLoop(const char *data, size_t len, const InetAddress &peer)
+    {
+        if (!started_ || outgoing_.size() >= xMaxOutgoing)
+        {
+            ++droppedCount_;
+            return false;
+        }
+        outgoing_.push_back(Outgoing{sendBuffer_.size(), len, peer});
+        sendBuffer_.insert(sendBuffer_.end(), data, data + len);
+        // Waiting for the socket to be writable.
+        if (channelPtr_->isWriting())
+            return true;
+        if (outgoing_.size() >= xFlushThreshold)
+        {
+            flush();
+        }
+        else if (!flushQueued_)
+        {
+            flushQueued_ = true;
+            std::weak_ptr<UdpSocket> weakPtr = shared_from_this();
+            loop_->queueInLoop([weakPtr]() {
+                auto thisPtr = weakPtr.lock();
+                if (!thisPtr)
+                    return;
+                thisPtr->flushQueued_ = false;
+                thisPtr->flush();
+            });
+        }
+        return true;
+    }
+
+    void UdpSocket::flush()
+    {
+        loop_->assertInLoopThread();
+        if (!started_)
+            return;
+        size_t done = 0;
+        while (done < outgoing_.size())
+        {
+            size_t n = sendBatch(done);
+            if (n == 0)
+                break;
+            done += n;
+        }
+        if (done == outgoing_.size())
+        {
+            outgoing_.clear();
+            if (sendBuffer_.capacity() > xMaxIdleSendBuffer)
+                std::vector<char>().swap(sendBuffer_);
+            else
+                sendBuffer_.clear();
+            if (channelPtr_->isWriting())
+                channelPtr_->disableWriting();
+            return;
+        }
+        if (done > 0)
+        {
+            size_t offset = outgoing_[done].offset_;
+            sendBuffer_.erase(sendBuffer_.begin(), sendBuffer_.begin() + offset);
+            outgoing_.erase(outgoing_.begin(), outgoing_.begin() + done);
+            for (auto &datagram : outgoing_)
+                datagram.offset_ -= offset;
+        }
+        if (!channelPtr_->isWriting())
+            channelPtr_->enableWriting();
+    }
+
+    void UdpSocket::handleWrite()
+    {
+        flush();
+    }
+
+    size_t UdpSocket::sendBatch(size_t first)
+    {
+        int fd = socketPtr_->fd();
+#ifdef __linux__
+        auto &batch = *sendBatch_;
+        size_t msgCount = 0;
+        size_t next = first;
+        while (msgCount < batchSize_ && next < outgoing_.size())
+        {
+            const auto &head = outgoing_[next];
+            size_t count = 1;
+            size_t bytes = head.len_;
+            if (gsoEnabled_ && head.len_ > 0)
+            {
+                // The segments have the size of the first one, but the last
+                // one may be shorter.
+                while (next + count < outgoing_.size() && count < xMaxGsoSegments)
+                {
+                    const auto &datagram = outgoing_[next + count];
+                    if (datagram.len_ > head.len_ || datagram.len_ == 0 ||
+                        bytes + datagram.len_ > xMaxGsoBytes ||
+                        datagram.peer_.getSockAddrLen() != head.peer_.getSockAddrLen() ||
+                        memcmp(datagram.peer_.getSockAddr(),
+                               head.peer_.getSockAddr(),
+                               head.peer_.getSockAddrLen()) != 0)
+                        break;
+                    bytes += datagram.len_;
+                    ++count;
+                    if (datagram.len_ < head.len_)
+                        break;
+                }
+            }
+            auto &iov = batch.iovecs_[msgCount];
+            iov.iov_base = &sendBuffer_[head.offset_];
+            iov.iov_len = bytes;
+            auto &hdr = batch.msgs_[msgCount].msg_hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_name = const_cast<struct sockaddr *>(head.peer_.getSockAddr());
+            hdr.msg_namelen = head.peer_.getSockAddrLen();
+            hdr.msg_iov = &iov;
+            hdr.msg_iovlen = 1;
+            if (count > 1)
+            {
+                hdr.msg_control = &batch.controls_[msgCount * xControlSize];
+                hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t segmentSize = static_cast<uint16_t>(head.len_);
+                memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+            }
+            batch.counts_[msgCount] = count;
+            next += count;
+            ++msgCount;
+        }
+        int n = ::sendmmsg(fd, batch.msgs_.data(), static_cast<unsigned int>(msgCount), 0);
+        if (n > 0)
+        {
+            size_t sent = 0;
+            for (int i = 0; i < n; ++i)
+                sent += batch.counts_[i];
+            sentCount_ += sent;
+            return sent;
+        }
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK || savedErrno == EINTR)
+            return 0;
+        if (gsoEnabled_ && batch.counts_[0] > 1 &&
+            (savedErrno == EIO || savedErrno == EINVAL))
+        {
+            // The device can't offload the checksums of segmented datagrams.
+            LOG_WARN << "UDP_SEGMENT failed (" << strerror(savedErrno)
+                     << "), send the datagrams one by one";
+            gsoEnabled_ = false;
+            return sendBatch(first);
+        }
+        // E.g. an ICMP error of an earlier datagram, or the datagram is too
+        // long, the first message is dropped.
+        LOG_ERROR << "Failed to send to " << outgoing_[first].peer_.toIpPort() << ": "
+                  << strerror(savedErrno);
+        droppedCount_ += batch.counts_[0];
+        return batch.counts_[0];
+#else
+        const auto &datagram = outgoing_[first];
+        auto n = ::sendto(fd,
+                          &sendBuffer_[datagram.offset_],
+                          static_cast<int>(datagram.len_),
+                          0,
+                          datagram.peer_.getSockAddr(),
+                          datagram.peer_.getSockAddrLen());
+        if (n >= 0)
+        {
+            ++sentCount_;
+            return 1;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return 0;
+        LOG_ERROR << "Failed to send to " << datagram.peer_.toIpPort() << ": "
+                  << strerror(errno);
+        ++droppedCount_;
+        return 1;
+#endif
+    }
+
+    void UdpSocket::handleRead()
+    {
+        int fd = socketPtr_->fd();
+        auto &ring = *recvRing_;
+        for (int round = 0; round < xMaxReadRounds && started_; ++round)
+        {
+#ifdef __linux__
+            for (size_t i = 0; i < batchSize_; ++i)
+                ring.reset(i);
+            int n = ::recvmmsg(fd,
+                               ring.msgs_.data(),
+                               static_cast<unsigned int>(batchSize_),
+                               0,
+                               nullptr);
+            if (n < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    LOG_SYSERR << "UdpSocket::handleRead";
+                return;
+            }
+            for (int i = 0; i < n; ++i)
+            {
+                auto &hdr = ring.msgs_[i].msg_hdr;
+                if (hdr.msg_flags & MSG_TRUNC)
+                {
+                    ++droppedCount_;
+                    continue;
+                }
+                size_t segmentSize = 0;
+                if (groEnabled_)
+                {
+                    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr;
+                         cmsg = CMSG_NXTHDR(&hdr, cmsg))
+                    {
+                        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+                        {
+                            int gsoSize;
+                            memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof(gsoSize));
+                            segmentSize = static_cast<size_t>(gsoSize);
+                        }
+                    }
+                }
+                InetAddress peer;
+                peer.setSockAddrInet6(ring.addrs_[i]);
+                dispatch(ring.data(i), ring.msgs_[i].msg_len, segmentSize, peer);
+            }
+            if (static_cast<size_t>(n) < batchSize_)
+                return;
+#else
+            for (size_t i = 0; i < batchSize_; ++i)
+            {
+                socklen_t addrLen = sizeof(ring.addrs_[i]);
+                auto n = ::recvfrom(fd,
+                                    ring.data(i),
+                                    static_cast<int>(ring.bufferSize_),
+                                    0,
+                                    reinterpret_cast<struct sockaddr *>(&ring.addrs_[i]),
+                                    &addrLen);
+                if (n < 0)
+                    return;
+                InetAddress peer;
+                peer.setSockAddrInet6(ring.addrs_[i]);
+                dispatch(ring.data(i), static_cast<size_t>(n), 0, peer);
+            }
+#endif
+        }
+    }
+
+    void UdpSocket::dispatch(const char *data,
+                             size_t len,
+                             size_t segmentSize,
+                             const InetAddress &peer)
+    {
+        if (segmentSize == 0 || segmentSize >= len)
+        {
+            if (len > maxDatagramSize_)
+            {
+                ++droppedCount_;
+                return;
+            }
+            if (messageCallback_)
+                messageCallback_(data, len, peer);
+            return;
+        }
+        for (size_t offset = 0; offset < len && started_; offset += segmentSize)
+        {
+            if (messageCallback_)
+                messageCallback_(data + offset, (std::min)(segmentSize, len - offset), peer);
+        }
+    }
+} // namespace xiao
@@ -0,0 +1,250 @@
+/**
+ * @file UdpSocket.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/EventLoop.h>
+#include <xiao/net/InetAddress.h>
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/exports.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace xiao
+{
+    class Channel;
+    class Socket;
+
+    /**
+     * @brief This class represents a UDP socket bound to a local address and
+     * handled in an event loop.
+     *
+     * The datagrams are received in batches into a ring of buffers allocated
+     * once, and the datagrams sent in an iteration of the loop are sent out
+     * in batches at the end of it. On Linux the batches are made with
+     * recvmmsg()/sendmmsg(), the datagrams of the same size sent in a row to
+     * the same peer are sent as one with UDP_SEGMENT (GSO) and the datagrams
+     * coalesced by the kernel with UDP_GRO are split before the callback,
+     * where the kernel supports them.
+     *
+     * @note It must be owned by a shared_ptr and destroyed in its loop.
+     */
+    class XIAO_EXPORT UdpSocket : NonCopyable,
+                                  public std::enable_shared_from_this<UdpSocket>
+    {
+    public:
+        /**
+         * @brief Called with each datagram received, the data is valid
+         * during the call only.
+         */
+        using MessageCallback =
+            std::function<void(const char *data, size_t len, const InetAddress &peer)>;
+
+        /**
+         * @brief Construct a new UDP socket, bound to the local address.
+         *
+         * @param loop The event loop in which the socket is handled.
+         * @param localAddr The local address, the port may be 0.
+         * @param reusePort Set SO_REUSEPORT to share the port among several
+         * sockets, e.g. one per loop.
+         */
+        UdpSocket(EventLoop *loop, const InetAddress &localAddr, bool reusePort = false);
+        ~UdpSocket();
+
+        /**
+         * @brief Set the number of datagrams received or sent by one system
+         * call, 32 by default. It must be called before start().
+         *
+         * @param batchSize
+         */
+        void setBatchSize(size_t batchSize);
+
+        /**
+         * @brief Set the size of the largest datagram received, 2048 bytes
+         * by default, the datagrams longer are dropped. It must be called
+         * before start().
+         *
+         * @param size
+         */
+        void setMaxDatagramSize(size_t size);
+
+        /**
+         * @brief Set the message callback.
+         *
+         * @param cb
+         */
+        void setMessageCallback(const MessageCallback &cb)
+        {
+            messageCallback_ = cb;
+        }
+        void setMessageCallback(MessageCallback &&cb)
+        {
+            messageCallback_ = std::move(cb);
+        }
+
+        /**
+         * @brief Start receiving, it can be called in any thread.
+         *
+         */
+        void start();
+
+        /**
+         * @brief Stop receiving and sending, it can be called in any thread.
+         * The datagrams not sent yet are dropped.
+         *
+         */
+        void stop();
+
+        /**
+         * @brief Send a datagram, it can be called in any thread. It is
+         * queued and sent out with the others sent in the same iteration of
+         * the loop.
+         *
+         * @param data
+         * @param len
+         * @param peer
+         * @return false if it is dropped because too many datagrams are
+         * waiting for the socket to be writable.
+         */
+        bool send(const char *data, size_t len, const InetAddress &peer);
+        bool send(const std::string &msg, const InetAddress &peer)
+        {
+            return send(msg.data(), msg.length(), peer);
+        }
+
+        /**
+         * @brief Send the datagrams queued now, in the loop thread.
+         *
+         */
+        void flush();
+
+        /**
+         * @brief Get the local address, with the port bound.
+         *
+         * @return const InetAddress&
+         */
+        const InetAddress &localAddr() const
+        {
+            return localAddr_;
+        }
+
+        EventLoop *getLoop() const
+        {
+            return loop_;
+        }
+
+        /**
+         * @brief Enable or disable sending the datagrams of the same size to
+         * the same peer as one segmented datagram (UDP_SEGMENT). It is enabled
+         * by default where the kernel supports it. It must be called before
+         * start().
+         *
+         * @param on
+         * @return false if it can't be enabled.
+         */
+        bool setGso(bool on);
+
+        /**
+         * @brief Enable or disable receiving the datagrams coalesced by the
+         * kernel (UDP_GRO). It is enabled by default where the kernel supports
+         * it. It must be called before start().
+         *
+         * @param on
+         * @return false if it can't be enabled.
+         */
+        bool setGro(bool on);
+
+        /**
+         * @brief Check whether the kernel sends segmented datagrams
+         * (UDP_SEGMENT) for the socket.
+         *
+         */
+        bool gsoEnabled() const
+        {
+            return gsoEnabled_;
+        }
+
+        /**
+         * @brief Check whether the kernel coalesces received datagrams
+         * (UDP_GRO) for the socket.
+         *
+         */
+        bool groEnabled() const
+        {
+            return groEnabled_;
+        }
+
+        /**
+         * @brief Get the number of datagrams handed to the kernel, a segmented
+         * datagram counts as its segments. The datagrams queued by send() are
+         * only counted once they are sent out.
+         *
+         */
+        size_t sentCount() const
+        {
+            return sentCount_;
+        }
+
+        /**
+         * @brief Get the number of datagrams dropped because they were too
+         * long to receive or there was no room to queue them for sending.
+         *
+         */
+        size_t droppedCount() const
+        {
+            return droppedCount_;
+        }
+
+    private:
+        // A datagram queued, in the send buffer at the offset.
+        struct Outgoing
+        {
+            size_t offset_;
+            size_t len_;
+            InetAddress peer_;
+        };
+        struct RecvRing;
+        struct SendBatch;
+
+        void startInLoop();
+        bool sendInLoop(const char *data, size_t len, const InetAddress &peer);
+        void handleRead();
+        void handleWrite();
+        // Send the datagrams queued from the first one on, return the number
+        // of them sent or dropped, or 0 if the socket blocks.
+        size_t sendBatch(size_t first);
+        void dispatch(const char *data,
+                      size_t len,
+                      size_t segmentSize,
+                      const InetAddress &peer);
+
+        EventLoop *loop_;
+        std::unique_ptr<Socket> socketPtr_;
+        std::unique_ptr<Channel> channelPtr_;
+        InetAddress localAddr_;
+        MessageCallback messageCallback_;
+        size_t batchSize_;
+        size_t maxDatagramSize_;
+        bool gsoEnabled_{false};
+        bool groEnabled_{false};
+        bool started_{false};
+        std::unique_ptr<RecvRing> recvRing_;
+        std::unique_ptr<SendBatch> sendBatch_;
+        std::vector<char> sendBuffer_;
+        std::vector<Outgoing> outgoing_;
+        bool flushQueued_{false};
+        size_t sentCount_{0};
+        size_t droppedCount_{0};
+    };
+
+    using UdpSocketPtr = std::shared_ptr<UdpSocket>;
+} // namespace xiao
@@ -0,0 +1,225 @@
+/**
+ * @file WorkerProcessPool.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/WorkerProcessPool.h>
+#ifdef __linux__
+#include <xiao/net/EventLoop.h>
+#include <xiao/utils/Logger.h>
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace xiao
+{
+    static double now()
+    {
+        return std::chrono::duration<double>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    WorkerProcessPool::WorkerProcessPool(EventLoop *loop, size_t workerNum)
+        : loop_(loop),
+          workerNum_(workerNum),
+          pids_(workerNum, 0),
+          restartAt_(workerNum, 0.0)
+    {
+        assert(workerNum_ > 0);
+        sigemptyset(&oldMask_);
+    }
+
+    WorkerProcessPool::~WorkerProcessPool()
+    {
+        for (auto &listener : listeners_)
+        {
+            ::close(listener.fd);
+        }
+    }
+
+    int WorkerProcessPool::addListener(const std::string &name,
+                                       const InetAddress &addr,
+                                       bool reUseAddr)
+    {
+        int fd = ::socket(addr.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            LOG_SYSERR << "Failed to create the listening socket " << name;
+            return -1;
+        }
+        int on = reUseAddr ? 1 : 0;
+        if (!addr.isUnixDomain())
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, static_cast<socklen_t>(sizeof(on)));
+        if (::bind(fd, addr.getSockAddr(), addr.getSockAddrLen()) < 0 ||
+            ::listen(fd, SOMAXCONN) < 0)
+        {
+            LOG_SYSERR << "Failed to listen on " << addr.toIpPort() << " for " << name;
+            ::close(fd);
+            return -1;
+        }
+        listeners_.push_back({name, fd});
+        return fd;
+    }
+
+    void WorkerProcessPool::run()
+    {
+        loop_->assertInLoopThread();
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGCHLD);
+        sigaddset(&set, SIGTERM);
+        sigaddset(&set, SIGINT);
+        sigaddset(&set, SIGHUP);
+        // The signals are taken with sigtimedwait(), they are never delivered
+        // to a handler in the master.
+        pthread_sigmask(SIG_BLOCK, &set, &oldMask_);
+
+        for (size_t i = 0; i < workerNum_; ++i)
+        {
+            spawn(i);
+        }
+        while (true)
+        {
+            double timeout = 1.0;
+            for (size_t i = 0; i < workerNum_; ++i)
+            {
+                if (pids_[i] == 0)
+                    timeout = std::min(timeout, restartAt_[i] - now());
+            }
+            timeout = std::max(timeout, 0.0);
+            struct timespec ts;
+            ts.tv_sec = static_cast<time_t>(timeout);
+            ts.tv_nsec = static_cast<long>((timeout - ts.tv_sec) * 1000000000);
+            int signo = ::sigtimedwait(&set, nullptr, &ts);
+            if (signo == SIGTERM || signo == SIGINT)
+            {
+                LOG_INFO << "Master " << ::getpid() << " got signal " << signo
+                         << ", stopping the workers";
+                stopWorkers();
+                break;
+            }
+            if (signo == SIGHUP)
+            {
+                for (auto pid : pids_)
+                {
+                    if (pid > 0)
+                        ::kill(pid, SIGHUP);
+                }
+            }
+            else if (signo < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                LOG_SYSERR << "sigtimedwait";
+            }
+            // SIGCHLD is not queued, several exits can be merged into one
+            // signal, so reap on every wakeup.
+            reap();
+            auto current = now();
+            for (size_t i = 0; i < workerNum_; ++i)
+            {
+                if (pids_[i] == 0 && restartAt_[i] <= current)
+                    spawn(i);
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &oldMask_, nullptr);
+    }
+
+    void WorkerProcessPool::spawn(size_t index)
+    {
+        auto masterPid = ::getpid();
+        auto pid = ::fork();
+        if (pid < 0)
+        {
+            LOG_SYSERR << "Failed to fork worker " << index;
+            restartAt_[index] = now() + restartDelay_;
+            return;
+        }
+        if (pid == 0)
+        {
+            // Do not outlive the master.
+            ::prctl(PR_SET_PDEATHSIG, SIGTERM);
+            if (::getppid() != masterPid)
+                ::_exit(0);
+            runWorker(index);
+            ::exit(0);
+        }
+        LOG_INFO << "Worker " << index << " started, pid " << pid;
+        pids_[index] = pid;
+    }
+
+    void WorkerProcessPool::runWorker(size_t index)
+    {
+        loop_->resetAfterFork();
+        loop_->resetTimerQueue();
+        // The default action of the SIGHUP forwarded by the master would kill
+        // the worker. It is taken by the loop while still blocked, and kept
+        // blocked, until the init callback sets a callback of its own.
+        loop_->setSignalCallback(SIGHUP, []() {
+            LOG_DEBUG << "Worker " << ::getpid() << " ignores SIGHUP";
+        });
+        sigset_t mask = oldMask_;
+        sigaddset(&mask, SIGHUP);
+        pthread_sigmask(SIG_SETMASK, &mask, nullptr);
+        if (workerInitCallback_)
+            workerInitCallback_(index);
+        loop_->loop();
+    }
+
+    void WorkerProcessPool::reap()
+    {
+        int status = 0;
+        pid_t pid;
+        while ((pid = ::waitpid(-1, &status, WNOHANG)) > 0)
+        {
+            auto iter = std::find(pids_.begin(), pids_.end(), pid);
+            if (iter == pids_.end())
+                continue;
+            size_t index = iter - pids_.begin();
+            if (WIFSIGNALED(status))
+            {
+                LOG_ERROR << "Worker " << index << " (pid " << pid
+                          << ") was killed by signal " << WTERMSIG(status);
+            }
+            else
+            {
+                LOG_WARN << "Worker " << index << " (pid " << pid
+                         << ") exited with status " << WEXITSTATUS(status);
+            }
+            pids_[index] = 0;
+            restartAt_[index] = now() + restartDelay_;
+        }
+    }
+
+    void WorkerProcessPool::stopWorkers()
+    {
+        for (auto pid : pids_)
+        {
+            if (pid > 0)
+                ::kill(pid, SIGTERM);
+        }
+        for (auto &pid : pids_)
+        {
+            if (pid <= 0)
+                continue;
+            int status = 0;
+            while (::waitpid(pid, &status, 0) < 0 && errno == EINTR)
+            {
+            }
+            pid = 0;
+        }
+    }
+} // namespace xiao
+#endif
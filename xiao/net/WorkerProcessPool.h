@@ -0,0 +1,173 @@
+/**
+ * @file WorkerProcessPool.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#ifdef __linux__
+#include <xiao/net/HotRestart.h>
+#include <xiao/net/InetAddress.h>
+#include <xiao/net/TcpServer.h>
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/exports.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <sys/types.h>
+
+namespace xiao
+{
+    class EventLoop;
+
+    /**
+     * @brief This class implements the pre-fork master/worker process mode.
+     * The master process creates the listening sockets and the event loop
+     * before calling run(), then forks the workers and supervises them. Each
+     * worker rebuilds the poller, the wakeup fd and the timer queue of the
+     * loop, calls the init callback and runs the loop.
+     *
+     * The master restarts the workers that exit, forwards SIGHUP to them and
+     * stops them all on SIGTERM or SIGINT. A worker ignores SIGHUP unless its
+     * init callback handles it with EventLoop::setSignalCallback(), e.g. to
+     * reload the configuration.
+     *
+     * The listening sockets are created in the master with addListener(), so
+     * every worker accepts on the same sockets, and each worker adopts them
+     * into servers of its loop in the init callback:
+     *
+     * @code
+       xiao::WorkerProcessPool pool(&loop, 4);
+       pool.addListener("http", xiao::InetAddress(8080));
+       std::unique_ptr<xiao::TcpServer> server;
+       pool.setWorkerInitCallback([&](size_t) {
+           server = pool.adoptListener("http", "http");
+           server->setRecvMessageCallback(...);
+           server->start();
+       });
+       pool.run();
+       @endcode
+     *
+     * @note Only supported on Linux. The master never runs the event loop, so
+     * the callbacks registered on it before run() only run in the workers.
+     */
+    class XIAO_EXPORT WorkerProcessPool : NonCopyable
+    {
+    public:
+        using WorkerInitCallback = std::function<void(size_t)>;
+
+        /**
+         * @brief Construct a new worker process pool.
+         *
+         * @param loop The event loop run by every worker. It must be created
+         * in the thread calling run() and must not be running.
+         * @param workerNum The number of worker processes.
+         */
+        WorkerProcessPool(EventLoop *loop, size_t workerNum);
+        ~WorkerProcessPool();
+
+        /**
+         * @brief Create a listening socket in the master, shared by the
+         * workers. It must be called before run().
+         *
+         * @param name The name the workers adopt the socket by.
+         * @param addr The address to bind.
+         * @param reUseAddr The SO_REUSEADDR option, not for Unix domain.
+         * @return int The fd of the socket, or -1 if it can't be bound.
+         */
+        int addListener(const std::string &name,
+                        const InetAddress &addr,
+                        bool reUseAddr = true);
+
+        /**
+         * @brief Share a listening socket created otherwise, e.g. taken over
+         * in a hot restart, with the workers. The pool owns the fd.
+         *
+         * @param fd
+         */
+        void addListener(const InheritedFd &fd)
+        {
+            listeners_.push_back(fd);
+        }
+
+        /**
+         * @brief Get the listening sockets shared with the workers.
+         *
+         * @return const std::vector<InheritedFd>&
+         */
+        const std::vector<InheritedFd> &listeners() const
+        {
+            return listeners_;
+        }
+
+        /**
+         * @brief Adopt a listening socket of the master into a server of the
+         * loop, called in the init callback of a worker.
+         *
+         * @param name The name given to addListener().
+         * @param serverName The name of the server.
+         * @return std::unique_ptr<TcpServer> nullptr if no socket has the
+         * name.
+         */
+        std::unique_ptr<TcpServer> adoptListener(const std::string &name,
+                                                 std::string serverName)
+        {
+            return HotRestart::adoptListener(loop_, listeners_, name, std::move(serverName));
+        }
+
+        /**
+         * @brief Set the callback called in each worker before its loop runs,
+         * the parameter is the index of the worker, in [0, workerNum).
+         *
+         * @param cb
+         */
+        void setWorkerInitCallback(const WorkerInitCallback &cb)
+        {
+            workerInitCallback_ = cb;
+        }
+
+        /**
+         * @brief Set the delay before restarting a worker that exited, so a
+         * worker crashing at startup does not make the master spin.
+         *
+         * @param seconds The default value is 1 second.
+         */
+        void setRestartDelay(double seconds)
+        {
+            restartDelay_ = seconds;
+        }
+
+        /**
+         * @brief Fork the workers and supervise them until the master receives
+         * SIGTERM or SIGINT. The workers never return from this method.
+         *
+         */
+        void run();
+
+    private:
+        void spawn(size_t index);
+        void runWorker(size_t index);
+        void reap();
+        void stopWorkers();
+
+        EventLoop *loop_;
+        size_t workerNum_;
+        double restartDelay_{1.0};
+        WorkerInitCallback workerInitCallback_;
+        // The listening sockets created by the master.
+        std::vector<InheritedFd> listeners_;
+        // The pid of each worker, 0 when the worker is not running.
+        std::vector<pid_t> pids_;
+        // The time (seconds on the steady clock) each stopped worker restarts.
+        std::vector<double> restartAt_;
+        sigset_t oldMask_;
+    };
+} // namespace xiao
+#endif
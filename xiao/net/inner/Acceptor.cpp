@@ -0,0 +1,229 @@
+/**
+ * @file Acceptor.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "Acceptor.h"
+#include <errno.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace xiao
+{
+    static const size_t xDefaultAcceptBatch = 64;
+    // How long accepting is paused when no fd can be freed to drop a
+    // connection.
+    static const double xAcceptPauseSeconds = 0.1;
+
+#ifndef _WIN32
+    // A socket file left by a server which is gone makes bind() fail, it
+    // can't be reused like a port in TIME_WAIT. The file is only removed if
+    // nothing listens on it any more, which connect() tells by failing with
+    // ECONNREFUSED. Otherwise the file is kept and the bind fails.
+    static void removeStaleSocketFile(const InetAddress &addr)
+    {
+        auto path = addr.toIp();
+        if (path.empty() || path[0] == '@')
+            return;
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode))
+            return;
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            LOG_SYSERR << "socket";
+            return;
+        }
+        int ret = ::connect(fd, addr.getSockAddr(), addr.getSockAddrLen());
+        int err = errno;
+        ::close(fd);
+        if (ret < 0 && err == ECONNREFUSED)
+        {
+            LOG_TRACE << "remove the socket file " << path;
+            ::unlink(path.c_str());
+        }
+        else if (ret == 0)
+        {
+            LOG_ERROR << "A server is listening on " << path;
+        }
+    }
+#endif
+
+    Acceptor::Acceptor(EventLoop *loop,
+                       const InetAddress &addr,
+                       bool reUseAddr,
+                       bool reUsePort)
+        : sock_(Socket::createNonblockingSocketOrDie(addr.family())),
+          addr_(addr),
+          loop_(loop),
+          acceptChannel_(loop, sock_.fd()),
+          acceptBatch_(xDefaultAcceptBatch)
+#ifndef _WIN32
+          ,
+          idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+#endif
+    {
+        if (addr_.isUnixDomain())
+        {
+#ifndef _WIN32
+            removeStaleSocketFile(addr_);
+#endif
+        }
+        else
+        {
+            sock_.setReuseAddr(reUseAddr);
+            sock_.setReusePort(reUsePort);
+        }
+        sock_.bindAddress(addr_);
+        acceptChannel_.setReadCallback(std::bind(&Acceptor::readCallback, this));
+        if (!addr_.isUnixDomain() && addr_.toPort() == 0)
+        {
+            addr_ = Socket::getLocalAddress(sock_.fd());
+        }
+    }
+
+    Acceptor::Acceptor(EventLoop *loop, int listenFd)
+        : sock_(listenFd),
+          addr_(Socket::getLocalAddress(listenFd)),
+          loop_(loop),
+          acceptChannel_(loop, sock_.fd()),
+          acceptBatch_(xDefaultAcceptBatch)
+#ifndef _WIN32
+          ,
+          idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+#endif
+    {
+        // The flags of an inherited socket are those set by its creator.
+        Socket::setNonBlockAndCloseOnExec(sock_.fd());
+        acceptChannel_.setReadCallback(std::bind(&Acceptor::readCallback, this));
+    }
+
+    Acceptor::~Acceptor()
+    {
+        // The channel is only in the poller after listen().
+        if (listening_)
+        {
+            if (resumeTimerId_ != InvalidTimerId)
+                loop_->invalidateTimer(resumeTimerId_);
+            acceptChannel_.disableAll();
+            acceptChannel_.remove();
+        }
+#ifndef _WIN32
+        if (idleFd_ >= 0)
+            ::close(idleFd_);
+#endif
+    }
+
+    void Acceptor::listen()
+    {
+        // Listening again on a listening socket only updates its backlog.
+        if (beforeListenSetSockOptCallback_)
+            beforeListenSetSockOptCallback_(sock_.fd());
+        sock_.listen();
+        listening_ = true;
+        loop_->runInLoop([this]() { acceptChannel_.enableReading(); });
+    }
+
+    void Acceptor::readCallback()
+    {
+        // Drain the backlog, up to the batch size so that one busy socket
+        // doesn't starve the other channels of the loop.
+        for (size_t i = 0; i < acceptBatch_; ++i)
+        {
+            InetAddress peer;
+            int newsock = sock_.accept(&peer);
+            if (newsock < 0)
+            {
+                int err = errno;
+                if (err == EAGAIN || err == EWOULDBLOCK)
+                    return;
+                if (!handleAcceptError(err))
+                    return;
+                continue;
+            }
+            if (afterAcceptSetSockOptCallback_)
+                afterAcceptSetSockOptCallback_(newsock);
+            if (newConnectionCallback_)
+            {
+                newConnectionCallback_(newsock, peer);
+            }
+            else
+            {
+#ifndef _WIN32
+                ::close(newsock);
+#else
+                closesocket(newsock);
+#endif
+            }
+        }
+    }
+
+    bool Acceptor::handleAcceptError(int err)
+    {
+        switch (err)
+        {
+            case EINTR:
+            case ECONNABORTED:
+            case EPROTO:
+                // The connection is gone, try the next one.
+                return true;
+#ifndef _WIN32
+            case EMFILE:
+            case ENFILE:
+            {
+                if (idleFd_ < 0)
+                    break;
+                // Accept the pending connection with the reserved fd and
+                // close it, then reserve the fd again.
+                ::close(idleFd_);
+                // With close-on-exec, so the connection doesn't leak into a
+                // process exec'd by another thread before it is closed.
+#ifdef __linux__
+                int dropped = ::accept4(sock_.fd(), nullptr, nullptr, SOCK_CLOEXEC);
+#else
+                int dropped = ::accept(sock_.fd(), nullptr, nullptr);
+#endif
+                int droppedErr = errno;
+                if (dropped >= 0)
+                {
+                    LOG_ERROR << "Out of file descriptors, dropping a connection";
+                    ::close(dropped);
+                }
+                idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+                // The fd is checked before the backlog, accept() fails with
+                // EMFILE once the backlog is drained too.
+                return dropped >= 0 ||
+                       (droppedErr != EAGAIN && droppedErr != EWOULDBLOCK);
+            }
+#endif
+            default:
+                break;
+        }
+        LOG_SYSERR << "Acceptor::readCallback";
+        pauseAccepting();
+        return false;
+    }
+
+    void Acceptor::pauseAccepting()
+    {
+        // The pending connections keep the socket readable, wait for some
+        // resources to be released instead of spinning.
+        if (!acceptChannel_.isReading())
+            return;
+        acceptChannel_.disableReading();
+        resumeTimerId_ = loop_->runAfter(xAcceptPauseSeconds, [this]() {
+            resumeTimerId_ = InvalidTimerId;
+            acceptChannel_.enableReading();
+        });
+    }
+} // namespace xiao
@@ -0,0 +1,121 @@
+/**
+ * @file Acceptor.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/EventLoop.h>
+#include <xiao/net/InetAddress.h>
+#include <xiao/net/Channel.h>
+#include <xiao/net/callbacks.h>
+#include <xiao/utils/NonCopyable.h>
+#include "Socket.h"
+#include <functional>
+
+namespace xiao
+{
+    using NewConnectionCallback = std::function<void(int fd, const InetAddress &)>;
+
+    /**
+     * @brief This class owns a listening socket and accepts the connections
+     * in its event loop.
+     *
+     */
+    class Acceptor : NonCopyable
+    {
+    public:
+        Acceptor(EventLoop *loop,
+                 const InetAddress &addr,
+                 bool reUseAddr = true,
+                 bool reUsePort = true);
+
+        /**
+         * @brief Construct an acceptor owning a socket which is already bound,
+         * e.g. inherited from another process. The socket is closed with the
+         * acceptor.
+         *
+         * @param loop
+         * @param listenFd The bound (and possibly listening) socket.
+         */
+        Acceptor(EventLoop *loop, int listenFd);
+        ~Acceptor();
+
+        /**
+         * @brief The address the socket is bound to, with the port chosen by
+         * the system if the port of the address given is 0.
+         *
+         * @return const InetAddress&
+         */
+        const InetAddress &addr() const
+        {
+            return addr_;
+        }
+        void setNewConnectionCallback(const NewConnectionCallback &cb)
+        {
+            newConnectionCallback_ = cb;
+        };
+
+        /**
+         * @brief Listen on the socket and accept the connections in the loop.
+         * @note It can be called in any thread, the sockets of a SO_REUSEPORT
+         * group join the group in the order they start listening.
+         */
+        void listen();
+        int fd()
+        {
+            return sock_.fd();
+        }
+        EventLoop *getLoop() const
+        {
+            return loop_;
+        }
+        void setBeforeListenSockOptCallback(SockOptCallback cb)
+        {
+            beforeListenSetSockOptCallback_ = std::move(cb);
+        }
+        void setAfterAcceptSockOptCallback(SockOptCallback cb)
+        {
+            afterAcceptSetSockOptCallback_ = std::move(cb);
+        }
+
+        /**
+         * @brief Set the maximum number of connections accepted in one
+         * readiness event of the listening socket.
+         *
+         * @param batch
+         */
+        void setAcceptBatch(size_t batch)
+        {
+            acceptBatch_ = batch > 0 ? batch : 1;
+        }
+
+    protected:
+        void readCallback();
+        // Return false to stop accepting until the socket is readable again,
+        // accepting is paused if the error persists.
+        bool handleAcceptError(int err);
+        void pauseAccepting();
+
+        Socket sock_;
+        InetAddress addr_;
+        EventLoop *loop_;
+        NewConnectionCallback newConnectionCallback_;
+        Channel acceptChannel_;
+        bool listening_{false};
+        size_t acceptBatch_;
+#ifndef _WIN32
+        // Closed to accept and drop a connection when the fds run out, so
+        // the pending connection doesn't keep the socket readable.
+        int idleFd_;
+#endif
+        TimerId resumeTimerId_{InvalidTimerId};
+        SockOptCallback beforeListenSetSockOptCallback_;
+        SockOptCallback afterAcceptSetSockOptCallback_;
+    };
+} // namespace xiao
@@ -0,0 +1,61 @@
+/**
+ * @file AsyncStreamBufferNode.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "BufferNode.h"
+#include <xiao/utils/MsgBuffer.h>
+
+namespace xiao
+{
+    class AsyncStreamBufferNode : public BufferNode
+    {
+    public:
+        AsyncStreamBufferNode() = default;
+
+        bool isStream() const override
+        {
+            return true;
+        }
+        bool isAsync() const override
+        {
+            return true;
+        }
+        bool available() const override
+        {
+            return buffer_.readableBytes() > 0 || isDone_;
+        }
+        void getData(const char *&data, size_t &len) override
+        {
+            data = buffer_.peek();
+            len = buffer_.readableBytes();
+        }
+        void retrieve(size_t len) override
+        {
+            buffer_.retrieve(len);
+        }
+        long long remainingBytes() const override
+        {
+            // The producer may append more data until it closes the stream.
+            return static_cast<long long>(buffer_.readableBytes()) + (isDone_ ? 0 : 1);
+        }
+        void append(const char *data, size_t len) override
+        {
+            buffer_.append(data, len);
+        }
+
+    private:
+        MsgBuffer buffer_;
+    };
+
+    BufferNodePtr BufferNode::newAsyncStreamBufferNode()
+    {
+        return std::make_shared<AsyncStreamBufferNode>();
+    }
+} // namespace xiao
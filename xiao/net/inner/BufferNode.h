@@ -0,0 +1,199 @@
+/**
+ * @file BufferNode.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/utils/Logger.h>
+#include <xiao/utils/MsgBuffer.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace xiao
+{
+    class BufferNode;
+    using BufferNodePtr = std::shared_ptr<BufferNode>;
+    using StreamCallback = std::function<std::size_t(char *, std::size_t)>;
+
+    /**
+     * @brief This class represents a node of the send chain of a connection.
+     * The chain is flushed with one writev() over the data the nodes expose,
+     * and a partial write only moves the offsets of the nodes.
+     *
+     * A node exposes its data in chunks: getData() returns the next
+     * contiguous chunk, retrieve() consumes it, partly or fully.
+     * remainingBytes() is larger than the current chunk when more data
+     * follows it, so the data of the next nodes can't be sent along.
+     */
+    class BufferNode : public NonCopyable
+    {
+    public:
+        virtual ~BufferNode() = default;
+
+        virtual bool isMemory() const
+        {
+            return false;
+        }
+        /**
+         * @brief Return true if the node sends a buffer it doesn't own, the
+         * buffer is not modified until the node is destroyed.
+         *
+         * @return true
+         * @return false
+         */
+        virtual bool isShared() const
+        {
+            return false;
+        }
+        virtual bool isFile() const
+        {
+            return false;
+        }
+        virtual bool isStream() const
+        {
+            return false;
+        }
+        virtual bool isAsync() const
+        {
+            return false;
+        }
+
+        /**
+         * @brief Get the next chunk of data, len is 0 when no data is ready.
+         *
+         * @param data
+         * @param len
+         */
+        virtual void getData(const char *&data, size_t &len) = 0;
+
+        /**
+         * @brief Append data to the node. Only the memory nodes and the async
+         * stream nodes support it.
+         *
+         */
+        virtual void append(const char *, size_t)
+        {
+            LOG_FATAL << "Not a memory buffer node";
+        }
+
+        /**
+         * @brief Consume len bytes of the current chunk.
+         *
+         * @param len
+         */
+        virtual void retrieve(size_t len) = 0;
+
+        /**
+         * @brief Return the number of bytes left to send. For the streams whose
+         * length is unknown, it is larger than the buffered bytes until the
+         * stream is done. 0 means the node can be removed from the chain.
+         *
+         * @return long long
+         */
+        virtual long long remainingBytes() const = 0;
+
+        /**
+         * @brief Return the file descriptor of a file node.
+         *
+         * @return int
+         */
+        virtual int getFd() const
+        {
+            LOG_FATAL << "Not a file buffer node";
+            return -1;
+        }
+
+        /**
+         * @brief Send the data of a file node to the socket. The data goes
+         * from the page cache to the socket with sendfile() or splice() where
+         * the system supports them, and is read to the user space otherwise.
+         * If the file is truncated or can't be read, the rest of it is dropped
+         * and remainingBytes() falls by more than the bytes sent.
+         *
+         * @param sockfd
+         * @return ssize_t The number of bytes sent, or -1 with errno set.
+         */
+        virtual ssize_t sendTo(int)
+        {
+            LOG_FATAL << "Not a file buffer node";
+            return -1;
+        }
+
+        /**
+         * @brief Return the file descriptors to pass with the first byte of
+         * the node (SCM_RIGHTS), empty once they are sent.
+         *
+         * @return const std::vector<int>&
+         */
+        virtual const std::vector<int> &getFds() const
+        {
+            static const std::vector<int> none;
+            return none;
+        }
+
+        /**
+         * @brief Called when the file descriptors are sent, the node closes
+         * its copies.
+         *
+         */
+        virtual void fdsSent()
+        {
+        }
+
+        /**
+         * @brief Return false when the node has no data to send for now, e.g.
+         * an async stream waiting for its producer.
+         *
+         * @return true
+         * @return false
+         */
+        virtual bool available() const
+        {
+            return true;
+        }
+
+        /**
+         * @brief Mark the end of a stream.
+         *
+         */
+        void done()
+        {
+            isDone_ = true;
+        }
+
+        static BufferNodePtr newMemBufferNode();
+        /**
+         * @brief Create a node sending data owned by someone else without
+         * copying it, holder keeps the data alive until it is sent.
+         *
+         */
+        static BufferNodePtr newSharedBufferNode(std::shared_ptr<const void> holder,
+                                                 const char *data,
+                                                 size_t len);
+        /**
+         * @brief Create a node sending a copy of data with file descriptors,
+         * the node owns the fds and closes them.
+         *
+         */
+        static BufferNodePtr newFdsBufferNode(const char *data,
+                                              size_t len,
+                                              std::vector<int> &&fds);
+        static BufferNodePtr newStreamBufferNode(StreamCallback &&cb);
+        static BufferNodePtr newFileBufferNode(const char *fileName,
+                                               long long offset,
+                                               long long length);
+        static BufferNodePtr newAsyncStreamBufferNode();
+
+    protected:
+        bool isDone_{false};
+    };
+} // namespace xiao
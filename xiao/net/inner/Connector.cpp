@@ -0,0 +1,304 @@
+/**
+ * @file Connector.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "Connector.h"
+#include "Socket.h"
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+namespace xiao
+{
+    static const int xInitRetryDelayMs = 500;
+    static const int xMaxRetryDelayMs = 30 * 1000;
+    // The Connection Attempt Delay recommended by RFC 8305.
+    static const double xDefaultAttemptDelay = 0.25;
+
+    static void closeSocket(int sockfd)
+    {
+#ifndef _WIN32
+        ::close(sockfd);
+#else
+        closesocket(sockfd);
+#endif
+    }
+
+    // Alternate the families, starting with the family of the first address
+    // and keeping the order of the addresses of a family.
+    static std::vector<InetAddress> interleaveFamilies(const std::vector<InetAddress> &addrs)
+    {
+        std::vector<InetAddress> first, second;
+        for (auto &addr : addrs)
+        {
+            if (addr.family() == addrs[0].family())
+                first.push_back(addr);
+            else
+                second.push_back(addr);
+        }
+        std::vector<InetAddress> result;
+        result.reserve(addrs.size());
+        for (size_t i = 0; i < first.size() || i < second.size(); ++i)
+        {
+            if (i < first.size())
+                result.push_back(first[i]);
+            if (i < second.size())
+                result.push_back(second[i]);
+        }
+        return result;
+    }
+
+    Connector::Connector(EventLoop *loop, const InetAddress &addr, bool retry)
+        : Connector(loop, std::vector<InetAddress>{addr}, retry)
+    {
+    }
+
+    Connector::Connector(EventLoop *loop,
+                         const std::vector<InetAddress> &addrs,
+                         bool retry)
+        : loop_(loop),
+          addrs_(interleaveFamilies(addrs)),
+          attemptDelay_(xDefaultAttemptDelay),
+          retryInterval_(xInitRetryDelayMs),
+          retry_(retry)
+    {
+        assert(!addrs_.empty());
+    }
+
+    Connector::~Connector()
+    {
+        // Destroyed while connecting, without stop(), in the loop thread.
+        closeAttempts();
+    }
+
+    void Connector::start()
+    {
+        connect_ = true;
+        auto thisPtr = shared_from_this();
+        loop_->runInLoop([thisPtr]() { thisPtr->startInLoop(); });
+    }
+
+    void Connector::restart()
+    {
+        loop_->assertInLoopThread();
+        status_ = Status::Disconnected;
+        retryInterval_ = xInitRetryDelayMs;
+        connect_ = true;
+        startInLoop();
+    }
+
+    void Connector::stop()
+    {
+        connect_ = false;
+        auto thisPtr = shared_from_this();
+        loop_->runInLoop([thisPtr]() {
+            if (thisPtr->retryTimerId_ != InvalidTimerId)
+            {
+                thisPtr->loop_->invalidateTimer(thisPtr->retryTimerId_);
+                thisPtr->retryTimerId_ = InvalidTimerId;
+            }
+            if (thisPtr->status_ == Status::Connecting)
+            {
+                thisPtr->status_ = Status::Disconnected;
+                thisPtr->closeAttempts();
+            }
+        });
+    }
+
+    void Connector::startInLoop()
+    {
+        loop_->assertInLoopThread();
+        retryTimerId_ = InvalidTimerId;
+        assert(status_ == Status::Disconnected);
+        if (connect_)
+            connect();
+    }
+
+    void Connector::connect()
+    {
+        status_ = Status::Connecting;
+        nextIndex_ = 0;
+        startNextAttempt();
+    }
+
+    void Connector::startNextAttempt()
+    {
+        cancelAttemptTimer();
+        while (nextIndex_ < addrs_.size())
+        {
+            size_t index = nextIndex_++;
+            const auto &addr = addrs_[index];
+            int sockfd = Socket::createNonblockingSocketOrDie(addr.family());
+            if (sockOptCallback_)
+                sockOptCallback_(sockfd);
+            int ret = Socket::connect(sockfd, addr);
+            int savedErrno = (ret == 0) ? 0 : errno;
+            if (savedErrno != 0 && savedErrno != EINPROGRESS &&
+                savedErrno != EINTR && savedErrno != EISCONN)
+            {
+                // Failed at once, e.g. no route for the family, try the next
+                // address without waiting.
+                LOG_TRACE << "connect to " << addr.toIpPort()
+                          << " failed: " << strerror(savedErrno);
+                closeSocket(sockfd);
+                continue;
+            }
+            uint64_t id = nextAttemptId_++;
+            std::shared_ptr<Channel> channelPtr(new Channel(loop_, sockfd));
+            std::weak_ptr<Connector> weakPtr = shared_from_this();
+            channelPtr->setWriteCallback([weakPtr, id]() {
+                auto thisPtr = weakPtr.lock();
+                if (thisPtr)
+                    thisPtr->handleWrite(id);
+            });
+            channelPtr->setErrorCallback([weakPtr, id]() {
+                auto thisPtr = weakPtr.lock();
+                if (thisPtr)
+                    thisPtr->handleError(id);
+            });
+            channelPtr->setCloseCallback([weakPtr, id]() {
+                auto thisPtr = weakPtr.lock();
+                if (thisPtr)
+                    thisPtr->handleError(id);
+            });
+            channelPtr->enableWriting();
+            attempts_.push_back(Attempt{id, index, std::move(channelPtr)});
+            if (nextIndex_ < addrs_.size())
+            {
+                // Race the next address if this one is slow.
+                attemptTimerId_ = loop_->runAfter(attemptDelay_, [weakPtr]() {
+                    auto thisPtr = weakPtr.lock();
+                    if (!thisPtr)
+                        return;
+                    thisPtr->attemptTimerId_ = InvalidTimerId;
+                    thisPtr->startNextAttempt();
+                });
+            }
+            return;
+        }
+        if (attempts_.empty())
+            retry();
+    }
+
+    int Connector::removeAttempt(std::vector<Attempt>::iterator iter)
+    {
+        auto channelPtr = std::move(iter->channelPtr_);
+        attempts_.erase(iter);
+        channelPtr->disableAll();
+        channelPtr->remove();
+        // The channel can't be destroyed in its own event handler.
+        loop_->queueInLoop([channelPtr]() {});
+        return channelPtr->fd();
+    }
+
+    void Connector::closeAttempts()
+    {
+        cancelAttemptTimer();
+        while (!attempts_.empty())
+        {
+            closeSocket(removeAttempt(attempts_.begin()));
+        }
+    }
+
+    void Connector::cancelAttemptTimer()
+    {
+        if (attemptTimerId_ != InvalidTimerId)
+        {
+            loop_->invalidateTimer(attemptTimerId_);
+            attemptTimerId_ = InvalidTimerId;
+        }
+    }
+
+    void Connector::handleWrite(uint64_t id)
+    {
+        auto iter = std::find_if(attempts_.begin(),
+                                 attempts_.end(),
+                                 [id](const Attempt &attempt) {
+                                     return attempt.id_ == id;
+                                 });
+        // Closed by another attempt in the same iteration of the loop.
+        if (iter == attempts_.end() || status_ != Status::Connecting)
+            return;
+        size_t index = iter->index_;
+        int sockfd = removeAttempt(iter);
+        int err = Socket::getSocketError(sockfd);
+        if (err)
+        {
+            LOG_WARN << "Connector::handleWrite - SO_ERROR = " << err << " "
+                     << strerror(err);
+            closeSocket(sockfd);
+            onAttemptFailed();
+            return;
+        }
+        if (Socket::isSelfConnect(sockfd))
+        {
+            LOG_WARN << "Connector::handleWrite - Self connect";
+            closeSocket(sockfd);
+            onAttemptFailed();
+            return;
+        }
+        // The first one wins.
+        closeAttempts();
+        status_ = Status::Connected;
+        connectedIndex_ = index;
+        if (connect_ && newConnectionCallback_)
+            newConnectionCallback_(sockfd);
+        else
+            closeSocket(sockfd);
+    }
+
+    void Connector::handleError(uint64_t id)
+    {
+        auto iter = std::find_if(attempts_.begin(),
+                                 attempts_.end(),
+                                 [id](const Attempt &attempt) {
+                                     return attempt.id_ == id;
+                                 });
+        if (iter == attempts_.end() || status_ != Status::Connecting)
+            return;
+        int sockfd = removeAttempt(iter);
+        int err = Socket::getSocketError(sockfd);
+        LOG_TRACE << "SO_ERROR = " << err << " " << strerror(err);
+        closeSocket(sockfd);
+        onAttemptFailed();
+    }
+
+    void Connector::onAttemptFailed()
+    {
+        // A failure starts the next attempt at once rather than after the
+        // attempt delay.
+        if (nextIndex_ < addrs_.size())
+        {
+            startNextAttempt();
+            return;
+        }
+        if (attempts_.empty())
+            retry();
+    }
+
+    void Connector::retry()
+    {
+        status_ = Status::Disconnected;
+        if (!retry_ || !connect_)
+        {
+            if (connect_ && errorCallback_)
+                errorCallback_();
+            return;
+        }
+        LOG_INFO << "Connector::retry - Retry connecting to "
+                 << addrs_[0].toIpPort() << " in " << retryInterval_
+                 << " milliseconds";
+        auto thisPtr = shared_from_this();
+        retryTimerId_ = loop_->runAfter(retryInterval_ / 1000.0,
+                                        [thisPtr]() { thisPtr->startInLoop(); });
+        retryInterval_ = (std::min)(retryInterval_ * 2, xMaxRetryDelayMs);
+    }
+} // namespace xiao
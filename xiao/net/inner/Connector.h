@@ -0,0 +1,166 @@
+/**
+ * @file Connector.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/EventLoop.h>
+#include <xiao/net/InetAddress.h>
+#include <xiao/net/Channel.h>
+#include <xiao/net/callbacks.h>
+#include <xiao/utils/NonCopyable.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+namespace xiao
+{
+    /**
+     * @brief This class connects a non-blocking socket to a server in its
+     * event loop, retrying with a backoff if asked to.
+     *
+     * When the server has several addresses, they are raced in the way of
+     * RFC 8305: the families are interleaved, a new attempt starts when the
+     * previous one fails or after the attempt delay, the first attempt to
+     * succeed wins and the others are closed.
+     *
+     * @note It must be owned by a shared_ptr.
+     */
+    class Connector : public NonCopyable,
+                      public std::enable_shared_from_this<Connector>
+    {
+    public:
+        using NewConnectionCallback = std::function<void(int sockfd)>;
+        using ConnectionErrorCallback = std::function<void()>;
+
+        Connector(EventLoop *loop, const InetAddress &addr, bool retry = true);
+        Connector(EventLoop *loop,
+                  const std::vector<InetAddress> &addrs,
+                  bool retry = true);
+        ~Connector();
+
+        void setNewConnectionCallback(const NewConnectionCallback &cb)
+        {
+            newConnectionCallback_ = cb;
+        }
+        void setErrorCallback(const ConnectionErrorCallback &cb)
+        {
+            errorCallback_ = cb;
+        }
+        void setSockOptCallback(const SockOptCallback &cb)
+        {
+            sockOptCallback_ = cb;
+        }
+
+        /**
+         * @brief Retry with a backoff when connecting fails, instead of
+         * calling the error callback. It must be called before start().
+         *
+         */
+        void setRetry(bool retry)
+        {
+            retry_ = retry;
+        }
+
+        /**
+         * @brief Set the time after which the next address is tried while
+         * the previous attempts are pending, 250ms by default. It must be
+         * called before start().
+         *
+         * @param seconds
+         */
+        void setAttemptDelay(double seconds)
+        {
+            attemptDelay_ = seconds;
+        }
+
+        /**
+         * @brief The address connected to, or the first address before a
+         * connection is made.
+         *
+         * @return const InetAddress&
+         */
+        const InetAddress &serverAddress() const
+        {
+            return addrs_[connectedIndex_];
+        }
+
+        /**
+         * @brief Start connecting, it can be called in any thread.
+         *
+         */
+        void start();
+
+        /**
+         * @brief Connect again after the connection is lost, in the loop
+         * thread.
+         *
+         */
+        void restart();
+
+        /**
+         * @brief Stop connecting, it can be called in any thread.
+         *
+         */
+        void stop();
+
+    private:
+        enum class Status
+        {
+            Disconnected,
+            Connecting,
+            Connected
+        };
+
+        // A connect() in progress on one of the addresses.
+        struct Attempt
+        {
+            uint64_t id_;
+            size_t index_;
+            std::shared_ptr<Channel> channelPtr_;
+        };
+
+        void startInLoop();
+        // Start a new round over the addresses.
+        void connect();
+        // Start attempts until one is in progress or the addresses run out.
+        void startNextAttempt();
+        void handleWrite(uint64_t id);
+        void handleError(uint64_t id);
+        void onAttemptFailed();
+        // Remove the channel of an attempt and return its socket.
+        int removeAttempt(std::vector<Attempt>::iterator iter);
+        void closeAttempts();
+        void cancelAttemptTimer();
+        // All the attempts of the round failed.
+        void retry();
+
+        EventLoop *loop_;
+        std::vector<InetAddress> addrs_;
+        std::atomic<bool> connect_{false};
+        Status status_{Status::Disconnected};
+        std::vector<Attempt> attempts_;
+        uint64_t nextAttemptId_{0};
+        size_t nextIndex_{0};
+        size_t connectedIndex_{0};
+        double attemptDelay_;
+        TimerId attemptTimerId_{InvalidTimerId};
+        int retryInterval_;
+        bool retry_;
+        TimerId retryTimerId_{InvalidTimerId};
+
+        NewConnectionCallback newConnectionCallback_;
+        ConnectionErrorCallback errorCallback_;
+        SockOptCallback sockOptCallback_;
+    };
+
+    using ConnectorPtr = std::shared_ptr<Connector>;
+} // namespace xiao
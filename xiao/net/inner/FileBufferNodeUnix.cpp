@@ -0,0 +1,265 @@
+/**
+ * @file FileBufferNodeUnix.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "BufferNode.h"
+#include <xiao/utils/MsgBuffer.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+namespace xiao
+{
+    static const size_t xMaxFileChunk = 64 * 1024;
+#ifdef __linux__
+    // sendfile() transfers at most 0x7ffff000 bytes in one call.
+    static const long long xMaxSendfileChunk = 0x7ffff000;
+    // The default capacity of a pipe.
+    static const size_t xMaxSpliceChunk = 64 * 1024;
+#endif
+
+    class FileBufferNode : public BufferNode
+    {
+    public:
+        FileBufferNode(const char *fileName, long long offset, long long length)
+        {
+            sendFd_ = ::open(fileName, O_RDONLY | O_CLOEXEC);
+            if (sendFd_ < 0)
+            {
+                LOG_SYSERR << fileName << " open error";
+                isDone_ = true;
+                return;
+            }
+            struct stat filestat;
+            if (::fstat(sendFd_, &filestat) < 0)
+            {
+                LOG_SYSERR << fileName << " stat error";
+                ::close(sendFd_);
+                sendFd_ = -1;
+                isDone_ = true;
+                return;
+            }
+            if (length == 0)
+            {
+                if (offset >= filestat.st_size)
+                {
+                    LOG_ERROR << "The file size is " << filestat.st_size
+                              << " bytes, but the offset is " << offset
+                              << " bytes and the length is " << length << " bytes";
+                    ::close(sendFd_);
+                    sendFd_ = -1;
+                    isDone_ = true;
+                    return;
+                }
+                fileBytesToSend_ = filestat.st_size - offset;
+            }
+            else
+            {
+                if (length + offset > filestat.st_size)
+                {
+                    LOG_ERROR << "The file size is " << filestat.st_size
+                              << " bytes, but the offset is " << offset
+                              << " bytes and the length is " << length << " bytes";
+                    ::close(sendFd_);
+                    sendFd_ = -1;
+                    isDone_ = true;
+                    return;
+                }
+                fileBytesToSend_ = length;
+            }
+            offset_ = offset;
+        }
+        ~FileBufferNode() override
+        {
+            if (sendFd_ >= 0)
+                ::close(sendFd_);
+#ifdef __linux__
+            if (pipeFds_[0] >= 0)
+            {
+                ::close(pipeFds_[0]);
+                ::close(pipeFds_[1]);
+            }
+#endif
+        }
+
+        bool isFile() const override
+        {
+            return true;
+        }
+        void getData(const char *&data, size_t &len) override
+        {
+            // offset_ is the position of the first buffered byte, the next
+            // chunk is read once the buffered one is sent.
+            if (buffer_.readableBytes() == 0 && fileBytesToSend_ > 0 && sendFd_ >= 0)
+            {
+                size_t toRead = static_cast<size_t>(
+                    (std::min)(static_cast<long long>(xMaxFileChunk), fileBytesToSend_));
+                buffer_.ensureWritableBytes(toRead);
+                auto n = ::pread(sendFd_, buffer_.beginWrite(), toRead, offset_);
+                if (n > 0)
+                {
+                    buffer_.hasWritten(static_cast<size_t>(n));
+                }
+                else
+                {
+                    LOG_SYSERR << "FileBufferNode::getData()";
+                    fileBytesToSend_ = 0;
+                }
+            }
+            data = buffer_.peek();
+            len = buffer_.readableBytes();
+        }
+        void retrieve(size_t len) override
+        {
+            assert(len <= buffer_.readableBytes());
+            buffer_.retrieve(len);
+            offset_ += static_cast<long long>(len);
+            fileBytesToSend_ -= static_cast<long long>(len);
+        }
+        long long remainingBytes() const override
+        {
+            return fileBytesToSend_;
+        }
+        int getFd() const override
+        {
+            return sendFd_;
+        }
+        ssize_t sendTo(int sockfd) override
+        {
+#ifdef __linux__
+            if (mode_ == SendMode::Sendfile)
+            {
+                off_t offset = static_cast<off_t>(offset_);
+                auto n = ::sendfile(sockfd,
+                                    sendFd_,
+                                    &offset,
+                                    static_cast<size_t>((std::min)(
+                                        xMaxSendfileChunk, fileBytesToSend_)));
+                if (n > 0)
+                {
+                    offset_ += n;
+                    fileBytesToSend_ -= n;
+                    return n;
+                }
+                if (n == 0)
+                {
+                    fileTruncated();
+                    return 0;
+                }
+                if (errno != EINVAL && errno != ENOSYS)
+                    return -1;
+                // The file doesn't support sendfile().
+                mode_ = SendMode::Splice;
+            }
+            if (mode_ == SendMode::Splice)
+            {
+                auto n = spliceTo(sockfd);
+                if (n >= 0 || errno != EINVAL || pipeBytes_ > 0)
+                    return n;
+                mode_ = SendMode::Copy;
+            }
+#endif
+            return writeTo(sockfd);
+        }
+
+    private:
+        // Read a chunk to the user space and write it to the socket.
+        ssize_t writeTo(int sockfd)
+        {
+            const char *data;
+            size_t len;
+            getData(data, len);
+            if (len == 0)
+                return 0;
+            auto n = ::write(sockfd, data, len);
+            if (n > 0)
+                retrieve(static_cast<size_t>(n));
+            return n;
+        }
+        void fileTruncated()
+        {
+            LOG_ERROR << "The file is truncated, " << fileBytesToSend_
+                      << " bytes are not sent";
+            fileBytesToSend_ = 0;
+        }
+#ifdef __linux__
+        // Move a chunk of the file to the pipe, then from the pipe to the
+        // socket. The bytes left in the pipe by a partial write are sent
+        // first on the next call.
+        ssize_t spliceTo(int sockfd)
+        {
+            if (pipeFds_[0] < 0 && ::pipe2(pipeFds_, O_NONBLOCK | O_CLOEXEC) < 0)
+            {
+                LOG_SYSERR << "FileBufferNode::spliceTo() pipe2";
+                return -1;
+            }
+            if (pipeBytes_ == 0)
+            {
+                loff_t offset = static_cast<loff_t>(offset_);
+                auto n = ::splice(sendFd_,
+                                  &offset,
+                                  pipeFds_[1],
+                                  nullptr,
+                                  static_cast<size_t>((std::min)(
+                                      static_cast<long long>(xMaxSpliceChunk),
+                                      fileBytesToSend_)),
+                                  SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (n == 0)
+                {
+                    fileTruncated();
+                    return 0;
+                }
+                if (n < 0)
+                    return -1;
+                offset_ += n;
+                pipeBytes_ = static_cast<size_t>(n);
+            }
+            auto n = ::splice(pipeFds_[0],
+                              nullptr,
+                              sockfd,
+                              nullptr,
+                              pipeBytes_,
+                              SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0)
+            {
+                pipeBytes_ -= static_cast<size_t>(n);
+                fileBytesToSend_ -= n;
+            }
+            return n;
+        }
+
+        enum class SendMode
+        {
+            Sendfile,
+            Splice,
+            Copy
+        };
+        SendMode mode_{SendMode::Sendfile};
+        int pipeFds_[2]{-1, -1};
+        // The bytes read from the file to the pipe and not sent yet.
+        size_t pipeBytes_{0};
+#endif
+        int sendFd_{-1};
+        long long offset_{0};
+        long long fileBytesToSend_{0};
+        MsgBuffer buffer_;
+    };
+
+    BufferNodePtr BufferNode::newFileBufferNode(const char *fileName,
+                                                long long offset,
+                                                long long length)
+    {
+        return std::make_shared<FileBufferNode>(fileName, offset, length);
+    }
+} // namespace xiao
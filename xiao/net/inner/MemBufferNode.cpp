@@ -0,0 +1,151 @@
+/**
+ * @file MemBufferNode.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "BufferNode.h"
+#include <xiao/utils/MsgBuffer.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace xiao
+{
+    class MemBufferNode : public BufferNode
+    {
+    public:
+        MemBufferNode() = default;
+
+        bool isMemory() const override
+        {
+            return true;
+        }
+
+        void getData(const char *&data, size_t &len) override
+        {
+            data = buffer_.peek();
+            len = buffer_.readableBytes();
+        }
+        void retrieve(size_t len) override
+        {
+            buffer_.retrieve(len);
+        }
+        long long remainingBytes() const override
+        {
+            return static_cast<long long>(buffer_.readableBytes());
+        }
+        void append(const char *data, size_t len) override
+        {
+            buffer_.append(data, len);
+        }
+
+    private:
+        MsgBuffer buffer_;
+    };
+
+    class SharedBufferNode : public BufferNode
+    {
+    public:
+        SharedBufferNode(std::shared_ptr<const void> holder,
+                         const char *data,
+                         size_t len)
+            : holder_(std::move(holder)), data_(data), len_(len)
+        {
+        }
+
+        bool isShared() const override
+        {
+            return true;
+        }
+
+        void getData(const char *&data, size_t &len) override
+        {
+            data = data_;
+            len = len_;
+        }
+        void retrieve(size_t len) override
+        {
+            assert(len <= len_);
+            data_ += len;
+            len_ -= len;
+        }
+        long long remainingBytes() const override
+        {
+            return static_cast<long long>(len_);
+        }
+
+    private:
+        std::shared_ptr<const void> holder_;
+        const char *data_;
+        size_t len_;
+    };
+
+    class FdsBufferNode : public BufferNode
+    {
+    public:
+        FdsBufferNode(const char *data, size_t len, std::vector<int> &&fds)
+            : fds_(std::move(fds))
+        {
+            buffer_.append(data, len);
+        }
+        ~FdsBufferNode() override
+        {
+            fdsSent();
+        }
+
+        void getData(const char *&data, size_t &len) override
+        {
+            data = buffer_.peek();
+            len = buffer_.readableBytes();
+        }
+        void retrieve(size_t len) override
+        {
+            buffer_.retrieve(len);
+        }
+        long long remainingBytes() const override
+        {
+            return static_cast<long long>(buffer_.readableBytes());
+        }
+        const std::vector<int> &getFds() const override
+        {
+            return fds_;
+        }
+        void fdsSent() override
+        {
+#ifndef _WIN32
+            for (auto fd : fds_)
+                ::close(fd);
+#endif
+            fds_.clear();
+        }
+
+    private:
+        MsgBuffer buffer_;
+        std::vector<int> fds_;
+    };
+
+    BufferNodePtr BufferNode::newMemBufferNode()
+    {
+        return std::make_shared<MemBufferNode>();
+    }
+
+    BufferNodePtr BufferNode::newSharedBufferNode(std::shared_ptr<const void> holder,
+                                                  const char *data,
+                                                  size_t len)
+    {
+        return std::make_shared<SharedBufferNode>(std::move(holder), data, len);
+    }
+
+    BufferNodePtr BufferNode::newFdsBufferNode(const char *data,
+                                               size_t len,
+                                               std::vector<int> &&fds)
+    {
+        return std::make_shared<FdsBufferNode>(data, len, std::move(fds));
+    }
+} // namespace xiao
@@ -0,0 +1,248 @@
+/**
+ * @file NormalResolver.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "NormalResolver.h"
+#include <xiao/utils/Logger.h>
+#include <algorithm>
+#include <ctype.h>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+namespace xiao
+{
+    // The names which can't be resolved are cached for this time at most, in
+    // seconds, so a name which appears later is found soon.
+    static const size_t xNegativeTimeout = 5;
+    // The expired entries of a shard are swept when it grows beyond this.
+    static const size_t xMaxShardEntries = 1024;
+    static const size_t xResolverThreads = 8;
+
+    static std::string toLower(std::string name)
+    {
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) {
+            return static_cast<char>(::tolower(c));
+        });
+        return name;
+    }
+
+    std::shared_ptr<Resolver> Resolver::newResolver(EventLoop *loop,
+                                                    size_t timeout,
+                                                    const std::string &hostsFile)
+    {
+        return std::make_shared<NormalResolver>(loop, timeout, hostsFile);
+    }
+
+    NormalResolver::NormalResolver(EventLoop *loop,
+                                   size_t timeout,
+                                   const std::string &hostsFile)
+        : loop_(loop),
+          timeout_(std::chrono::seconds(timeout)),
+          negativeTimeout_(std::chrono::seconds((std::min)(timeout, xNegativeTimeout))),
+          hostsFile_(hostsFile)
+    {
+    }
+
+    ConcurrentTaskQueue &NormalResolver::taskQueue()
+    {
+        static ConcurrentTaskQueue queue(xResolverThreads, "Resolver");
+        return queue;
+    }
+
+    NormalResolver::Shard &NormalResolver::shardOf(const std::string &hostname)
+    {
+        return shards_[std::hash<std::string>()(hostname) % xShardCount];
+    }
+
+    void NormalResolver::resolve(const std::string &hostname, const Callback &callback)
+    {
+        resolve(hostname,
+                ResolverResultsCallback(
+                    [callback](const std::vector<InetAddress> &addrs) {
+                        callback(addrs.empty() ? InetAddress() : addrs[0]);
+                    }));
+    }
+
+    void NormalResolver::resolve(const std::string &hostname,
+                                 const ResolverResultsCallback &callback)
+    {
+        auto name = toLower(hostname);
+        auto &shard = shardOf(name);
+        std::vector<InetAddress> addrs;
+        bool miss = false;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex_);
+            auto &entry = shard.entries_[name];
+            if (!entry.querying_ && entry.expiry_ > Clock::now())
+            {
+                // A hit, which may be a cached failure.
+                addrs = entry.addrs_;
+            }
+            else
+            {
+                entry.waiters_.push_back(callback);
+                if (entry.querying_)
+                    return;
+                entry.querying_ = true;
+                miss = true;
+            }
+        }
+        if (miss)
+        {
+            query(name);
+            return;
+        }
+        if (!loop_ || loop_->isInLoopThread())
+        {
+            callback(addrs);
+            return;
+        }
+        loop_->queueInLoop([callback, addrs]() { callback(addrs); });
+    }
+
+    void NormalResolver::query(const std::string &hostname)
+    {
+        auto thisPtr = shared_from_this();
+        taskQueue().runTaskInQueue([thisPtr, hostname]() {
+            auto addrs = thisPtr->lookup(hostname);
+            auto now = Clock::now();
+            std::vector<ResolverResultsCallback> waiters;
+            auto &shard = thisPtr->shardOf(hostname);
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex_);
+                if (shard.entries_.size() > xMaxShardEntries)
+                {
+                    for (auto iter = shard.entries_.begin(); iter != shard.entries_.end();)
+                    {
+                        if (!iter->second.querying_ && iter->second.expiry_ <= now)
+                            iter = shard.entries_.erase(iter);
+                        else
+                            ++iter;
+                    }
+                }
+                auto &entry = shard.entries_[hostname];
+                entry.addrs_ = addrs;
+                entry.expiry_ =
+                    now + (addrs.empty() ? thisPtr->negativeTimeout_ : thisPtr->timeout_);
+                entry.querying_ = false;
+                waiters.swap(entry.waiters_);
+            }
+            thisPtr->deliver(std::move(waiters), std::move(addrs));
+        });
+    }
+
+    void NormalResolver::deliver(std::vector<ResolverResultsCallback> callbacks,
+                                 std::vector<InetAddress> addrs)
+    {
+        if (!loop_)
+        {
+            for (auto &callback : callbacks)
+                callback(addrs);
+            return;
+        }
+        // One task for all the lookups which shared the query.
+        auto callbacksPtr =
+            std::make_shared<std::vector<ResolverResultsCallback>>(std::move(callbacks));
+        auto addrsPtr = std::make_shared<std::vector<InetAddress>>(std::move(addrs));
+        loop_->queueInLoop([callbacksPtr, addrsPtr]() {
+            for (auto &callback : *callbacksPtr)
+                callback(*addrsPtr);
+        });
+    }
+
+    std::vector<InetAddress> NormalResolver::lookup(const std::string &hostname) const
+    {
+        std::vector<InetAddress> addrs;
+        if (!hostsFile_.empty() && lookupHostsFile(hostname, addrs))
+            return addrs;
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo *res = nullptr;
+        int ret = ::getaddrinfo(hostname.c_str(), nullptr, &hints, &res);
+        if (ret != 0 || res == nullptr)
+        {
+            LOG_WARN << "Failed to resolve " << hostname << ": " << gai_strerror(ret);
+            return addrs;
+        }
+        for (auto p = res; p != nullptr; p = p->ai_next)
+        {
+            if (p->ai_family == AF_INET)
+                addrs.emplace_back(*reinterpret_cast<struct sockaddr_in *>(p->ai_addr));
+            else if (p->ai_family == AF_INET6)
+                addrs.emplace_back(*reinterpret_cast<struct sockaddr_in6 *>(p->ai_addr));
+        }
+        ::freeaddrinfo(res);
+        return addrs;
+    }
+
+    // The file is read on each query, as getaddrinfo() reads /etc/hosts, so
+    // the edits are picked up when the cached entries expire.
+    bool NormalResolver::lookupHostsFile(const std::string &hostname,
+                                         std::vector<InetAddress> &addrs) const
+    {
+        std::ifstream file(hostsFile_);
+        if (!file)
+        {
+            LOG_ERROR << "Can't open the hosts file " << hostsFile_;
+            return false;
+        }
+        bool found = false;
+        bool blocked = false;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            auto comment = line.find('#');
+            if (comment != std::string::npos)
+                line.resize(comment);
+            std::istringstream fields(line);
+            std::string ip, name;
+            if (!(fields >> ip))
+                continue;
+            bool listed = false;
+            while (fields >> name)
+            {
+                if (toLower(name) == hostname)
+                    listed = true;
+            }
+            if (!listed)
+                continue;
+            found = true;
+            // The unspecified address lists a name which can't be resolved,
+            // as in the blocklists in the hosts format.
+            if (ip == "0.0.0.0" || ip == "::")
+            {
+                blocked = true;
+                continue;
+            }
+            bool ipv6 = ip.find(':') != std::string::npos;
+            InetAddress addr(ip, 0, ipv6);
+            if (addr.isUnspecified())
+            {
+                LOG_WARN << "Bad address in the hosts file " << hostsFile_ << ": " << ip;
+                continue;
+            }
+            addrs.push_back(addr);
+        }
+        if (blocked)
+            addrs.clear();
+        return found;
+    }
+} // namespace xiao
@@ -0,0 +1,78 @@
+/**
+ * @file NormalResolver.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/Resolver.h>
+#include <xiao/utils/ConcurrentTaskQueue.h>
+#include <xiao/utils/NonCopyable.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace xiao
+{
+    /**
+     * @brief This class resolves names with the blocking getaddrinfo() in a
+     * task queue shared by all the resolvers, and delivers the results in
+     * its event loop.
+     *
+     */
+    class NormalResolver : public Resolver,
+                           public NonCopyable,
+                           public std::enable_shared_from_this<NormalResolver>
+    {
+    public:
+        NormalResolver(EventLoop *loop, size_t timeout, const std::string &hostsFile);
+
+        void resolve(const std::string &hostname, const Callback &callback) override;
+        void resolve(const std::string &hostname,
+                     const ResolverResultsCallback &callback) override;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+        static const size_t xShardCount = 16;
+
+        struct Entry
+        {
+            std::vector<InetAddress> addrs_;
+            Clock::time_point expiry_;
+            // The lookups waiting for the query in flight.
+            std::vector<ResolverResultsCallback> waiters_;
+            bool querying_{false};
+        };
+        // The cache is split by the hash of the name, so the lookups of
+        // different names rarely wait for each other.
+        struct Shard
+        {
+            std::mutex mutex_;
+            std::unordered_map<std::string, Entry> entries_;
+        };
+
+        Shard &shardOf(const std::string &hostname);
+        void query(const std::string &hostname);
+        std::vector<InetAddress> lookup(const std::string &hostname) const;
+        // Return false if the hosts file doesn't list the name.
+        bool lookupHostsFile(const std::string &hostname,
+                             std::vector<InetAddress> &addrs) const;
+        void deliver(std::vector<ResolverResultsCallback> callbacks,
+                     std::vector<InetAddress> addrs);
+        static ConcurrentTaskQueue &taskQueue();
+
+        EventLoop *loop_;
+        const Clock::duration timeout_;
+        const Clock::duration negativeTimeout_;
+        const std::string hostsFile_;
+        Shard shards_[xShardCount];
+    };
+} // namespace xiao
@@ -10,9 +10,20 @@
  */
 
 #include "Poller.h"
-#ifdef __linux__
-#elif defined _WIN32
-#include "Wepoll.h"
-#elif
+#if defined __linux__ || defined _WIN32
+#include "poller/EpollPoller.h"
+#endif
+
+namespace xiao
+{
+    Poller *Poller::newPoller(EventLoop *loop)
+    {
+#if defined __linux__ || defined _WIN32
+        return new EpollPoller(loop);
 #else
-#endif
\ No newline at end of file
+        // KQueue and PollPoller are not ported yet.
+        (void)loop;
+        return nullptr;
+#endif
+    }
+} // namespace xiao
@@ -0,0 +1,119 @@
+/**
+ * @file SignalWatcher.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "SignalWatcher.h"
+#ifdef __linux__
+#include <xiao/net/EventLoop.h>
+#include <xiao/net/Channel.h>
+#include <xiao/utils/Logger.h>
+#include <errno.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+namespace xiao
+{
+    SignalWatcher::SignalWatcher(EventLoop *loop) : loop_(loop)
+    {
+        sigemptyset(&mask_);
+        signalfd_ = ::signalfd(-1, &mask_, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (signalfd_ < 0)
+        {
+            LOG_SYSERR << "signalfd";
+            return;
+        }
+        channelPtr_ = std::make_shared<Channel>(loop_, signalfd_);
+        channelPtr_->setReadCallback(std::bind(&SignalWatcher::handleRead, this));
+        channelPtr_->enableReading();
+    }
+
+    SignalWatcher::~SignalWatcher()
+    {
+        if (signalfd_ < 0)
+            return;
+        auto chlPtr = channelPtr_;
+        auto fd = signalfd_;
+        loop_->runInLoop([chlPtr, fd]()
+                         {
+            chlPtr->disableAll();
+            chlPtr->remove();
+            ::close(fd); });
+    }
+
+    void SignalWatcher::setCallback(int signo, std::function<void()> &&cb)
+    {
+        loop_->assertInLoopThread();
+        callbacks_[signo] = std::move(cb);
+        if (sigismember(&mask_, signo) == 1)
+            return;
+        sigaddset(&mask_, signo);
+        // A signal blocked in every thread stays pending for the process, where
+        // the signalfd picks it up.
+        sigset_t one;
+        sigemptyset(&one);
+        sigaddset(&one, signo);
+        if (pthread_sigmask(SIG_BLOCK, &one, nullptr) != 0)
+        {
+            LOG_SYSERR << "pthread_sigmask";
+        }
+        if (signalfd_ >= 0 && ::signalfd(signalfd_, &mask_, 0) < 0)
+        {
+            LOG_SYSERR << "signalfd";
+        }
+    }
+
+    void SignalWatcher::removeCallback(int signo)
+    {
+        loop_->assertInLoopThread();
+        if (callbacks_.erase(signo) == 0)
+            return;
+        sigdelset(&mask_, signo);
+        if (signalfd_ >= 0 && ::signalfd(signalfd_, &mask_, 0) < 0)
+        {
+            LOG_SYSERR << "signalfd";
+        }
+        sigset_t one;
+        sigemptyset(&one);
+        sigaddset(&one, signo);
+        pthread_sigmask(SIG_UNBLOCK, &one, nullptr);
+    }
+
+    void SignalWatcher::handleRead()
+    {
+        loop_->assertInLoopThread();
+        struct signalfd_siginfo infos[16];
+        while (true)
+        {
+            ssize_t n = ::read(signalfd_, infos, sizeof(infos));
+            if (n < 0)
+            {
+                if (errno != EAGAIN && errno != EINTR)
+                {
+                    LOG_SYSERR << "SignalWatcher::handleRead()";
+                }
+                break;
+            }
+            size_t count = static_cast<size_t>(n) / sizeof(infos[0]);
+            for (size_t i = 0; i < count; ++i)
+            {
+                auto iter = callbacks_.find(static_cast<int>(infos[i].ssi_signo));
+                if (iter != callbacks_.end() && iter->second)
+                {
+                    // Copy, the callback may remove itself.
+                    auto cb = iter->second;
+                    cb();
+                }
+            }
+            if (count < sizeof(infos) / sizeof(infos[0]))
+                break;
+        }
+    }
+} // namespace xiao
+#endif
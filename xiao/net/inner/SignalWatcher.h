@@ -0,0 +1,48 @@
+/**
+ * @file SignalWatcher.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#ifdef __linux__
+#include <xiao/utils/NonCopyable.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <signal.h>
+
+namespace xiao
+{
+    class EventLoop;
+    class Channel;
+
+    /**
+     * @brief This class delivers signals to an event loop through a signalfd,
+     * so the signal callbacks run in the loop thread, woken up by the same
+     * epoll_wait() as the I/O events.
+     *
+     */
+    class SignalWatcher : NonCopyable
+    {
+    public:
+        explicit SignalWatcher(EventLoop *loop);
+        ~SignalWatcher();
+        void setCallback(int signo, std::function<void()> &&cb);
+        void removeCallback(int signo);
+
+    private:
+        void handleRead();
+        EventLoop *loop_;
+        int signalfd_;
+        std::shared_ptr<Channel> channelPtr_;
+        sigset_t mask_;
+        std::map<int, std::function<void()>> callbacks_;
+    };
+} // namespace xiao
+#endif
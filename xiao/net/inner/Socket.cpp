@@ -0,0 +1,253 @@
+/**
+ * @file Socket.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "Socket.h"
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#endif
+
+namespace xiao
+{
+    bool Socket::isSelfConnect(int sockfd)
+    {
+        struct sockaddr_in6 localaddr = getLocalAddr(sockfd);
+        struct sockaddr_in6 peeraddr = getPeerAddr(sockfd);
+        if (localaddr.sin6_family == AF_INET)
+        {
+            const struct sockaddr_in *laddr4 =
+                reinterpret_cast<struct sockaddr_in *>(&localaddr);
+            const struct sockaddr_in *raddr4 =
+                reinterpret_cast<struct sockaddr_in *>(&peeraddr);
+            return laddr4->sin_port == raddr4->sin_port &&
+                   laddr4->sin_addr.s_addr == raddr4->sin_addr.s_addr;
+        }
+        else if (localaddr.sin6_family == AF_INET6)
+        {
+            return localaddr.sin6_port == peeraddr.sin6_port &&
+                   memcmp(&localaddr.sin6_addr,
+                          &peeraddr.sin6_addr,
+                          sizeof localaddr.sin6_addr) == 0;
+        }
+        return false;
+    }
+
+    void Socket::bindAddress(const InetAddress &localaddr)
+    {
+        assert(sockFd_ > 0);
+        int ret = ::bind(sockFd_, localaddr.getSockAddr(), localaddr.getSockAddrLen());
+        if (ret == 0)
+            return;
+        LOG_SYSERR << ", Bind address failed at " << localaddr.toIpPort();
+        exit(1);
+    }
+
+    void Socket::listen()
+    {
+        assert(sockFd_ > 0);
+        int ret = ::listen(sockFd_, SOMAXCONN);
+        if (ret < 0)
+        {
+            LOG_SYSERR << "listen failed";
+            exit(1);
+        }
+    }
+
+    int Socket::accept(InetAddress *peeraddr)
+    {
+        struct sockaddr_storage addr;
+        memset(&addr, 0, sizeof(addr));
+        socklen_t size = sizeof(addr);
+#ifdef __linux__
+        int connfd = ::accept4(sockFd_,
+                               (struct sockaddr *)&addr,
+                               &size,
+                               SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        int connfd =
+            static_cast<int>(::accept(sockFd_, (struct sockaddr *)&addr, &size));
+        setNonBlockAndCloseOnExec(connfd);
+#endif
+        if (connfd >= 0)
+        {
+            peeraddr->setSockAddr((struct sockaddr *)&addr, size);
+        }
+        return connfd;
+    }
+
+    void Socket::closeWrite()
+    {
+#ifndef _WIN32
+        if (::shutdown(sockFd_, SHUT_WR) < 0)
+#else
+        if (::shutdown(sockFd_, SD_SEND) < 0)
+#endif
+        {
+            LOG_SYSERR << "sockets::shutdownWrite";
+        }
+    }
+
+    int Socket::read(char *buffer, uint64_t len)
+    {
+#ifndef _WIN32
+        return static_cast<int>(::read(sockFd_, buffer, len));
+#else
+        return ::recv(sockFd_, buffer, static_cast<int>(len), 0);
+#endif
+    }
+
+    struct sockaddr_in6 Socket::getLocalAddr(int sockfd)
+    {
+        struct sockaddr_in6 localaddr;
+        memset(&localaddr, 0, sizeof(localaddr));
+        socklen_t addrlen = static_cast<socklen_t>(sizeof localaddr);
+        if (::getsockname(sockfd,
+                          static_cast<struct sockaddr *>((void *)(&localaddr)),
+                          &addrlen) < 0)
+        {
+            LOG_SYSERR << "sockets::getLocalAddr";
+        }
+        return localaddr;
+    }
+
+    struct sockaddr_in6 Socket::getPeerAddr(int sockfd)
+    {
+        struct sockaddr_in6 peeraddr;
+        memset(&peeraddr, 0, sizeof(peeraddr));
+        socklen_t addrlen = static_cast<socklen_t>(sizeof peeraddr);
+        if (::getpeername(sockfd,
+                          static_cast<struct sockaddr *>((void *)(&peeraddr)),
+                          &addrlen) < 0)
+        {
+            LOG_SYSERR << "sockets::getPeerAddr";
+        }
+        return peeraddr;
+    }
+
+    InetAddress Socket::getLocalAddress(int sockfd)
+    {
+        struct sockaddr_storage addr;
+        memset(&addr, 0, sizeof(addr));
+        socklen_t addrlen = static_cast<socklen_t>(sizeof addr);
+        InetAddress localaddr;
+        if (::getsockname(sockfd, (struct sockaddr *)&addr, &addrlen) < 0)
+        {
+            LOG_SYSERR << "sockets::getLocalAddress";
+            return localaddr;
+        }
+        localaddr.setSockAddr((struct sockaddr *)&addr, addrlen);
+        return localaddr;
+    }
+
+    InetAddress Socket::getPeerAddress(int sockfd)
+    {
+        struct sockaddr_storage addr;
+        memset(&addr, 0, sizeof(addr));
+        socklen_t addrlen = static_cast<socklen_t>(sizeof addr);
+        InetAddress peeraddr;
+        if (::getpeername(sockfd, (struct sockaddr *)&addr, &addrlen) < 0)
+        {
+            LOG_SYSERR << "sockets::getPeerAddress";
+            return peeraddr;
+        }
+        peeraddr.setSockAddr((struct sockaddr *)&addr, addrlen);
+        return peeraddr;
+    }
+
+    void Socket::setTcpNoDelay(bool on)
+    {
+        int optval = on ? 1 : 0;
+        ::setsockopt(sockFd_,
+                     IPPROTO_TCP,
+                     TCP_NODELAY,
+                     (char *)&optval,
+                     static_cast<socklen_t>(sizeof optval));
+    }
+
+    void Socket::setReuseAddr(bool on)
+    {
+        int optval = on ? 1 : 0;
+        ::setsockopt(sockFd_,
+                     SOL_SOCKET,
+                     SO_REUSEADDR,
+                     (char *)&optval,
+                     static_cast<socklen_t>(sizeof optval));
+    }
+
+    void Socket::setReusePort(bool on)
+    {
+#ifdef SO_REUSEPORT
+        int optval = on ? 1 : 0;
+        int ret = ::setsockopt(sockFd_,
+                               SOL_SOCKET,
+                               SO_REUSEPORT,
+                               (char *)&optval,
+                               static_cast<socklen_t>(sizeof optval));
+        if (ret < 0 && on)
+        {
+            LOG_SYSERR << "SO_REUSEPORT failed.";
+        }
+#else
+        if (on)
+        {
+            LOG_ERROR << "SO_REUSEPORT is not supported.";
+        }
+#endif
+    }
+
+    void Socket::setKeepAlive(bool on)
+    {
+        int optval = on ? 1 : 0;
+        ::setsockopt(sockFd_,
+                     SOL_SOCKET,
+                     SO_KEEPALIVE,
+                     (char *)&optval,
+                     static_cast<socklen_t>(sizeof optval));
+    }
+
+    void Socket::setLinger(bool on, int seconds)
+    {
+        struct linger optval;
+        optval.l_onoff = on ? 1 : 0;
+        optval.l_linger = seconds;
+        ::setsockopt(sockFd_,
+                     SOL_SOCKET,
+                     SO_LINGER,
+                     (char *)&optval,
+                     static_cast<socklen_t>(sizeof optval));
+    }
+
+    int Socket::getSocketError()
+    {
+        return getSocketError(sockFd_);
+    }
+
+    Socket::~Socket()
+    {
+        LOG_TRACE << "Socket deconstructed:" << sockFd_;
+        reset();
+    }
+
+    void Socket::reset(int sockfd)
+    {
+        if (sockFd_ >= 0)
+        {
+#ifndef _WIN32
+            close(sockFd_);
+#else
+            closesocket(sockFd_);
+#endif
+        }
+        sockFd_ = sockfd;
+    }
+} // namespace xiao
@@ -0,0 +1,178 @@
+/**
+ * @file Socket.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/net/InetAddress.h>
+#include <xiao/utils/Logger.h>
+#include <string>
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+namespace xiao
+{
+    /**
+     * @brief This class owns a socket fd and wraps the socket system calls.
+     *
+     */
+    class Socket : NonCopyable
+    {
+    public:
+        static int createNonblockingSocketOrDie(int family)
+        {
+            // A Unix domain stream socket has no TCP.
+            int protocol = (family == AF_INET || family == AF_INET6) ? IPPROTO_TCP : 0;
+#ifdef __linux__
+            int sock = ::socket(family,
+                                SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                                protocol);
+#else
+            int sock = static_cast<int>(::socket(family, SOCK_STREAM, protocol));
+            setNonBlockAndCloseOnExec(sock);
+#endif
+            if (sock < 0)
+            {
+                LOG_SYSERR << "sockets::createNonblockingOrDie";
+                exit(1);
+            }
+            LOG_TRACE << "sock=" << sock;
+            return sock;
+        }
+
+        static int createNonblockingDatagramSocketOrDie(int family)
+        {
+#ifdef __linux__
+            int sock = ::socket(family,
+                                SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                                IPPROTO_UDP);
+#else
+            int sock = static_cast<int>(::socket(family, SOCK_DGRAM, IPPROTO_UDP));
+            setNonBlockAndCloseOnExec(sock);
+#endif
+            if (sock < 0)
+            {
+                LOG_SYSERR << "sockets::createNonblockingDatagramSocketOrDie";
+                exit(1);
+            }
+            LOG_TRACE << "sock=" << sock;
+            return sock;
+        }
+
+        static int getSocketError(int sockfd)
+        {
+            int optval;
+            socklen_t optlen = static_cast<socklen_t>(sizeof optval);
+            if (::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, (char *)&optval, &optlen) < 0)
+            {
+                return errno;
+            }
+            return optval;
+        }
+
+        static int connect(int sockfd, const InetAddress &addr)
+        {
+            return ::connect(sockfd, addr.getSockAddr(), addr.getSockAddrLen());
+        }
+
+        static bool isSelfConnect(int sockfd);
+
+        explicit Socket(int sockfd) : sockFd_(sockfd)
+        {
+        }
+        ~Socket();
+
+        /**
+         * @brief Close the socket owned and own another one.
+         *
+         * @param sockfd
+         */
+        void reset(int sockfd = -1);
+
+        /// abort if address in use
+        void bindAddress(const InetAddress &localaddr);
+        /// abort if address in use
+        void listen();
+        int accept(InetAddress *peeraddr);
+        void closeWrite();
+        int read(char *buffer, uint64_t len);
+        int fd()
+        {
+            return sockFd_;
+        }
+        static struct sockaddr_in6 getLocalAddr(int sockfd);
+        static struct sockaddr_in6 getPeerAddr(int sockfd);
+        /**
+         * @brief Get the local or the peer address of a socket of any family,
+         * Unix domain ones too.
+         *
+         */
+        static InetAddress getLocalAddress(int sockfd);
+        static InetAddress getPeerAddress(int sockfd);
+
+        /**
+         * @brief Enable/disable TCP_NODELAY (disable/enable Nagle's algorithm).
+         *
+         * @param on
+         */
+        void setTcpNoDelay(bool on);
+
+        /**
+         * @brief Enable/disable SO_REUSEADDR
+         *
+         * @param on
+         */
+        void setReuseAddr(bool on);
+
+        /**
+         * @brief Enable/disable SO_REUSEPORT
+         *
+         * @param on
+         */
+        void setReusePort(bool on);
+
+        /**
+         * @brief Enable/disable SO_KEEPALIVE
+         *
+         * @param on
+         */
+        void setKeepAlive(bool on);
+
+        /**
+         * @brief Enable/disable SO_LINGER, with a timeout of 0 the socket is
+         * reset on close and the data not sent yet is dropped.
+         *
+         * @param on
+         * @param seconds
+         */
+        void setLinger(bool on, int seconds);
+        int getSocketError();
+
+        static void setNonBlockAndCloseOnExec(int sockfd)
+        {
+#ifndef _WIN32
+            // non-block
+            int flags = ::fcntl(sockfd, F_GETFL, 0);
+            flags |= O_NONBLOCK;
+            int ret = ::fcntl(sockfd, F_SETFL, flags);
+            // close-on-exec
+            flags = ::fcntl(sockfd, F_GETFD, 0);
+            flags |= FD_CLOEXEC;
+            ret = ::fcntl(sockfd, F_SETFD, flags);
+            (void)ret;
+#endif
+        }
+
+    protected:
+        int sockFd_;
+    };
+} // namespace xiao
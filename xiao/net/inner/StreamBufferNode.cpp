@@ -0,0 +1,74 @@
+/**
+ * @file StreamBufferNode.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "BufferNode.h"
+#include <xiao/utils/MsgBuffer.h>
+
+namespace xiao
+{
+    static const size_t xMaxStreamChunk = 16 * 1024;
+
+    class StreamBufferNode : public BufferNode
+    {
+    public:
+        explicit StreamBufferNode(StreamCallback &&callback)
+            : streamCallback_(std::move(callback))
+        {
+        }
+        ~StreamBufferNode() override
+        {
+            // Let the producer release its resources.
+            if (streamCallback_)
+                streamCallback_(nullptr, 0);
+        }
+
+        bool isStream() const override
+        {
+            return true;
+        }
+        void getData(const char *&data, size_t &len) override
+        {
+            if (buffer_.readableBytes() == 0 && !isDone_)
+            {
+                buffer_.ensureWritableBytes(xMaxStreamChunk);
+                auto n = streamCallback_(buffer_.beginWrite(), xMaxStreamChunk);
+                if (n > 0)
+                {
+                    buffer_.hasWritten(n);
+                }
+                else
+                {
+                    done();
+                }
+            }
+            data = buffer_.peek();
+            len = buffer_.readableBytes();
+        }
+        void retrieve(size_t len) override
+        {
+            buffer_.retrieve(len);
+        }
+        long long remainingBytes() const override
+        {
+            // The length of the stream is unknown until the producer ends it.
+            return static_cast<long long>(buffer_.readableBytes()) + (isDone_ ? 0 : 1);
+        }
+
+    private:
+        StreamCallback streamCallback_;
+        MsgBuffer buffer_;
+    };
+
+    BufferNodePtr BufferNode::newStreamBufferNode(StreamCallback &&callback)
+    {
+        return std::make_shared<StreamBufferNode>(std::move(callback));
+    }
+} // namespace xiao
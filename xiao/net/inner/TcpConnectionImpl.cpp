@@ -0,0 +1,1105 @@
+/**
+ * @file TcpConnectionImpl.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "TcpConnectionImpl.h"
+#include "Socket.h"
+#include <xiao/net/Channel.h>
+#include <xiao/utils/Logger.h>
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define XIAO_HAS_ZEROCOPY
+#endif
+#endif
+
+namespace xiao
+{
+#ifdef IOV_MAX
+    static const int xMaxIovecs = IOV_MAX;
+#else
+    static const int xMaxIovecs = 1024;
+#endif
+    // The moved strings and buffers shorter than this are copied to the
+    // memory node at the tail of the chain rather than queued as nodes.
+    static const size_t xMinSharedNodeLength = 4096;
+    // Pinning the pages costs more than copying the smaller chunks.
+    static const size_t xMinZeroCopyLength = 32 * 1024;
+    // A destroyed connection polls for the completions of its zero copy
+    // sends at this interval, for this many times, before it resets the
+    // socket.
+    static const double xZeroCopyPollInterval = 0.01;
+    static const size_t xZeroCopyPollTries = 200;
+    // The most fds passed with one message (SCM_MAX_FD of Linux).
+    static const size_t xMaxPassedFds = 253;
+    // The room made in the receive buffer for a read with recvmsg().
+    static const size_t xFdsReadSize = 16 * 1024;
+
+    namespace
+    {
+        class AsyncStreamImpl : public AsyncStream
+        {
+        public:
+            AsyncStreamImpl(const std::weak_ptr<TcpConnectionImpl> &connPtr,
+                            const BufferNodePtr &node)
+                : connPtr_(connPtr), node_(node)
+            {
+            }
+            ~AsyncStreamImpl() override
+            {
+                close();
+            }
+
+            bool send(const char *data, size_t len) override
+            {
+                if (closed_)
+                    return false;
+                auto connPtr = connPtr_.lock();
+                if (!connPtr || !connPtr->connected())
+                    return false;
+                auto loop = connPtr->getLoop();
+                if (loop->isInLoopThread())
+                {
+                    connPtr->sendAsyncDataInLoop(node_, data, len);
+                }
+                else
+                {
+                    std::string msg(data, len);
+                    auto node = node_;
+                    loop->queueInLoop([connPtr, node, msg = std::move(msg)]() {
+                        connPtr->sendAsyncDataInLoop(node, msg.data(), msg.length());
+                    });
+                }
+                return true;
+            }
+
+            void close() override
+            {
+                if (closed_)
+                    return;
+                closed_ = true;
+                auto connPtr = connPtr_.lock();
+                if (!connPtr)
+                    return;
+                auto node = node_;
+                connPtr->getLoop()->runInLoop(
+                    [connPtr, node]() { connPtr->closeAsyncStreamInLoop(node); });
+            }
+
+        private:
+            std::weak_ptr<TcpConnectionImpl> connPtr_;
+            BufferNodePtr node_;
+            bool closed_{false};
+        };
+    } // namespace
+
+    TcpConnectionImpl::TcpConnectionImpl(EventLoop *loop,
+                                         int socketfd,
+                                         const InetAddress &localAddr,
+                                         const InetAddress &peerAddr)
+        : loop_(loop),
+          ioChannelPtr_(new Channel(loop, socketfd)),
+          socketPtr_(new Socket(socketfd)),
+          localAddr_(localAddr),
+          peerAddr_(peerAddr)
+    {
+        LOG_TRACE << "new connection:" << peerAddr.toIpPort() << "->"
+                  << localAddr.toIpPort();
+        ioChannelPtr_->setReadCallback(
+            std::bind(&TcpConnectionImpl::readCallback, this));
+        ioChannelPtr_->setWriteCallback(
+            std::bind(&TcpConnectionImpl::writeCallback, this));
+        ioChannelPtr_->setCloseCallback(
+            std::bind(&TcpConnectionImpl::handleClose, this));
+        ioChannelPtr_->setErrorCallback(
+            std::bind(&TcpConnectionImpl::handleError, this));
+        socketPtr_->setKeepAlive(true);
+    }
+
+    TcpConnectionImpl::~TcpConnectionImpl()
+    {
+        LOG_TRACE << "Deconstruct connection, fd=" << socketPtr_->fd();
+        abortZeroCopySends();
+        closeRecvFds();
+    }
+
+    void TcpConnectionImpl::readCallback()
+    {
+        loop_->assertInLoopThread();
+        int ret = 0;
+        ssize_t n = recvFdsEnabled_ ? readWithFds(&ret)
+                                    : readBuffer_.readFd(socketPtr_->fd(), &ret);
+        if (n == 0)
+        {
+            // the peer closed the connection
+            handleClose();
+            return;
+        }
+        if (n < 0)
+        {
+            if (ret == EAGAIN || ret == EWOULDBLOCK || ret == EINTR)
+                return;
+            if (ret == EPIPE || ret == ECONNRESET)
+            {
+                LOG_TRACE << "EPIPE or ECONNRESET, errno=" << ret
+                          << " fd=" << socketPtr_->fd();
+            }
+            else
+            {
+                LOG_SYSERR << "read socket error";
+            }
+            handleClose();
+            return;
+        }
+        bytesReceived_ += n;
+        idleEntry_.refresh();
+        if (recvMsgCallback_)
+        {
+            recvMsgCallback_(shared_from_this(), &readBuffer_);
+        }
+    }
+
+    void TcpConnectionImpl::writeCallback()
+    {
+        loop_->assertInLoopThread();
+        if (ioChannelPtr_->isWriting())
+        {
+            flush();
+        }
+        else
+        {
+            LOG_TRACE << "Connection is down, no more writing";
+        }
+    }
+
+    void TcpConnectionImpl::handleClose()
+    {
+        LOG_TRACE << "connection closed, fd=" << socketPtr_->fd();
+        loop_->assertInLoopThread();
+        status_ = ConnStatus::Disconnected;
+        ioChannelPtr_->disableAll();
+        if (peerThrottled_)
+            resumePeer();
+        auto guardThis = shared_from_this();
+        if (connectionCallback_)
+            connectionCallback_(guardThis);
+        if (closeCallback_)
+        {
+            LOG_TRACE << "to call close callback";
+            closeCallback_(guardThis);
+        }
+    }
+
+    void TcpConnectionImpl::handleError()
+    {
+        // The completions of the zero copy sends are reported as errors.
+        if (!zeroCopyPending_.empty())
+            readZeroCopyCompletions();
+        int err = socketPtr_->getSocketError();
+        if (err == 0)
+            return;
+        if (err == EPIPE || err == ECONNRESET)
+        {
+            LOG_DEBUG << "SO_ERROR = " << err << " " << strerror(err);
+        }
+        else
+        {
+            LOG_ERROR << "SO_ERROR = " << err << " " << strerror(err);
+        }
+    }
+
+    void TcpConnectionImpl::connectEstablished()
+    {
+        auto thisPtr = shared_from_this();
+        loop_->runInLoop([thisPtr]() {
+            LOG_TRACE << "connectEstablished";
+            assert(thisPtr->status_ == ConnStatus::Connecting);
+            thisPtr->ioChannelPtr_->tie(thisPtr);
+            thisPtr->ioChannelPtr_->enableReading();
+            thisPtr->status_ = ConnStatus::Connected;
+            if (thisPtr->connectionCallback_)
+                thisPtr->connectionCallback_(thisPtr);
+        });
+    }
+
+    void TcpConnectionImpl::connectDestroyed()
+    {
+        auto thisPtr = shared_from_this();
+        loop_->runInLoop([thisPtr]() {
+            if (thisPtr->status_ == ConnStatus::Connected)
+            {
+                thisPtr->status_ = ConnStatus::Disconnected;
+                thisPtr->ioChannelPtr_->disableAll();
+                if (thisPtr->connectionCallback_)
+                    thisPtr->connectionCallback_(thisPtr);
+            }
+            thisPtr->ioChannelPtr_->remove();
+            // The kernel may still send from the pages of the nodes.
+            if (!thisPtr->zeroCopyPending_.empty())
+                thisPtr->waitZeroCopyCompletions(xZeroCopyPollTries);
+        });
+    }
+
+    void TcpConnectionImpl::queueOwnerTask(std::shared_ptr<TcpConnectionImpl> &&conn,
+                                           OwnerHandler handler,
+                                           void *owner)
+    {
+        auto &task = conn->ownerTask_;
+        assert(!task.conn_);
+        auto loop = conn->loop_;
+        task.handler_ = handler;
+        task.owner_ = owner;
+        task.conn_ = std::move(conn);
+        loop->queueTask(&task);
+    }
+
+    bool TcpConnectionImpl::recycle()
+    {
+        // The channel is still in the poller if the connection was never
+        // destroyed, e.g. when its loop quit, and the zero copy sends are
+        // outstanding if they were not completed in time.
+        if (ioChannelPtr_->index() != -1 || !zeroCopyPending_.empty())
+            return false;
+        socketPtr_->reset();
+        readBuffer_.retrieveAll();
+        writeBufferList_.clear();
+        // Release what the callbacks and the context hold now rather than
+        // when the connection is reused.
+        recvMsgCallback_ = nullptr;
+        connectionCallback_ = nullptr;
+        closeCallback_ = nullptr;
+        writeCompleteCallback_ = nullptr;
+        highWaterMarkCallback_ = nullptr;
+        clearContext();
+        backpressurePeer_.reset();
+        // The slot of the wheel, if any, can't lock the connection any more.
+        idleEntry_ = TimingWheel::Entry();
+        status_ = ConnStatus::Connecting;
+        highWaterMarkLen_ = 0;
+        pendingBytes_ = 0;
+        flushQueued_ = false;
+        sendNum_ = 0;
+        bytesSent_ = 0;
+        bytesReceived_ = 0;
+        peerHighMark_ = 0;
+        peerLowMark_ = 0;
+        peerThrottled_ = false;
+        zeroCopy_ = false;
+        zeroCopySeq_ = 0;
+        recvFdsEnabled_ = false;
+        closeRecvFds();
+        return true;
+    }
+
+    void TcpConnectionImpl::reuse(int socketfd,
+                                  const InetAddress &localAddr,
+                                  const InetAddress &peerAddr)
+    {
+        LOG_TRACE << "reuse connection:" << peerAddr.toIpPort() << "->"
+                  << localAddr.toIpPort();
+        ioChannelPtr_->resetFd(socketfd);
+        socketPtr_->reset(socketfd);
+        localAddr_ = localAddr;
+        peerAddr_ = peerAddr;
+        socketPtr_->setKeepAlive(true);
+    }
+
+    void TcpConnectionImpl::shutdown()
+    {
+        auto thisPtr = shared_from_this();
+        loop_->runInLoop([thisPtr]() {
+            if (thisPtr->status_ == ConnStatus::Connected)
+            {
+                thisPtr->status_ = ConnStatus::Disconnecting;
+                // Otherwise the write side is closed when the chain is drained.
+                if (thisPtr->writeBufferList_.empty())
+                {
+                    thisPtr->socketPtr_->closeWrite();
+                }
+            }
+        });
+    }
+
+    void TcpConnectionImpl::forceClose()
+    {
+        auto thisPtr = shared_from_this();
+        loop_->runInLoop([thisPtr]() {
+            if (thisPtr->status_ == ConnStatus::Connected ||
+                thisPtr->status_ == ConnStatus::Disconnecting)
+            {
+                thisPtr->status_ = ConnStatus::Disconnecting;
+                thisPtr->handleClose();
+            }
+        });
+    }
+
+    int TcpConnectionImpl::detach()
+    {
+        loop_->assertInLoopThread();
+        if (status_ != ConnStatus::Connected || !writeBufferList_.empty() ||
+            sendNum_ > 0 || !zeroCopyPending_.empty() ||
+            readBuffer_.readableBytes() > 0)
+            return -1;
+#ifdef _WIN32
+        return -1;
+#else
+        int fd = ::fcntl(socketPtr_->fd(), F_DUPFD_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            LOG_SYSERR << "Failed to detach the connection";
+            return -1;
+        }
+        // Closing disables the channel, which deletes the socket from the
+        // epoll set before this returns, and the owner removes the channel.
+        // The duplicate keeps the socket open when this one is closed, and
+        // nothing is shut down.
+        status_ = ConnStatus::Disconnecting;
+        handleClose();
+        return fd;
+#endif
+    }
+
+    void TcpConnectionImpl::setBackpressure(const TcpConnectionPtr &peer,
+                                            size_t highMark,
+                                            size_t lowMark)
+    {
+        assert(lowMark <= highMark);
+        auto thisPtr = shared_from_this();
+        loop_->runInLoop([thisPtr, peer, highMark, lowMark]() {
+            if (thisPtr->peerThrottled_)
+                thisPtr->resumePeer();
+            thisPtr->backpressurePeer_ = peer;
+            thisPtr->peerHighMark_ = highMark;
+            thisPtr->peerLowMark_ = lowMark;
+            if (peer && thisPtr->pendingBytes_ > highMark)
+            {
+                thisPtr->peerThrottled_ = true;
+                peer->stopRecv();
+            }
+        });
+    }
+
+    void TcpConnectionImpl::stopRecv()
+    {
+        auto thisPtr = shared_from_this();
+        loop_->runInLoop([thisPtr]() {
+            if (thisPtr->ioChannelPtr_->isReading())
+                thisPtr->ioChannelPtr_->disableReading();
+        });
+    }
+
+    void TcpConnectionImpl::startRecv()
+    {
+        auto thisPtr = shared_from_this();
+        loop_->runInLoop([thisPtr]() {
+            if ((thisPtr->status_ == ConnStatus::Connected ||
+                 thisPtr->status_ == ConnStatus::Disconnecting) &&
+                !thisPtr->ioChannelPtr_->isReading())
+                thisPtr->ioChannelPtr_->enableReading();
+        });
+    }
+
+    void TcpConnectionImpl::setTcpNoDelay(bool on)
+    {
+        socketPtr_->setTcpNoDelay(on);
+    }
+
+    bool TcpConnectionImpl::setZeroCopy(bool on)
+    {
+#ifdef XIAO_HAS_ZEROCOPY
+        if (on)
+        {
+            int optval = 1;
+            if (::setsockopt(socketPtr_->fd(),
+                             SOL_SOCKET,
+                             SO_ZEROCOPY,
+                             &optval,
+                             static_cast<socklen_t>(sizeof optval)) < 0)
+            {
+                LOG_SYSERR << "SO_ZEROCOPY failed";
+                return false;
+            }
+        }
+        auto thisPtr = shared_from_this();
+        loop_->runInLoop([thisPtr, on]() { thisPtr->zeroCopy_ = on; });
+        return true;
+#else
+        if (on)
+        {
+            LOG_ERROR << "MSG_ZEROCOPY is not supported";
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    bool TcpConnectionImpl::sendFds(const char *msg,
+                                    size_t len,
+                                    const std::vector<int> &fds)
+    {
+#ifndef _WIN32
+        if (len == 0 || !localAddr_.isUnixDomain() || fds.size() > xMaxPassedFds)
+        {
+            LOG_ERROR << "Can't pass fds on this connection";
+            return false;
+        }
+        // Duplicated now, the caller may close its fds before the data is
+        // sent.
+        std::vector<int> dups;
+        dups.reserve(fds.size());
+        for (auto fd : fds)
+        {
+            int dup = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+            if (dup < 0)
+            {
+                LOG_SYSERR << "dup fd " << fd;
+                for (auto d : dups)
+                    ::close(d);
+                return false;
+            }
+            dups.push_back(dup);
+        }
+        sendNode(BufferNode::newFdsBufferNode(msg, len, std::move(dups)));
+        return true;
+#else
+        (void)msg;
+        (void)len;
+        (void)fds;
+        LOG_ERROR << "Passing fds is not supported";
+        return false;
+#endif
+    }
+
+    void TcpConnectionImpl::setRecvFds(bool on)
+    {
+        auto thisPtr = shared_from_this();
+        loop_->runInLoop([thisPtr, on]() { thisPtr->recvFdsEnabled_ = on; });
+    }
+
+    std::vector<int> TcpConnectionImpl::takeRecvFds()
+    {
+        loop_->assertInLoopThread();
+        std::vector<int> fds;
+        fds.swap(recvFds_);
+        return fds;
+    }
+
+    void TcpConnectionImpl::closeRecvFds()
+    {
+#ifndef _WIN32
+        for (auto fd : recvFds_)
+            ::close(fd);
+#endif
+        recvFds_.clear();
+    }
+
+    void TcpConnectionImpl::send(const char *msg, size_t len)
+    {
+        if (loop_->isInLoopThread() && sendNum_.load(std::memory_order_acquire) == 0)
+        {
+            sendInLoop(msg, len);
+            return;
+        }
+        auto node = BufferNode::newMemBufferNode();
+        node->append(msg, len);
+        sendNode(std::move(node));
+    }
+
+    void TcpConnectionImpl::send(const void *msg, size_t len)
+    {
+        send(static_cast<const char *>(msg), len);
+    }
+
+    void TcpConnectionImpl::send(const std::string &msg)
+    {
+        send(msg.data(), msg.length());
+    }
+
+    void TcpConnectionImpl::send(std::string &&msg)
+    {
+        if (msg.length() < xMinSharedNodeLength)
+        {
+            send(msg.data(), msg.length());
+            return;
+        }
+        auto msgPtr = std::make_shared<std::string>(std::move(msg));
+        sendNode(BufferNode::newSharedBufferNode(msgPtr,
+                                                 msgPtr->data(),
+                                                 msgPtr->length()));
+    }
+
+    void TcpConnectionImpl::send(const MsgBuffer &buffer)
+    {
+        send(buffer.peek(), buffer.readableBytes());
+    }
+
+    void TcpConnectionImpl::send(MsgBuffer &&buffer)
+    {
+        if (buffer.readableBytes() < xMinSharedNodeLength)
+        {
+            send(buffer.peek(), buffer.readableBytes());
+            return;
+        }
+        auto msgPtr = std::make_shared<MsgBuffer>(std::move(buffer));
+        sendNode(BufferNode::newSharedBufferNode(msgPtr,
+                                                 msgPtr->peek(),
+                                                 msgPtr->readableBytes()));
+    }
+
+    void TcpConnectionImpl::send(const std::shared_ptr<std::string> &msgPtr)
+    {
+        sendNode(BufferNode::newSharedBufferNode(msgPtr,
+                                                 msgPtr->data(),
+                                                 msgPtr->length()));
+    }
+
+    void TcpConnectionImpl::send(const std::shared_ptr<MsgBuffer> &msgPtr)
+    {
+        sendNode(BufferNode::newSharedBufferNode(msgPtr,
+                                                 msgPtr->peek(),
+                                                 msgPtr->readableBytes()));
+    }
+
+    void TcpConnectionImpl::sendFile(const char *fileName,
+                                     long long offset,
+                                     long long length)
+    {
+        assert(fileName);
+        sendNode(BufferNode::newFileBufferNode(fileName, offset, length));
+    }
+
+    void TcpConnectionImpl::sendStream(
+        std::function<std::size_t(char *, std::size_t)> callback)
+    {
+        sendNode(BufferNode::newStreamBufferNode(std::move(callback)));
+    }
+
+    AsyncStreamPtr TcpConnectionImpl::sendAsyncStream()
+    {
+        auto node = BufferNode::newAsyncStreamBufferNode();
+        auto asyncStream = std::make_unique<AsyncStreamImpl>(
+            std::weak_ptr<TcpConnectionImpl>(shared_from_this()), node);
+        sendNode(std::move(node));
+        return asyncStream;
+    }
+
+    void TcpConnectionImpl::sendAsyncDataInLoop(const BufferNodePtr &node,
+                                                const char *data,
+                                                size_t len)
+    {
+        loop_->assertInLoopThread();
+        if (status_ != ConnStatus::Connected)
+            return;
+        node->append(data, len);
+        queueFlush();
+    }
+
+    void TcpConnectionImpl::closeAsyncStreamInLoop(const BufferNodePtr &node)
+    {
+        loop_->assertInLoopThread();
+        node->done();
+        if (status_ == ConnStatus::Connected || status_ == ConnStatus::Disconnecting)
+            queueFlush();
+    }
+
+    void TcpConnectionImpl::sendNode(BufferNodePtr &&node)
+    {
+        if (loop_->isInLoopThread() && sendNum_.load(std::memory_order_acquire) == 0)
+        {
+            sendNodeInLoop(node);
+            return;
+        }
+        ++sendNum_;
+        auto thisPtr = shared_from_this();
+        loop_->queueInLoop([thisPtr, node = std::move(node)]() {
+            thisPtr->sendNodeInLoop(node);
+            --thisPtr->sendNum_;
+        });
+    }
+
+    void TcpConnectionImpl::sendInLoop(const char *buffer, size_t length)
+    {
+        loop_->assertInLoopThread();
+        if (status_ != ConnStatus::Connected)
+        {
+            LOG_WARN << "Connection is not connected,give up sending";
+            return;
+        }
+        if (writeBufferList_.empty() || !writeBufferList_.back()->isMemory())
+        {
+            writeBufferList_.push_back(BufferNode::newMemBufferNode());
+        }
+        writeBufferList_.back()->append(buffer, length);
+        addPendingBytes(length);
+        queueFlush();
+    }
+
+    void TcpConnectionImpl::sendNodeInLoop(const BufferNodePtr &node)
+    {
+        loop_->assertInLoopThread();
+        if (status_ != ConnStatus::Connected)
+        {
+            LOG_WARN << "Connection is not connected,give up sending";
+            return;
+        }
+        writeBufferList_.push_back(node);
+        if (!node->isStream())
+        {
+            addPendingBytes(static_cast<size_t>(node->remainingBytes()));
+        }
+        queueFlush();
+    }
+
+    void TcpConnectionImpl::addPendingBytes(size_t len)
+    {
+        size_t oldBytes = pendingBytes_;
+        pendingBytes_ += len;
+        if (highWaterMarkCallback_ && oldBytes <= highWaterMarkLen_ &&
+            pendingBytes_ > highWaterMarkLen_)
+        {
+            highWaterMarkCallback_(shared_from_this(), pendingBytes_);
+        }
+        if (!peerThrottled_ && pendingBytes_ > peerHighMark_)
+        {
+            auto peer = backpressurePeer_.lock();
+            if (peer)
+            {
+                LOG_TRACE << "stop reading the peer, " << pendingBytes_
+                          << " bytes pending, fd=" << socketPtr_->fd();
+                peerThrottled_ = true;
+                peer->stopRecv();
+            }
+        }
+    }
+
+    void TcpConnectionImpl::subPendingBytes(size_t len)
+    {
+        assert(len <= pendingBytes_);
+        pendingBytes_ -= len;
+        if (peerThrottled_ && pendingBytes_ <= peerLowMark_)
+            resumePeer();
+    }
+
+    void TcpConnectionImpl::resumePeer()
+    {
+        peerThrottled_ = false;
+        auto peer = backpressurePeer_.lock();
+        if (peer)
+        {
+            LOG_TRACE << "start reading the peer, " << pendingBytes_
+                      << " bytes pending, fd=" << socketPtr_->fd();
+            peer->startRecv();
+        }
+    }
+
+    void TcpConnectionImpl::queueFlush()
+    {
+        // A writable socket is flushed by the write event, and the sends of
+        // one iteration of the loop are flushed together before polling.
+        if (flushQueued_ || ioChannelPtr_->isWriting())
+            return;
+        flushQueued_ = true;
+        auto thisPtr = shared_from_this();
+        loop_->runBeforePoll([thisPtr]() {
+            thisPtr->flushQueued_ = false;
+            if (thisPtr->status_ == ConnStatus::Disconnected ||
+                thisPtr->ioChannelPtr_->isWriting())
+                return;
+            thisPtr->flush();
+        });
+    }
+
+    void TcpConnectionImpl::flush()
+    {
+        loop_->assertInLoopThread();
+        idleEntry_.refresh();
+        struct iovec vecs[xMaxIovecs];
+        BufferNode *nodes[xMaxIovecs];
+        while (!writeBufferList_.empty())
+        {
+            // Gather the chunks of the nodes in order, up to a node that has
+            // no data for now or that has more data behind its chunk. A file
+            // node is sent on its own, without reading it to the user space.
+            int count = 0;
+            size_t total = 0;
+            BufferNodePtr zeroCopyNode;
+            BufferNodePtr fdsNode;
+            for (auto &node : writeBufferList_)
+            {
+                if (count == xMaxIovecs || !node->available() || node->isFile())
+                    break;
+                const char *data = nullptr;
+                size_t len = 0;
+                node->getData(data, len);
+                if (!node->getFds().empty())
+                {
+                    // The fds go with the first byte of the node, which
+                    // starts a sendmsg() of its own.
+                    if (count == 0)
+                    {
+                        vecs[0].iov_base = const_cast<char *>(data);
+                        vecs[0].iov_len = len;
+                        nodes[0] = node.get();
+                        count = 1;
+                        total = len;
+                        fdsNode = node;
+                    }
+                    break;
+                }
+                if (useZeroCopy(*node, len))
+                {
+                    // A large chunk is sent on its own with MSG_ZEROCOPY.
+                    if (count == 0)
+                    {
+                        vecs[0].iov_base = const_cast<char *>(data);
+                        vecs[0].iov_len = len;
+                        nodes[0] = node.get();
+                        count = 1;
+                        total = len;
+                        zeroCopyNode = node;
+                    }
+                    break;
+                }
+                if (len > 0)
+                {
+                    vecs[count].iov_base = const_cast<char *>(data);
+                    vecs[count].iov_len = len;
+                    nodes[count] = node.get();
+                    ++count;
+                    total += len;
+                }
+                if (node->remainingBytes() > static_cast<long long>(len))
+                    break;
+            }
+            if (count == 0)
+            {
+                auto &node = writeBufferList_.front();
+                auto remaining = node->remainingBytes();
+                if (node->isFile() && remaining > 0)
+                {
+                    ssize_t n = node->sendTo(socketPtr_->fd());
+                    int savedErrno = errno;
+                    // The node drops the rest of the file if it is truncated
+                    // or can't be read, which is credited here as well.
+                    subPendingBytes(
+                        static_cast<size_t>(remaining - node->remainingBytes()));
+                    if (n < 0)
+                    {
+                        if (handleWriteError(savedErrno))
+                            continue;
+                        return;
+                    }
+                    bytesSent_ += n;
+                    // A partial write is resumed from the offset of the node,
+                    // the next call returns EAGAIN if the socket is full.
+                    popFinishedNodes();
+                    continue;
+                }
+                // The nodes at the front are finished or waiting for data.
+                if (!popFinishedNodes())
+                {
+                    if (ioChannelPtr_->isWriting())
+                        ioChannelPtr_->disableWriting();
+                    return;
+                }
+                continue;
+            }
+            ssize_t n = fdsNode        ? sendWithFds(fdsNode, vecs)
+                        : zeroCopyNode ? sendZeroCopy(zeroCopyNode, vecs)
+                                       : ::writev(socketPtr_->fd(), vecs, count);
+            if (n < 0)
+            {
+                if (handleWriteError(errno))
+                    continue;
+                return;
+            }
+            bytesSent_ += n;
+            // Move the offsets of the nodes, nothing is copied on a partial
+            // write.
+            size_t left = static_cast<size_t>(n);
+            for (int i = 0; i < count && left > 0; ++i)
+            {
+                size_t len = (std::min)(left, vecs[i].iov_len);
+                nodes[i]->retrieve(len);
+                if (!nodes[i]->isStream())
+                    subPendingBytes(len);
+                left -= len;
+            }
+            popFinishedNodes();
+            if (static_cast<size_t>(n) < total)
+            {
+                if (!ioChannelPtr_->isWriting())
+                    ioChannelPtr_->enableWriting();
+                return;
+            }
+        }
+        afterChainDrained();
+    }
+
+    bool TcpConnectionImpl::handleWriteError(int err)
+    {
+        if (err == EINTR)
+            return true;
+        if (err == EAGAIN || err == EWOULDBLOCK)
+        {
+            if (!ioChannelPtr_->isWriting())
+                ioChannelPtr_->enableWriting();
+            return false;
+        }
+        if (err == EPIPE || err == ECONNRESET)
+        {
+            LOG_DEBUG << "EPIPE or ECONNRESET, errno=" << err
+                      << " fd=" << socketPtr_->fd();
+        }
+        else
+        {
+            LOG_SYSERR << "Unexpected error(" << err << ")";
+        }
+        // The close is seen by the read side.
+        writeBufferList_.clear();
+        pendingBytes_ = 0;
+        if (peerThrottled_)
+            resumePeer();
+        if (ioChannelPtr_->isWriting())
+            ioChannelPtr_->disableWriting();
+        return false;
+    }
+
+    bool TcpConnectionImpl::useZeroCopy(const BufferNode &node, size_t len) const
+    {
+        return zeroCopy_ && len >= xMinZeroCopyLength && node.isShared();
+    }
+
+    ssize_t TcpConnectionImpl::sendZeroCopy(const BufferNodePtr &node,
+                                            struct iovec *vec)
+    {
+#ifdef XIAO_HAS_ZEROCOPY
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = vec;
+        msg.msg_iovlen = 1;
+        auto n = ::sendmsg(socketPtr_->fd(), &msg, MSG_ZEROCOPY);
+        if (n >= 0)
+        {
+            // The node is kept until the kernel is done with its pages, the
+            // completions are read on the error events, even when no other
+            // event is enabled.
+            zeroCopyPending_.emplace_back(zeroCopySeq_++, node);
+            if (!ioChannelPtr_->isWatchingErrors())
+                ioChannelPtr_->enableErrorEvent();
+            return n;
+        }
+        if (errno != ENOBUFS)
+            return n;
+        // Out of the memory to pin the pages, copy this chunk.
+#else
+        (void)node;
+#endif
+        return ::writev(socketPtr_->fd(), vec, 1);
+    }
+
+    ssize_t TcpConnectionImpl::sendWithFds(const BufferNodePtr &node,
+                                           struct iovec *vec)
+    {
+#ifndef _WIN32
+        const auto &fds = node->getFds();
+        size_t controlLen = CMSG_SPACE(sizeof(int) * fds.size());
+        std::vector<char> control(controlLen, 0);
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = vec;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.data();
+        msg.msg_controllen = controlLen;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+        auto n = ::sendmsg(socketPtr_->fd(), &msg, 0);
+        // The peer owns its copies once a byte is sent.
+        if (n > 0)
+            node->fdsSent();
+        return n;
+#else
+        (void)node;
+        return ::writev(socketPtr_->fd(), vec, 1);
+#endif
+    }
+
+    ssize_t TcpConnectionImpl::readWithFds(int *savedErrno)
+    {
+#ifndef _WIN32
+        if (readBuffer_.writableBytes() < xFdsReadSize)
+            readBuffer_.ensureWritableBytes(xFdsReadSize);
+        struct iovec vec;
+        vec.iov_base = readBuffer_.beginWrite();
+        vec.iov_len = readBuffer_.writableBytes();
+        union
+        {
+            struct cmsghdr align;
+            char buf[CMSG_SPACE(sizeof(int) * xMaxPassedFds)];
+        } control;
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &vec;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+#ifdef MSG_CMSG_CLOEXEC
+        int flags = MSG_CMSG_CLOEXEC;
+#else
+        int flags = 0;
+#endif
+        auto n = ::recvmsg(socketPtr_->fd(), &msg, flags);
+        if (n < 0)
+        {
+            *savedErrno = errno;
+            return n;
+        }
+        for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                continue;
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            size_t first = recvFds_.size();
+            recvFds_.resize(first + count);
+            memcpy(&recvFds_[first], CMSG_DATA(cmsg), sizeof(int) * count);
+        }
+        if (msg.msg_flags & MSG_CTRUNC)
+        {
+            LOG_ERROR << "Too many fds passed at once, some are closed, fd="
+                      << socketPtr_->fd();
+        }
+        readBuffer_.hasWritten(static_cast<size_t>(n));
+        return n;
+#else
+        return readBuffer_.readFd(socketPtr_->fd(), savedErrno);
+#endif
+    }
+
+    void TcpConnectionImpl::readZeroCopyCompletions()
+    {
+#ifdef XIAO_HAS_ZEROCOPY
+        char control[128];
+        while (!zeroCopyPending_.empty())
+        {
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if (::recvmsg(socketPtr_->fd(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                {
+                    LOG_SYSERR << "read error queue";
+                }
+                break;
+            }
+            for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            {
+                if (!((cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                      (cmsg->cmsg_level == IPPROTO_IPV6 &&
+                       cmsg->cmsg_type == IPV6_RECVERR)))
+                    continue;
+                auto err = reinterpret_cast<const struct sock_extended_err *>(
+                    CMSG_DATA(cmsg));
+                if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                    continue;
+                // The sends [ee_info, ee_data] are completed.
+                uint32_t last = err->ee_data;
+                while (!zeroCopyPending_.empty() &&
+                       static_cast<int32_t>(zeroCopyPending_.front().first - last) <= 0)
+                {
+                    zeroCopyPending_.pop_front();
+                }
+                if ((err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && zeroCopy_)
+                {
+                    LOG_TRACE << "The kernel copied the zero copy send, fd="
+                              << socketPtr_->fd();
+                    zeroCopy_ = false;
+                }
+            }
+        }
+        if (zeroCopyPending_.empty() && ioChannelPtr_->isWatchingErrors())
+            ioChannelPtr_->disableErrorEvent();
+#endif
+    }
+
+    void TcpConnectionImpl::waitZeroCopyCompletions(size_t tries)
+    {
+        readZeroCopyCompletions();
+        if (zeroCopyPending_.empty())
+            return;
+        if (tries == 0)
+        {
+            LOG_WARN << zeroCopyPending_.size()
+                     << " zero copy sends not completed, reset fd="
+                     << socketPtr_->fd();
+            abortZeroCopySends();
+            return;
+        }
+        // The timer keeps the connection, so it is not recycled meanwhile.
+        auto thisPtr = shared_from_this();
+        loop_->runAfter(xZeroCopyPollInterval, [thisPtr, tries]() {
+            thisPtr->waitZeroCopyCompletions(tries - 1);
+        });
+    }
+
+    void TcpConnectionImpl::abortZeroCopySends()
+    {
+        if (zeroCopyPending_.empty())
+            return;
+        if (socketPtr_->fd() >= 0)
+        {
+            socketPtr_->setLinger(true, 0);
+            socketPtr_->reset();
+        }
+        zeroCopyPending_.clear();
+    }
+
+    bool TcpConnectionImpl::popFinishedNodes()
+    {
+        bool popped = false;
+        while (!writeBufferList_.empty() &&
+               writeBufferList_.front()->remainingBytes() == 0)
+        {
+            writeBufferList_.pop_front();
+            popped = true;
+        }
+        return popped;
+    }
+
+    void TcpConnectionImpl::afterChainDrained()
+    {
+        if (ioChannelPtr_->isWriting())
+            ioChannelPtr_->disableWriting();
+        if (writeCompleteCallback_)
+        {
+            writeCompleteCallback_(shared_from_this());
+        }
+        if (status_ == ConnStatus::Disconnecting && writeBufferList_.empty())
+        {
+            socketPtr_->closeWrite();
+        }
+    }
+} // namespace xiao
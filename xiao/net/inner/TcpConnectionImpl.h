@@ -0,0 +1,269 @@
+/**
+ * @file TcpConnectionImpl.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/EventLoop.h>
+#include <xiao/net/TcpConnection.h>
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/utils/TimingWheel.h>
+#include "BufferNode.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+struct iovec;
+
+namespace xiao
+{
+    class Channel;
+    class Socket;
+    class TcpServer;
+
+    class TcpConnectionImpl : public TcpConnection,
+                              public NonCopyable,
+                              public std::enable_shared_from_this<TcpConnectionImpl>
+    {
+        friend class TcpServer;
+        friend class TcpClient;
+        friend class TcpConnectionPool;
+
+    public:
+        TcpConnectionImpl(EventLoop *loop,
+                          int socketfd,
+                          const InetAddress &localAddr,
+                          const InetAddress &peerAddr);
+        ~TcpConnectionImpl() override;
+
+        void send(const char *msg, size_t len) override;
+        void send(const void *msg, size_t len) override;
+        void send(const std::string &msg) override;
+        void send(std::string &&msg) override;
+        void send(const MsgBuffer &buffer) override;
+        void send(MsgBuffer &&buffer) override;
+        void send(const std::shared_ptr<std::string> &msgPtr) override;
+        void send(const std::shared_ptr<MsgBuffer> &msgPtr) override;
+        void sendFile(const char *fileName,
+                      long long offset = 0,
+                      long long length = 0) override;
+        void sendStream(
+            std::function<std::size_t(char *, std::size_t)> callback) override;
+        AsyncStreamPtr sendAsyncStream() override;
+
+        const InetAddress &localAddr() const override
+        {
+            return localAddr_;
+        }
+        const InetAddress &peerAddr() const override
+        {
+            return peerAddr_;
+        }
+        bool connected() const override
+        {
+            return status_ == ConnStatus::Connected;
+        }
+        bool disconnected() const override
+        {
+            return status_ == ConnStatus::Disconnected;
+        }
+        MsgBuffer *getRecvBuffer() override
+        {
+            return &readBuffer_;
+        }
+        void setHighWaterMarkCallback(const HighWaterMarkCallback &cb,
+                                      size_t markLen) override
+        {
+            highWaterMarkCallback_ = cb;
+            highWaterMarkLen_ = markLen;
+        }
+        void setBackpressure(const TcpConnectionPtr &peer,
+                             size_t highMark,
+                             size_t lowMark) override;
+        void stopRecv() override;
+        void startRecv() override;
+        void setTcpNoDelay(bool on) override;
+        bool setZeroCopy(bool on) override;
+        bool sendFds(const char *msg, size_t len, const std::vector<int> &fds) override;
+        void setRecvFds(bool on) override;
+        std::vector<int> takeRecvFds() override;
+        void shutdown() override;
+        void forceClose() override;
+        int detach() override;
+        EventLoop *getLoop() override
+        {
+            return loop_;
+        }
+        size_t bytesSent() const override
+        {
+            return bytesSent_;
+        }
+        size_t bytesReceived() const override
+        {
+            return bytesReceived_;
+        }
+
+        void connectEstablished();
+        void connectDestroyed();
+
+        using OwnerHandler = void (*)(void *owner, const std::shared_ptr<TcpConnectionImpl> &conn);
+
+        /**
+         * @brief Call handler(owner, conn) in the loop of the connection
+         * without allocating, e.g. for the server to establish the connection.
+         * The reference is moved into the task, so the connection is released
+         * in its loop if the call drops the last one. Only one call can be
+         * pending at a time.
+         *
+         */
+        static void queueOwnerTask(std::shared_ptr<TcpConnectionImpl> &&conn,
+                                   OwnerHandler handler,
+                                   void *owner);
+
+        /**
+         * @brief Release the socket and the per-connection state of a
+         * connection returning to a pool, keeping the channel and the capacity
+         * of the read buffer.
+         *
+         * @return false if the connection can't be reused.
+         * @note It must be called in the thread of the loop, the pool deletes
+         * the connections released in other threads instead.
+         */
+        bool recycle();
+
+        /**
+         * @brief Reuse a recycled connection for a new socket.
+         *
+         * @note It is called by the pool in the thread of the acceptor, like
+         * the constructor of a new connection. The connection is not in the
+         * poller and nothing else refers to it, the pool's lock orders it after
+         * recycle() and the loop gets it through queueOwnerTask().
+         */
+        void reuse(int socketfd,
+                   const InetAddress &localAddr,
+                   const InetAddress &peerAddr);
+
+        /**
+         * @brief Append data to an async stream node, in the loop thread.
+         *
+         */
+        void sendAsyncDataInLoop(const BufferNodePtr &node,
+                                 const char *data,
+                                 size_t len);
+        void closeAsyncStreamInLoop(const BufferNodePtr &node);
+
+    protected:
+        enum class ConnStatus
+        {
+            Disconnected,
+            Connecting,
+            Connected,
+            Disconnecting
+        };
+
+        void readCallback();
+        void writeCallback();
+        void handleClose();
+        void handleError();
+
+        // Queue a node (or data) in the send chain, from any thread, keeping
+        // the order of the sends made from different threads.
+        void sendNode(BufferNodePtr &&node);
+        void sendInLoop(const char *buffer, size_t length);
+        void sendNodeInLoop(const BufferNodePtr &node);
+        void addPendingBytes(size_t len);
+        void subPendingBytes(size_t len);
+        void resumePeer();
+        void queueFlush();
+        // Write as much of the send chain as the socket takes, with writev().
+        void flush();
+        // Return true if the write should be retried.
+        bool handleWriteError(int err);
+        // Whether a chunk of the node is sent with MSG_ZEROCOPY.
+        bool useZeroCopy(const BufferNode &node, size_t len) const;
+        ssize_t sendZeroCopy(const BufferNodePtr &node, struct iovec *vec);
+        // Send the first chunk of a node with its fds, with sendmsg().
+        ssize_t sendWithFds(const BufferNodePtr &node, struct iovec *vec);
+        // Read into the receive buffer with recvmsg(), keeping the fds.
+        ssize_t readWithFds(int *savedErrno);
+        void closeRecvFds();
+        // Release the nodes whose zero copy sends are completed, reading the
+        // notifications from the error queue of the socket.
+        void readZeroCopyCompletions();
+        // Keep the nodes of a destroyed connection until their zero copy
+        // sends are completed, polling the error queue, and reset the socket
+        // if they are not completed in time.
+        void waitZeroCopyCompletions(size_t tries);
+        // Close the socket with a reset before the pending zero copy nodes
+        // are released, so the kernel stops sending from their pages.
+        void abortZeroCopySends();
+        // Remove the finished nodes at the front of the chain.
+        bool popFinishedNodes();
+        void afterChainDrained();
+
+        EventLoop *loop_;
+        std::unique_ptr<Channel> ioChannelPtr_;
+        std::unique_ptr<Socket> socketPtr_;
+        MsgBuffer readBuffer_;
+        std::deque<BufferNodePtr> writeBufferList_;
+        InetAddress localAddr_, peerAddr_;
+        ConnStatus status_{ConnStatus::Connecting};
+        size_t highWaterMarkLen_{0};
+        // The bytes of the finite nodes in the send chain.
+        size_t pendingBytes_{0};
+        bool flushQueued_{false};
+        // The number of sends queued from other threads and not yet in the
+        // chain, the sends of the loop thread queue behind them.
+        std::atomic<size_t> sendNum_{0};
+        size_t bytesSent_{0};
+        size_t bytesReceived_{0};
+        // The connection whose reading is stopped while pendingBytes_ is
+        // above the high mark.
+        std::weak_ptr<TcpConnection> backpressurePeer_;
+        size_t peerHighMark_{0};
+        size_t peerLowMark_{0};
+        bool peerThrottled_{false};
+        bool zeroCopy_{false};
+        // The id of the next zero copy send, the kernel counts the sends of
+        // the socket in the same way.
+        uint32_t zeroCopySeq_{0};
+        // The nodes kept until the zero copy sends with the ids are completed.
+        std::deque<std::pair<uint32_t, BufferNodePtr>> zeroCopyPending_;
+        bool recvFdsEnabled_{false};
+        // The fds received and not taken yet.
+        std::vector<int> recvFds_;
+        // Refreshed on reading and writing, when the connection is kicked off
+        // after an idle timeout.
+        TimingWheel::Entry idleEntry_;
+
+        // The task queued by queueOwnerTask(), it keeps the connection until
+        // it runs.
+        class OwnerTask : public LoopTask
+        {
+        public:
+            void run() override
+            {
+                auto conn = std::move(conn_);
+                handler_(owner_, conn);
+            }
+
+            OwnerHandler handler_{nullptr};
+            void *owner_{nullptr};
+            std::shared_ptr<TcpConnectionImpl> conn_;
+        };
+        OwnerTask ownerTask_;
+        // The position of the connection in the list of its owner.
+        size_t ownerSlot_{0};
+    };
+
+    using TcpConnectionImplPtr = std::shared_ptr<TcpConnectionImpl>;
+} // namespace xiao
@@ -0,0 +1,65 @@
+/**
+ * @file Timer.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "Timer.h"
+#include <xiao/net/EventLoop.h>
+
+namespace xiao
+{
+    std::atomic<TimerId> Timer::timersCreated_{InvalidTimerId};
+
+    Timer::Timer(const TimerCallback &cb,
+                 const TimePoint &when,
+                 const TimeInterval &interval)
+        : callback_(cb),
+          when_(when),
+          interval_(interval),
+          repeat_(interval.count() > 0),
+          id_(++timersCreated_)
+    {
+    }
+
+    Timer::Timer(TimerCallback &&cb,
+                 const TimePoint &when,
+                 const TimeInterval &interval)
+        : callback_(std::move(cb)),
+          when_(when),
+          interval_(interval),
+          repeat_(interval.count() > 0),
+          id_(++timersCreated_)
+    {
+    }
+
+    void Timer::run() const
+    {
+        callback_();
+    }
+
+    void Timer::restart(const TimePoint &now)
+    {
+        if (repeat_)
+        {
+            when_ = now + interval_;
+        }
+        else
+            when_ = std::chrono::steady_clock::now();
+    }
+
+    bool Timer::operator<(const Timer &t) const
+    {
+        return when_ < t.when_;
+    }
+
+    bool Timer::operator>(const Timer &t) const
+    {
+        return when_ > t.when_;
+    }
+} // namespace xiao
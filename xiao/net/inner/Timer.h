@@ -0,0 +1,68 @@
+/**
+ * @file Timer.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/net/callbacks.h>
+#include <xiao/utils/NonCopyable.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+namespace xiao
+{
+    using TimerId = uint64_t;
+    using TimePoint = std::chrono::steady_clock::time_point;
+    using TimeInterval = std::chrono::microseconds;
+
+    /**
+     * @brief This class represents a one-shot or repeating timer. It is used
+     * internally by the TimerQueue.
+     *
+     */
+    class Timer : public NonCopyable
+    {
+    public:
+        Timer(const TimerCallback &cb,
+              const TimePoint &when,
+              const TimeInterval &interval);
+        Timer(TimerCallback &&cb,
+              const TimePoint &when,
+              const TimeInterval &interval);
+        ~Timer()
+        {
+        }
+        void run() const;
+        void restart(const TimePoint &now);
+        bool operator<(const Timer &t) const;
+        bool operator>(const Timer &t) const;
+        const TimePoint &when() const
+        {
+            return when_;
+        }
+        bool isRepeat()
+        {
+            return repeat_;
+        }
+        TimerId id()
+        {
+            return id_;
+        }
+
+    private:
+        TimerCallback callback_;
+        TimePoint when_;
+        const TimeInterval interval_;
+        const bool repeat_;
+        const TimerId id_;
+        static std::atomic<TimerId> timersCreated_;
+    };
+} // namespace xiao
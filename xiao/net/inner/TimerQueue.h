@@ -0,0 +1,85 @@
+/**
+ * @file TimerQueue.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/net/callbacks.h>
+#include "Timer.h"
+#include <memory>
+#include <queue>
+#include <unordered_set>
+#include <vector>
+
+namespace xiao
+{
+    class EventLoop;
+    class Channel;
+    using TimerPtr = std::shared_ptr<Timer>;
+    struct TimerPtrComparer
+    {
+        bool operator()(const TimerPtr &x, const TimerPtr &y) const
+        {
+            return *x > *y;
+        }
+    };
+
+    class TimerQueue : NonCopyable
+    {
+    public:
+        explicit TimerQueue(EventLoop *loop);
+        ~TimerQueue();
+        TimerId addTimer(const TimerCallback &cb,
+                         const TimePoint &when,
+                         const TimeInterval &interval);
+        TimerId addTimer(TimerCallback &&cb,
+                         const TimePoint &when,
+                         const TimeInterval &interval);
+        void addTimerInLoop(const TimerPtr &timer);
+        void invalidateTimer(TimerId id);
+#ifdef __linux__
+        void reset();
+#else
+        int64_t getTimeout() const;
+        void processTimers();
+#endif
+
+        /**
+         * @brief Return the number of timer callbacks run so far. This method
+         * must be called in the loop thread.
+         *
+         * @return uint64_t
+         */
+        uint64_t firedCount() const
+        {
+            return firedCount_;
+        }
+
+    protected:
+        EventLoop *loop_;
+#ifdef __linux__
+        int timerfd_;
+        std::shared_ptr<Channel> timerfdChannelPtr_;
+        void handleRead();
+#endif
+        std::priority_queue<TimerPtr, std::vector<TimerPtr>, TimerPtrComparer>
+            timers_;
+
+        bool callingExpiredTimers_;
+        uint64_t firedCount_{0};
+        bool insert(const TimerPtr &timePtr);
+        void runExpired(const std::vector<TimerPtr> &expired);
+        void reset(const std::vector<TimerPtr> &expired, const TimePoint &now);
+        std::vector<TimerPtr> getExpired(const TimePoint &now);
+
+    private:
+        std::unordered_set<uint64_t> timerIdSet_;
+    };
+} // namespace xiao
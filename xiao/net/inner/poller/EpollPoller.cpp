@@ -10,13 +10,18 @@
  */
 
 #include "EpollPoller.h"
+#include "Channel.h"
 #include <xiao/utils/Logger.h>
 
 #ifdef __linux__
-
+#include <poll.h>
+#include <sys/epoll.h>
+#include <unistd.h>
 #elif defined _WIN32
 #include "Wepoll.h"
 #endif
+#include <assert.h>
+#include <string.h>
 
 namespace xiao
 {
@@ -88,11 +93,121 @@ namespace xiao
             if (savedErrno != EINTR)
             {
                 errno = savedErrno;
-                LOG_SY
+                LOG_SYSERR << "EpollPoller::poll()";
+            }
+        }
+    }
+
+    void EpollPoller::fillActiveChannels(int numEvents,
+                                         ChannelList *activeChannels) const
+    {
+        assert(static_cast<size_t>(numEvents) <= events_.size());
+        for (int i = 0; i < numEvents; ++i)
+        {
+            Channel *channel = static_cast<Channel *>(events_[i].data.ptr);
+#ifndef NDEBUG
+            int fd = channel->fd();
+            assert(findChannel(fd) == channel);
+#endif
+            channel->setRevents(events_[i].events);
+            activeChannels->push_back(channel);
+        }
+    }
+
+    void EpollPoller::updateChannel(Channel *channel)
+    {
+        assertInLoopThread();
+        assert(channel->fd() >= 0);
+
+        const int index = channel->index();
+        if (index == xNew || index == xDeleted)
+        {
+            int fd = channel->fd();
+            if (index == xNew)
+            {
+                assert(findChannel(fd) == nullptr);
+                if (static_cast<size_t>(fd) >= channels_.size())
+                    channels_.resize(fd + 1, nullptr);
+                channels_[fd] = channel;
+            }
+            else
+            {
+                assert(findChannel(fd) == channel);
+            }
+            channel->setIndex(xAdded);
+            update(EPOLL_CTL_ADD, channel);
+        }
+        else
+        {
+#ifndef NDEBUG
+            int fd = channel->fd();
+            (void)fd;
+            assert(findChannel(fd) == channel);
+#endif
+            assert(index == xAdded);
+            if (channel->isNoneEvent())
+            {
+                update(EPOLL_CTL_DEL, channel);
+                channel->setIndex(xDeleted);
+            }
+            else
+            {
+                update(EPOLL_CTL_MOD, channel);
+            }
+        }
+    }
+
+    void EpollPoller::removeChannel(Channel *channel)
+    {
+        EpollPoller::assertInLoopThread();
+        int fd = channel->fd();
+        assert(findChannel(fd) == channel);
+        assert(channel->isNoneEvent());
+        channels_[fd] = nullptr;
+        int index = channel->index();
+        assert(index == xAdded || index == xDeleted);
+        if (index == xAdded)
+        {
+            update(EPOLL_CTL_DEL, channel);
+        }
+        channel->setIndex(xNew);
+    }
+
+#ifdef __linux__
+    void EpollPoller::resetAfterFork()
+    {
+        // The epoll instance is shared with the parent process, changing it
+        // here would change the parent's interest list too.
+        ::close(epollfd_);
+        epollfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        for (auto channel : channels_)
+        {
+            if (channel && channel->index() == xAdded)
+            {
+                update(EPOLL_CTL_ADD, channel);
             }
         }
     }
-#else
 #endif
+
+    void EpollPoller::update(int operation, Channel *channel)
+    {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = channel->events();
+        event.data.ptr = channel;
+        int fd = channel->fd();
+        if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
+        {
+            if (operation == EPOLL_CTL_DEL)
+            {
+                LOG_SYSERR << "epoll_ctl op = EPOLL_CTL_DEL fd = " << fd;
+            }
+            else
+            {
+                LOG_SYSERR << "epoll_ctl op = " << operation << " fd = " << fd;
+            }
+        }
+    }
 #endif
 } // namespace xiao
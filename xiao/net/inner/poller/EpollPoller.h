@@ -15,7 +15,7 @@
 
 #if defined __linux__ || defined _WIN32
 #include <memory>
-#include <map>
+#include <vector>
 using EventList = std::vector<struct epoll_event>;
 #endif
 
@@ -30,6 +30,9 @@ namespace xiao
         virtual void poll(int timeoutMs, ChannelList *activeChannels) override;
         virtual void updateChannel(Channel *channel) override;
         virtual void removeChannel(Channel *channel) override;
+#ifdef __linux__
+        virtual void resetAfterFork() override;
+#endif
 
 #ifdef _WIN32
         virtual void postEvent(uint64_t event) override;
@@ -50,10 +53,17 @@ namespace xiao
 #endif
         EventList events_;
         void update(int operation, Channel *channel);
-#ifndef NDEBUG
-        using ChannelMap = std::map<int, Channel *>;
-        ChannelMap channels_;
-#endif
+        // All the channels added to the poller indexed by fd, they are
+        // registered again in a new epoll instance after fork(). A table
+        // instead of a map, so adding a channel does not allocate once the
+        // table covers the fds in use.
+        using ChannelTable = std::vector<Channel *>;
+        ChannelTable channels_;
+        Channel *findChannel(int fd) const
+        {
+            return static_cast<size_t>(fd) < channels_.size() ? channels_[fd]
+                                                             : nullptr;
+        }
         void fillActiveChannels(int numEvents, ChannelList *activeChannels) const;
 #endif
     };
@@ -0,0 +1,247 @@
+/**
+ * @file AcceptLimitTest.cpp
+ * @author xiao guo
+ * @brief Connect to a server out of file descriptors: the connections beyond
+ * the limit are dropped with the reserved fd, or accepting is paused when
+ * there is none, the loop doesn't spin, and the connections are accepted
+ * again once some fds are freed.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopThread.h>
+#include <xiao/net/TcpServer.h>
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <vector>
+
+using namespace xiao;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok)
+        ++failures;
+}
+
+template <typename F>
+static auto runIn(EventLoop *loop, F f) -> decltype(f())
+{
+    std::promise<decltype(f())> done;
+    loop->runInLoop([&]() { done.set_value(f()); });
+    return done.get_future().get();
+}
+
+static int maxOpenFd()
+{
+    int maxFd = -1;
+    auto dir = ::opendir("/proc/self/fd");
+    if (!dir)
+        return -1;
+    while (auto entry = ::readdir(dir))
+        maxFd = (std::max)(maxFd, atoi(entry->d_name));
+    ::closedir(dir);
+    return maxFd;
+}
+
+static double cpuSeconds()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Lower the limit of fds and take all the free ones but the given number,
+// the fds taken are returned.
+static std::vector<int> leaveFree(int count)
+{
+    struct rlimit limit;
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = maxOpenFd() + 64;
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+    std::vector<int> taken;
+    int fd;
+    while ((fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC)) >= 0)
+        taken.push_back(fd);
+    for (int i = 0; i < count && !taken.empty(); ++i)
+    {
+        ::close(taken.back());
+        taken.pop_back();
+    }
+    return taken;
+}
+
+static void release(std::vector<int> &fds, size_t count)
+{
+    for (size_t i = 0; i < count && !fds.empty(); ++i)
+    {
+        ::close(fds.back());
+        fds.pop_back();
+    }
+}
+
+// The sockets are created before the fds run out.
+static std::vector<int> sockets(size_t count)
+{
+    std::vector<int> fds;
+    for (size_t i = 0; i < count; ++i)
+        fds.push_back(::socket(AF_INET, SOCK_STREAM, 0));
+    return fds;
+}
+
+static bool connectTo(int fd, uint16_t port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return ::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+}
+
+// Whether the server dropped the connection.
+static bool dropped(int fd)
+{
+    struct pollfd pfd = {fd, POLLIN, 0};
+    char c;
+    return ::poll(&pfd, 1, 500) == 1 && ::recv(fd, &c, 1, MSG_DONTWAIT) <= 0;
+}
+
+struct Server
+{
+    explicit Server(EventLoop *loop) : loop_(loop)
+    {
+        runIn(loop, [this]() {
+            server_.reset(
+                new TcpServer(loop_, InetAddress("127.0.0.1", 0), "limit", true, false));
+            server_->setConnectionCallback([this](const TcpConnectionPtr &conn) {
+                if (conn->connected())
+                {
+                    ++accepted_;
+                    conns_.push_back(conn);
+                }
+            });
+            server_->start();
+            return 0;
+        });
+    }
+    ~Server()
+    {
+        runIn(loop_, [this]() {
+            closeAll();
+            server_.reset();
+            return 0;
+        });
+    }
+    uint16_t port() const
+    {
+        return server_->address().toPort();
+    }
+    // Close the connections accepted, in the loop thread.
+    void closeAll()
+    {
+        for (auto &conn : conns_)
+            conn->forceClose();
+        conns_.clear();
+    }
+    bool waitAccepted(int count)
+    {
+        for (int i = 0; i < 100 && accepted_ < count; ++i)
+            ::usleep(10000);
+        return accepted_ == count;
+    }
+
+    EventLoop *loop_;
+    std::unique_ptr<TcpServer> server_;
+    std::vector<TcpConnectionPtr> conns_;
+    std::atomic<int> accepted_{0};
+};
+
+int main()
+{
+    struct rlimit saved;
+    ::getrlimit(RLIMIT_NOFILE, &saved);
+    EventLoopThread loopThread("limit");
+    loopThread.run();
+    auto loop = loopThread.getLoop();
+
+    // Three fds free: three connections are accepted, the other ones are
+    // dropped with the reserved fd rather than left in the backlog.
+    {
+        Server server(loop);
+        auto clients = sockets(10);
+        auto spare = sockets(1);
+        auto taken = leaveFree(3);
+        for (auto fd : clients)
+            connectTo(fd, server.port());
+        check(server.waitAccepted(3), "accept up to the limit");
+        int shed = 0;
+        for (auto fd : clients)
+            if (dropped(fd))
+                ++shed;
+        check(shed == 7, "drop the connections beyond the limit");
+        auto cpu = cpuSeconds();
+        ::usleep(300000);
+        check(cpuSeconds() - cpu < 0.1, "don't spin while out of fds");
+
+        // The fds of the connections closed are accepted again.
+        runIn(loop, [&]() {
+            server.closeAll();
+            return 0;
+        });
+        // The sockets are closed when the connections are destroyed, queued
+        // after the close.
+        runIn(loop, []() { return 0; });
+        connectTo(spare[0], server.port());
+        check(server.waitAccepted(4) && !dropped(spare[0]),
+              "accept again once the fds are freed");
+        release(taken, taken.size());
+        ::setrlimit(RLIMIT_NOFILE, &saved);
+        for (auto fd : clients)
+            ::close(fd);
+        ::close(spare[0]);
+    }
+
+    // One fd free: the listening socket takes it and no fd is reserved, the
+    // pending connections keep the socket readable and accepting is paused.
+    {
+        auto clients = sockets(3);
+        auto taken = leaveFree(1);
+        Server server(loop);
+        for (auto fd : clients)
+            connectTo(fd, server.port());
+        auto cpu = cpuSeconds();
+        ::usleep(300000);
+        check(cpuSeconds() - cpu < 0.1 && server.accepted_ == 0,
+              "pause accepting without a reserved fd");
+        release(taken, 3);
+        check(server.waitAccepted(3), "resume accepting once the fds are freed");
+        bool kept = true;
+        for (auto fd : clients)
+            kept = kept && !dropped(fd);
+        check(kept, "keep the connections accepted after the pause");
+        release(taken, taken.size());
+        ::setrlimit(RLIMIT_NOFILE, &saved);
+        for (auto fd : clients)
+            ::close(fd);
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file ConnectionChurnBench.cpp
+ * @author xiao guo
+ * @brief Measure the connections a TcpServer accepts and closes per second
+ * under short-lived connections, and the heap allocations per connection,
+ * which drop once the connection pools of the I/O loops are warmed up. It is
+ * measured twice: the server shuts each connection down at once, which
+ * measures accept and close only, then sends a byte before, which adds the
+ * send chain.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopThread.h>
+#include <xiao/net/TcpServer.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace xiao;
+using Clock = std::chrono::steady_clock;
+
+static const int xClientThreads = 4;
+static const size_t xIoLoops = 2;
+static const double xWarmUpSeconds = 1.0;
+static const double xRunSeconds = 3.0;
+
+static std::atomic<uint64_t> allocations{0};
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// Connect and close as fast as possible. On the loopback the ports in
+// TIME_WAIT are reused by connect() (net.ipv4.tcp_tw_reuse).
+static void churn(uint16_t port, const std::atomic<bool> *stop)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    while (!stop->load(std::memory_order_relaxed))
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            continue;
+        if (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+        {
+            // Wait for the server to see the connection and shut it down,
+            // after the byte it may send, before closing it.
+            char c;
+            while (::recv(fd, &c, 1, 0) > 0)
+                ;
+        }
+        ::close(fd);
+    }
+}
+
+struct Sample
+{
+    double connsPerSecond;
+    double allocsPerConn;
+};
+
+static Sample measure(const std::atomic<uint64_t> &closed)
+{
+    std::this_thread::sleep_for(std::chrono::duration<double>(xWarmUpSeconds));
+    uint64_t closedBefore = closed.load();
+    uint64_t allocsBefore = allocations.load();
+    auto start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(xRunSeconds));
+    uint64_t conns = closed.load() - closedBefore;
+    uint64_t allocs = allocations.load() - allocsBefore;
+    auto secs = std::chrono::duration<double>(Clock::now() - start).count();
+    return Sample{conns / secs,
+                  conns > 0 ? static_cast<double>(allocs) / conns : 0.0};
+}
+
+static void report(const char *variant, const Sample &sample)
+{
+    printf("%s: %.0f connects and closes per second, "
+           "%.1f heap allocations per connection\n",
+           variant,
+           sample.connsPerSecond,
+           sample.allocsPerConn);
+}
+
+int main()
+{
+    EventLoopThread loopThread;
+    loopThread.run();
+    std::atomic<uint64_t> closed{0};
+    std::atomic<bool> sending{false};
+    TcpServer server(loopThread.getLoop(),
+                     InetAddress("127.0.0.1", 0),
+                     "churn");
+    server.setIoLoopNum(xIoLoops);
+    server.setConnectionCallback([&closed, &sending](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            if (sending.load(std::memory_order_relaxed))
+                conn->send("x", 1);
+            conn->shutdown();
+        }
+        else
+        {
+            closed.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    server.start();
+
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> clients;
+    for (int i = 0; i < xClientThreads; ++i)
+        clients.emplace_back(churn, server.address().toPort(), &stop);
+
+    auto shutdownOnly = measure(closed);
+    sending = true;
+    auto withSend = measure(closed);
+
+    stop = true;
+    for (auto &t : clients)
+        t.join();
+    server.stop();
+
+    printf("%d client threads, %zu I/O loops\n", xClientThreads, xIoLoops);
+    report("shutdown", shutdownOnly);
+    report("send(\"x\") and shutdown", withSend);
+    return 0;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file ConnectionPoolTest.cpp
+ * @author xiao guo
+ * @brief Borrow connections to a loopback server: reuse after release, the
+ * waiters beyond maxSize, an idle connection closed by the server, and the
+ * eviction down to minSize.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopThread.h>
+#include <xiao/net/TcpConnectionPool.h>
+#include <xiao/net/TcpServer.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <vector>
+
+using namespace xiao;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok)
+        ++failures;
+}
+
+template <typename F>
+static auto runIn(EventLoop *loop, F f) -> decltype(f())
+{
+    std::promise<decltype(f())> done;
+    loop->runInLoop([&]() { done.set_value(f()); });
+    return done.get_future().get();
+}
+
+using ConnFuture = std::future<TcpConnectionPtr>;
+
+static ConnFuture acquire(EventLoop *loop,
+                          const TcpConnectionPoolPtr &pool,
+                          const InetAddress &addr)
+{
+    auto lent = std::make_shared<std::promise<TcpConnectionPtr>>();
+    auto future = lent->get_future();
+    loop->runInLoop([pool, addr, lent]() {
+        pool->acquire(addr, [lent](const TcpConnectionPtr &conn) { lent->set_value(conn); });
+    });
+    return future;
+}
+
+static TcpConnectionPtr get(ConnFuture &future)
+{
+    if (future.wait_for(std::chrono::seconds(2)) != std::future_status::ready)
+        return nullptr;
+    return future.get();
+}
+
+// The release is queued in the loop, the function after it sees it done.
+static void release(EventLoop *loop,
+                    const TcpConnectionPoolPtr &pool,
+                    const TcpConnectionPtr &conn)
+{
+    runIn(loop, [&]() {
+        pool->release(conn);
+        return 0;
+    });
+}
+
+// Wait until the pool has the given number of connections and idle ones.
+static bool waitFor(EventLoop *loop,
+                    const TcpConnectionPoolPtr &pool,
+                    const InetAddress &addr,
+                    size_t size,
+                    size_t idle)
+{
+    for (int i = 0; i < 200; ++i)
+    {
+        if (runIn(loop, [&]() {
+                return pool->size(addr) == size && pool->idleCount(addr) == idle;
+            }))
+            return true;
+        ::usleep(10000);
+    }
+    return false;
+}
+
+int main()
+{
+    EventLoopThread serverThread("server");
+    serverThread.run();
+    auto serverLoop = serverThread.getLoop();
+    std::unique_ptr<TcpServer> server;
+    std::vector<TcpConnectionPtr> serverConns;
+    std::atomic<int> accepted{0};
+    auto port = runIn(serverLoop, [&]() {
+        server.reset(
+            new TcpServer(serverLoop, InetAddress("127.0.0.1", 0), "pool", true, false));
+        server->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                ++accepted;
+                serverConns.push_back(conn);
+            }
+        });
+        server->start();
+        return server->address().toPort();
+    });
+    InetAddress addr("127.0.0.1", port);
+
+    EventLoopThread poolThread("pool");
+    poolThread.run();
+    auto loop = poolThread.getLoop();
+    auto pool = runIn(loop, [loop]() {
+        return std::make_shared<TcpConnectionPool>(loop, 0, 2, 60.0);
+    });
+
+    // A released connection is lent again.
+    auto future = acquire(loop, pool, addr);
+    auto first = get(future);
+    check(first && first->connected(), "connect for the first request");
+    release(loop, pool, first);
+    check(runIn(loop, [&]() { return pool->idleCount(addr); }) == 1,
+          "keep the released connection idle");
+    future = acquire(loop, pool, addr);
+    check(get(future) == first, "lend the idle connection again");
+
+    // The third request waits for one of the two connections.
+    future = acquire(loop, pool, addr);
+    auto second = get(future);
+    check(second && second != first, "connect for the second request");
+    auto waiting = acquire(loop, pool, addr);
+    check(waiting.wait_for(std::chrono::milliseconds(100)) == std::future_status::timeout,
+          "wait beyond maxSize");
+    check(runIn(loop, [&]() { return pool->size(addr); }) == 2, "connect maxSize at most");
+    release(loop, pool, second);
+    check(get(waiting) == second, "lend the released connection to the waiter");
+    release(loop, pool, first);
+    release(loop, pool, second);
+
+    // The server closes the idle connections, the pool is asked before its
+    // loop reads the end of the streams, the peek finds them closed.
+    auto fresh = runIn(loop, [&]() {
+        runIn(serverLoop, [&]() {
+            for (auto &conn : serverConns)
+                conn->forceClose();
+            serverConns.clear();
+            return 0;
+        });
+        ::usleep(50000);
+        auto lent = std::make_shared<std::promise<TcpConnectionPtr>>();
+        auto result = lent->get_future();
+        pool->acquire(addr, [lent](const TcpConnectionPtr &conn) { lent->set_value(conn); });
+        return result;
+    });
+    auto third = get(fresh);
+    check(third && third != first && third != second && third->connected(),
+          "connect again instead of lending a closed connection");
+    release(loop, pool, third);
+    check(waitFor(loop, pool, addr, 1, 1), "drop the closed connections");
+
+    // Three idle connections age out down to minSize, without connecting again.
+    auto evictPool = runIn(loop, [loop]() {
+        return std::make_shared<TcpConnectionPool>(loop, 1, 3, 0.2);
+    });
+    std::vector<ConnFuture> futures;
+    for (int i = 0; i < 3; ++i)
+        futures.push_back(acquire(loop, evictPool, addr));
+    std::vector<TcpConnectionPtr> conns;
+    for (auto &f : futures)
+        conns.push_back(get(f));
+    int acceptedBefore = accepted;
+    for (auto &conn : conns)
+        release(loop, evictPool, conn);
+    check(waitFor(loop, evictPool, addr, 1, 1), "evict the idle connections beyond minSize");
+    ::usleep(300000);
+    check(accepted == acceptedBefore && waitFor(loop, evictPool, addr, 1, 1),
+          "keep minSize connections");
+
+    conns.clear();
+    runIn(loop, [&]() {
+        pool.reset();
+        evictPool.reset();
+        return 0;
+    });
+    runIn(serverLoop, [&]() {
+        serverConns.clear();
+        server.reset();
+        return 0;
+    });
+    return failures == 0 ? 0 : 1;
+}
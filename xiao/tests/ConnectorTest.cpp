@@ -0,0 +1,244 @@
+/**
+ * @file ConnectorTest.cpp
+ * @author xiao guo
+ * @brief Race the addresses of a server: the families interleaved, the next
+ * address tried after the attempt delay while a connect() hangs or at once
+ * when it fails, the first success kept and the other attempts closed.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopThread.h>
+#include <xiao/net/TcpClient.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <vector>
+
+using namespace xiao;
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok)
+        ++failures;
+}
+
+template <typename F>
+static auto runIn(EventLoop *loop, F f) -> decltype(f())
+{
+    std::promise<decltype(f())> done;
+    loop->runInLoop([&]() { done.set_value(f()); });
+    return done.get_future().get();
+}
+
+static int openFds()
+{
+    int count = 0;
+    auto dir = ::opendir("/proc/self/fd");
+    if (!dir)
+        return -1;
+    while (::readdir(dir))
+        ++count;
+    ::closedir(dir);
+    return count;
+}
+
+static uint16_t portOf(int fd)
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    ::getsockname(fd, (struct sockaddr *)&addr, &len);
+    if (addr.ss_family == AF_INET6)
+        return ntohs(((struct sockaddr_in6 *)&addr)->sin6_port);
+    return ntohs(((struct sockaddr_in *)&addr)->sin_port);
+}
+
+// A loopback listener, never accepting. The kernel completes the handshakes
+// until the backlog is full.
+static int listenOn(bool ipv6, int backlog)
+{
+    InetAddress addr(0, true, ipv6);
+    int fd = ::socket(addr.family(), SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (::bind(fd, addr.getSockAddr(), addr.getSockAddrLen()) < 0 ||
+        ::listen(fd, backlog) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// A listener whose SYNs are dropped: its backlog is filled by connections
+// that are never accepted, a connect() to it hangs.
+struct BlackHole
+{
+    BlackHole()
+    {
+        fd = listenOn(false, 0);
+        if (fd < 0)
+            return;
+        for (int i = 0; i < 3; ++i)
+        {
+            int filler = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            InetAddress addr("127.0.0.1", portOf(fd));
+            ::connect(filler, addr.getSockAddr(), addr.getSockAddrLen());
+            fillers.push_back(filler);
+        }
+        // Let the handshakes fill the backlog.
+        ::usleep(100000);
+    }
+    ~BlackHole()
+    {
+        for (auto filler : fillers)
+            ::close(filler);
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    int fd{-1};
+    std::vector<int> fillers;
+};
+
+struct Attempt
+{
+    int family;
+    Clock::time_point startedAt;
+};
+
+// What a client racing the addresses did until it connected.
+struct Race
+{
+    std::vector<Attempt> attempts;
+    bool connected{false};
+    InetAddress serverAddr;
+    uint16_t peerPort{0};
+    int fdsBefore{0};
+    int fdsConnected{0};
+};
+
+static Race race(EventLoop *loop, const std::vector<InetAddress> &addrs)
+{
+    Race result;
+    // Counted in the loop, after the connection of a previous race is closed.
+    result.fdsBefore = runIn(loop, openFds);
+    std::promise<void> connected;
+    auto client = runIn(loop, [&]() {
+        auto client = std::make_shared<TcpClient>(loop, addrs, "race");
+        client->setSockOptCallback([&result](int sockfd) {
+            int family = 0;
+            socklen_t len = sizeof(family);
+            ::getsockopt(sockfd, SOL_SOCKET, SO_DOMAIN, &family, &len);
+            result.attempts.push_back(Attempt{family, Clock::now()});
+        });
+        client->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+            if (!conn->connected())
+                return;
+            result.peerPort = conn->peerAddr().toPort();
+            result.fdsConnected = openFds();
+            connected.set_value();
+        });
+        client->connect();
+        return client;
+    });
+    result.connected = connected.get_future().wait_for(std::chrono::seconds(3)) ==
+                       std::future_status::ready;
+    runIn(loop, [&]() {
+        result.serverAddr = client->serverAddress();
+        client.reset();
+        return 0;
+    });
+    return result;
+}
+
+static double secondsBetween(const Attempt &first, const Attempt &second)
+{
+    return std::chrono::duration<double>(second.startedAt - first.startedAt).count();
+}
+
+int main()
+{
+    EventLoopThread loopThread("connector");
+    loopThread.run();
+    auto loop = loopThread.getLoop();
+
+    BlackHole hole;
+    int listener4 = listenOn(false, 16);
+    int listener6 = listenOn(true, 16);
+    if (hole.fd < 0 || listener4 < 0)
+    {
+        check(false, "listen on the loopback");
+        return 1;
+    }
+    // The attempt to the black hole must hang for the attempt delay to show.
+    int probe = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    InetAddress holeAddr("127.0.0.1", portOf(hole.fd));
+    ::connect(probe, holeAddr.getSockAddr(), holeAddr.getSockAddrLen());
+    ::usleep(300000);
+    int err = 0;
+    socklen_t errLen = sizeof(err);
+    ::getsockopt(probe, SOL_SOCKET, SO_ERROR, &err, &errLen);
+    struct sockaddr_in peer;
+    socklen_t peerLen = sizeof(peer);
+    bool hangs = err == 0 && ::getpeername(probe, (struct sockaddr *)&peer, &peerLen) < 0;
+    ::close(probe);
+    if (!hangs)
+    {
+        check(false, "hang a connect() to a full backlog");
+        return 1;
+    }
+
+    // The black hole first, then a listener of each family. The IPv6 one is
+    // tried second, after the attempt delay, and wins; the IPv4 listener is
+    // never tried.
+    std::vector<InetAddress> addrs{holeAddr, InetAddress("127.0.0.1", portOf(listener4))};
+    if (listener6 >= 0)
+        addrs.push_back(InetAddress("::1", portOf(listener6), true));
+    else
+        printf("skipped: no IPv6 loopback, the families are not interleaved\n");
+    auto slow = race(loop, addrs);
+    auto winner = listener6 >= 0 ? listener6 : listener4;
+    check(slow.connected && slow.peerPort == portOf(winner) &&
+              slow.serverAddr.toPort() == portOf(winner),
+          "connect to the second address tried");
+    if (listener6 >= 0)
+        check(slow.attempts.size() == 2 && slow.attempts[0].family == AF_INET &&
+                  slow.attempts[1].family == AF_INET6,
+              "interleave the families");
+    auto delay = slow.attempts.size() == 2 ? secondsBetween(slow.attempts[0], slow.attempts[1])
+                                           : 0.0;
+    check(delay >= 0.2 && delay < 0.45, "try the next address after the attempt delay");
+    // Only the connection is left open, the attempt to the black hole is
+    // closed.
+    check(slow.fdsConnected == slow.fdsBefore + 1, "close the attempts that lost");
+
+    // A refused connect() starts the next attempt without waiting.
+    int refused = listenOn(false, 16);
+    auto refusedPort = portOf(refused);
+    ::close(refused);
+    auto fast = race(loop,
+                     {InetAddress("127.0.0.1", refusedPort),
+                      InetAddress("127.0.0.1", portOf(listener4))});
+    check(fast.connected && fast.peerPort == portOf(listener4) && fast.attempts.size() == 2 &&
+              secondsBetween(fast.attempts[0], fast.attempts[1]) < 0.1,
+          "try the next address at once when one fails");
+    check(fast.fdsConnected == fast.fdsBefore + 1, "close the failed attempt");
+
+    ::close(listener4);
+    if (listener6 >= 0)
+        ::close(listener6);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file CoroutineTest.cpp
+ * @author xiao guo
+ * @brief Build the coroutines as C++20 and run a task which sleeps, waits for
+ * a pipe to be readable, and moves to another loop and back. Then destroy a
+ * task waiting for the pipe, and one whose resumption is pending, and check
+ * the pipe can be awaited again.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/Coroutine.h>
+#include <xiao/net/Channel.h>
+#include <xiao/net/EventLoopThread.h>
+#include <chrono>
+#include <cstdio>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace xiao;
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok)
+        ++failures;
+}
+
+static Task<int> readByte(EventLoop *loop, int fd)
+{
+    int revents = co_await readable(loop, fd);
+    check(revents & POLLIN, "resume when the pipe is readable");
+    char c = 0;
+    if (::read(fd, &c, 1) != 1)
+        co_return -1;
+    co_return c;
+}
+
+static Task<> run(EventLoop *loop, EventLoop *other, int fds[2])
+{
+    auto start = Clock::now();
+    co_await sleepFor(loop, 0.05);
+    check(Clock::now() - start >= std::chrono::milliseconds(40), "sleep");
+    check(loop->isInLoopThread(), "resume the sleep in the loop");
+
+    loop->runAfter(0.01, [fds]() {
+        if (::write(fds[1], "x", 1) != 1)
+            perror("write");
+    });
+    int c = co_await readByte(loop, fds[0]);
+    check(c == 'x', "await a task returning a value");
+
+    co_await switchTo(other);
+    check(other->isInLoopThread(), "switch to another loop");
+    co_await switchTo(loop);
+    check(loop->isInLoopThread(), "switch back");
+    loop->quit();
+}
+
+static Task<> waitByte(EventLoop *loop, int fd, bool *resumed)
+{
+    co_await readable(loop, fd);
+    *resumed = true;
+}
+
+static Task<> readAgain(EventLoop *loop, int fd, int *c)
+{
+    *c = co_await readByte(loop, fd);
+    loop->quit();
+}
+
+int main()
+{
+    EventLoop loop;
+    EventLoopThread otherThread("other");
+    otherThread.run();
+    int fds[2];
+    if (::pipe(fds) < 0)
+    {
+        perror("pipe");
+        return 1;
+    }
+    spawn(&loop, run(&loop, otherThread.getLoop(), fds));
+    // Don't wait forever if a coroutine is never resumed.
+    bool timedOut = false;
+    loop.runAfter(5.0, [&]() {
+        timedOut = true;
+        loop.quit();
+    });
+    loop.loop();
+    check(!timedOut, "finish the task");
+
+    // Destroyed while it waits, the channel must leave the poller, or the
+    // next awaiter of the pipe would find it there.
+    bool resumed = false;
+    auto waiting = waitByte(&loop, fds[0], &resumed).detach();
+    waiting.resume();
+    waiting.destroy();
+
+    // Destroyed after the pipe became readable, before the end of the
+    // iteration: the other pipe is readable in the same iteration, and its
+    // callback queues the destruction, which runs before the hooks.
+    auto pending = waitByte(&loop, fds[0], &resumed).detach();
+    pending.resume();
+    int others[2];
+    if (::pipe(others) < 0)
+    {
+        perror("pipe");
+        return 1;
+    }
+    Channel otherChannel(&loop, others[0]);
+    otherChannel.setReadCallback([&]() {
+        char c;
+        if (::read(others[0], &c, 1) != 1)
+            perror("read");
+        otherChannel.disableAll();
+        loop.queueInLoop([&]() { pending.destroy(); });
+    });
+    otherChannel.enableReading();
+    loop.runAfter(0.01, [&]() {
+        if (::write(fds[1], "y", 1) != 1 || ::write(others[1], "y", 1) != 1)
+            perror("write");
+    });
+    int c = 0;
+    loop.runAfter(0.1, [&]() { spawn(&loop, readAgain(&loop, fds[0], &c)); });
+    loop.loop();
+    check(!timedOut, "finish the destruction tasks");
+    check(!resumed, "don't resume a destroyed task");
+    check(c == 'y', "await the pipe again after destroying its waiters");
+    otherChannel.remove();
+    ::close(others[0]);
+    ::close(others[1]);
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return failures == 0 ? 0 : 1;
+}
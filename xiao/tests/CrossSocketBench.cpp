@@ -0,0 +1,124 @@
+/**
+ * @file CrossSocketBench.cpp
+ * @author xiao guo
+ * @brief Compare two pinned event loops on the same NUMA node and on
+ * different nodes: the latency of a queueInLoop() ping-pong between them and
+ * the bandwidth of reading memory first touched by the other loop.
+ * @version 0.1
+ * @date 2024-05-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopThreadPool.h>
+#include <xiao/utils/CpuAffinity.h>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <vector>
+
+using namespace xiao;
+using Clock = std::chrono::steady_clock;
+
+static const int xRoundTrips = 200000;
+static const size_t xBufferSize = 256 * 1024 * 1024;
+
+static void ping(EventLoop *self, EventLoop *peer, int left, std::promise<void> *done)
+{
+    if (left == 0)
+    {
+        done->set_value();
+        return;
+    }
+    peer->queueInLoop([peer, self, left, done]()
+                      { ping(peer, self, left - 1, done); });
+}
+
+static double pingPongNs(EventLoop *a, EventLoop *b)
+{
+    std::promise<void> done;
+    auto start = Clock::now();
+    a->queueInLoop([a, b, &done]()
+                   { ping(a, b, xRoundTrips * 2, &done); });
+    done.get_future().wait();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+    return static_cast<double>(ns.count()) / xRoundTrips;
+}
+
+static double readGBps(EventLoop *reader, const std::vector<uint64_t> &buffer)
+{
+    std::promise<double> result;
+    reader->queueInLoop([&buffer, &result]()
+                        {
+        uint64_t sum = 0;
+        auto start = Clock::now();
+        for (int pass = 0; pass < 4; ++pass)
+        {
+            for (auto v : buffer)
+                sum += v;
+        }
+        auto secs = std::chrono::duration<double>(Clock::now() - start).count();
+        // keep the sum alive
+        if (sum == 1)
+            printf(" ");
+        result.set_value(4.0 * buffer.size() * sizeof(uint64_t) / secs / 1e9); });
+    return result.get_future().get();
+}
+
+static void run(const char *label, int cpuA, int cpuB)
+{
+    EventLoopThreadPool pool(2, "bench", CpuPlacement::xExplicit, {cpuA, cpuB});
+    pool.start();
+    auto *a = pool.getLoop(0);
+    auto *b = pool.getLoop(1);
+
+    double latency = pingPongNs(a, b);
+
+    // The buffer is first touched, hence placed, by the loop on cpuA.
+    std::vector<uint64_t> *buffer = nullptr;
+    std::promise<void> allocated;
+    a->queueInLoop([&buffer, &allocated]()
+                   {
+        buffer = new std::vector<uint64_t>(xBufferSize / sizeof(uint64_t), 1);
+        allocated.set_value(); });
+    allocated.get_future().wait();
+    double local = readGBps(a, *buffer);
+    double remote = readGBps(b, *buffer);
+    delete buffer;
+
+    printf("%-10s cpus %3d <-> %-3d  round trip %8.0f ns  "
+           "read own memory %6.2f GB/s  read peer memory %6.2f GB/s\n",
+           label,
+           cpuA,
+           cpuB,
+           latency,
+           local,
+           remote);
+    a->quit();
+    b->quit();
+    pool.wait();
+}
+
+int main()
+{
+    auto nodes = utils::numaNodeCpus();
+    printf("%zu NUMA node(s) with CPUs\n", nodes.size());
+    if (nodes[0].size() >= 2)
+    {
+        run("same node", nodes[0][0], nodes[0][1]);
+    }
+    if (nodes.size() >= 2)
+    {
+        run("cross node", nodes[0][0], nodes[1][0]);
+    }
+    else
+    {
+        printf("only one NUMA node, the cross node case is skipped\n");
+    }
+    if (nodes[0].size() < 2 && nodes.size() < 2)
+    {
+        run("same cpu", nodes[0][0], nodes[0][0]);
+    }
+    return 0;
+}
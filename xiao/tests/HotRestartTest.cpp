@@ -0,0 +1,175 @@
+/**
+ * @file HotRestartTest.cpp
+ * @author xiao guo
+ * @brief Hand a listening socket and an idle connection over from one server
+ * to another, and check the connection is served by the new server only.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopThread.h>
+#include <xiao/net/HotRestart.h>
+#include <xiao/net/TcpServer.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+
+using namespace xiao;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok)
+        ++failures;
+}
+
+// Connect a blocking socket with a receive timeout.
+static int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct timeval tv = {2, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Send the message and return the reply, empty on timeout.
+static std::string request(int fd, const std::string &msg)
+{
+    if (::send(fd, msg.data(), msg.size(), MSG_NOSIGNAL) !=
+        static_cast<ssize_t>(msg.size()))
+        return std::string();
+    char buf[64];
+    ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+    return n > 0 ? std::string(buf, n) : std::string();
+}
+
+// Reply with the tag and the message.
+static void serve(TcpServer &server, const std::string &tag)
+{
+    server.setRecvMessageCallback(
+        [tag](const TcpConnectionPtr &conn, MsgBuffer *buf) {
+            conn->send(tag + std::string(buf->peek(), buf->readableBytes()));
+            buf->retrieveAll();
+        });
+}
+
+template <typename F>
+static auto runIn(EventLoop *loop, F f) -> decltype(f())
+{
+    std::promise<decltype(f())> done;
+    loop->runInLoop([&]() { done.set_value(f()); });
+    return done.get_future().get();
+}
+
+int main()
+{
+    char dir[] = "/tmp/xiao_restart_XXXXXX";
+    if (!::mkdtemp(dir))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string path = std::string(dir) + "/restart.sock";
+
+    EventLoopThread oldThread("old");
+    oldThread.run();
+    auto oldLoop = oldThread.getLoop();
+    std::unique_ptr<TcpServer> oldServer;
+    std::unique_ptr<HotRestart> restart;
+    std::atomic<bool> drained{false};
+    auto port = runIn(oldLoop, [&]() {
+        oldServer.reset(
+            new TcpServer(oldLoop, InetAddress("127.0.0.1", 0), "old", true, false));
+        serve(*oldServer, "old:");
+        oldServer->start();
+        restart.reset(new HotRestart(oldLoop, path));
+        int listenFd = oldServer->listenFd();
+        restart->setFdsCallback([listenFd]() {
+            return std::vector<InheritedFd>{{"listen", listenFd}};
+        });
+        restart->setConnectionsCallback(
+            [&]() { return oldServer->detachIdleConnections(); });
+        restart->setDrainCallback([&]() {
+            drained = true;
+            oldServer->stop();
+        });
+        restart->start();
+        return oldServer->address().toPort();
+    });
+
+    int client = connectTo(port);
+    check(client >= 0 && request(client, "a") == "old:a", "serve in the old server");
+
+    auto fds = HotRestart::takeOver(path);
+    check(fds.size() == 2, "receive the listener and the connection");
+
+    EventLoopThread newThread("new");
+    newThread.run();
+    auto newLoop = newThread.getLoop();
+    std::unique_ptr<TcpServer> newServer;
+    auto adopted = runIn(newLoop, [&]() {
+        newServer = HotRestart::adoptListener(newLoop, fds, "listen", "new");
+        if (!newServer)
+            return size_t(0);
+        serve(*newServer, "new:");
+        newServer->start();
+        return HotRestart::adoptConnections(newServer.get(), fds);
+    });
+    check(newServer != nullptr, "adopt the listener");
+    check(adopted == 1 && fds.size() == 1, "adopt the connection");
+    for (auto &fd : fds)
+    {
+        ::close(fd.fd);
+    }
+
+    check(request(client, "b") == "new:b", "serve the connection in the new server");
+    int second = connectTo(port);
+    check(second >= 0 && request(second, "c") == "new:c",
+          "accept in the new server");
+    for (int i = 0; i < 100 && !drained; ++i)
+        ::usleep(10000);
+    check(drained, "drain the old server");
+
+    // The connection closed by the new server is closed for the client.
+    runIn(newLoop, [&]() {
+        newServer.reset();
+        return 0;
+    });
+    char c;
+    check(::recv(client, &c, 1, 0) == 0, "close the connection from the new server");
+    ::close(client);
+    if (second >= 0)
+        ::close(second);
+
+    runIn(oldLoop, [&]() {
+        restart.reset();
+        oldServer.reset();
+        return 0;
+    });
+    ::unlink(path.c_str());
+    ::rmdir(dir);
+    return failures == 0 ? 0 : 1;
+}
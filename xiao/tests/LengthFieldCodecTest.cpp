@@ -0,0 +1,183 @@
+/**
+ * @file LengthFieldCodecTest.cpp
+ * @author xiao guo
+ * @brief Encode and decode frames with each length field: the header put in
+ * front without moving the body, frames split across reads or several in one
+ * read, and the frames too long or with a malformed varint.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/LengthFieldCodec.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace xiao;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok)
+        ++failures;
+}
+
+static std::string body(size_t len)
+{
+    std::string data(len, '\0');
+    for (size_t i = 0; i < len; ++i)
+        data[i] = static_cast<char>('a' + i % 26);
+    return data;
+}
+
+// Collect the frames and the errors of a codec, the connection is null.
+struct Decoder
+{
+    Decoder(LengthField field, size_t maxFrameSize)
+        : codec(field,
+                maxFrameSize,
+                [this](const TcpConnectionPtr &, const char *data, size_t len) {
+                    frames.emplace_back(data, len);
+                })
+    {
+        codec.setFrameErrorCallback(
+            [this](const TcpConnectionPtr &, size_t len) { errors.push_back(len); });
+    }
+    void feed(MsgBuffer &buffer)
+    {
+        codec.onMessage(TcpConnectionPtr(), &buffer);
+    }
+
+    LengthFieldCodec codec;
+    std::vector<std::string> frames;
+    std::vector<size_t> errors;
+};
+
+static void roundTrip(LengthField field, const char *name)
+{
+    Decoder decoder(field, 1 << 20);
+    bool moved = false;
+    bool decoded = true;
+    std::vector<size_t> lens = {0, 1, 127, 128, 255, 300, 16383, 16384, 70000};
+    for (auto len : lens)
+    {
+        if (len > decoder.codec.maxFrameSize())
+            continue;
+        auto data = body(len);
+        MsgBuffer buffer;
+        buffer.append(data);
+        auto bodyStart = buffer.peek();
+        if (!decoder.codec.encode(buffer))
+        {
+            decoded = false;
+            continue;
+        }
+        auto headerLen = decoder.codec.headerLength(len);
+        if (buffer.peek() + headerLen != bodyStart ||
+            buffer.readableBytes() != headerLen + len)
+            moved = true;
+        decoder.frames.clear();
+        decoder.feed(buffer);
+        if (decoder.frames.size() != 1 || decoder.frames[0] != data ||
+            buffer.readableBytes() != 0 || !decoder.errors.empty())
+            decoded = false;
+    }
+    std::string what = std::string("round-trip with ") + name;
+    check(decoded, what.c_str());
+    what = std::string("put the header in front of the body with ") + name;
+    check(!moved, what.c_str());
+}
+
+static std::string header(const LengthFieldCodec &codec, size_t len)
+{
+    MsgBuffer buffer;
+    std::string data = body(len);
+    codec.encode(buffer, data.data(), len);
+    return std::string(buffer.peek(), codec.headerLength(len));
+}
+
+int main()
+{
+    roundTrip(LengthField::xInt8, "1-byte lengths");
+    roundTrip(LengthField::xInt16, "2-byte lengths");
+    roundTrip(LengthField::xInt32, "4-byte lengths");
+    roundTrip(LengthField::xInt64, "8-byte lengths");
+    roundTrip(LengthField::xVarint, "varints");
+
+    // The header bytes on the wire.
+    LengthFieldCodec int16Codec(LengthField::xInt16, 1 << 20, nullptr);
+    check(header(int16Codec, 300) == std::string("\x01\x2c", 2), "write big-endian lengths");
+    LengthFieldCodec varintCodec(LengthField::xVarint, 1 << 20, nullptr);
+    check(header(varintCodec, 300) == std::string("\xac\x02", 2),
+          "write the low 7 bits of a varint first");
+    LengthFieldCodec int8Codec(LengthField::xInt8, 1 << 20, nullptr);
+    check(int8Codec.maxFrameSize() == 255, "lower the maximum to what the field encodes");
+
+    // Several frames in one buffer, then the same stream a byte at a time.
+    std::vector<std::string> sent = {body(3), body(0), body(200), body(20000)};
+    for (auto field : {LengthField::xInt32, LengthField::xVarint})
+    {
+        Decoder decoder(field, 1 << 20);
+        MsgBuffer stream;
+        for (auto &data : sent)
+            decoder.codec.encode(stream, data.data(), data.size());
+        std::string wire(stream.peek(), stream.readableBytes());
+        decoder.feed(stream);
+        check(decoder.frames == sent && stream.readableBytes() == 0,
+              "decode several frames in one read");
+
+        decoder.frames.clear();
+        MsgBuffer split;
+        bool early = false;
+        for (size_t i = 0; i < wire.size(); ++i)
+        {
+            split.append(&wire[i], 1);
+            size_t before = decoder.frames.size();
+            decoder.feed(split);
+            // A frame is complete with its last byte, not before.
+            if (decoder.frames.size() > before && split.readableBytes() != 0)
+                early = true;
+        }
+        check(decoder.frames == sent && !early && decoder.errors.empty(),
+              "decode frames split across reads");
+    }
+
+    // Too long to encode, and too long to receive.
+    Decoder limited(LengthField::xInt32, 100);
+    MsgBuffer tooLong;
+    tooLong.append(body(101));
+    auto bodyStart = tooLong.peek();
+    check(!limited.codec.encode(tooLong) && tooLong.peek() == bodyStart &&
+              tooLong.readableBytes() == 101,
+          "refuse to encode a frame beyond the maximum");
+    MsgBuffer received;
+    received.appendInt32(101);
+    received.append(body(101));
+    limited.feed(received);
+    check(limited.frames.empty() && limited.errors.size() == 1 &&
+              limited.errors[0] == 101 && received.readableBytes() == 0,
+          "reject a received frame beyond the maximum");
+
+    // A varint without end, and one whose 10th byte overflows 64 bits.
+    Decoder varints(LengthField::xVarint, 1 << 20);
+    MsgBuffer partial;
+    partial.append(std::string(2, '\x80'));
+    varints.feed(partial);
+    check(varints.errors.empty() && partial.readableBytes() == 2,
+          "wait for the rest of a varint");
+    MsgBuffer endless;
+    endless.append(std::string(11, '\x80'));
+    varints.feed(endless);
+    MsgBuffer overflow;
+    overflow.append(std::string(9, '\xff') + '\x02');
+    varints.feed(overflow);
+    check(varints.frames.empty() && varints.errors == std::vector<size_t>({0, 0}) &&
+              endless.readableBytes() == 0 && overflow.readableBytes() == 0,
+          "reject a malformed varint");
+    return failures == 0 ? 0 : 1;
+}
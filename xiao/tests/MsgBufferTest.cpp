@@ -0,0 +1,153 @@
+/**
+ * @file MsgBufferTest.cpp
+ * @author xiao guo
+ * @brief Read a pipe into message buffers: the spill into the stack area, the
+ * consumed space reclaimed instead of growing, the headers added in front, and
+ * the memory released by retrieveAll() after a burst.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/utils/MsgBuffer.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <string>
+
+using namespace xiao;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok)
+        ++failures;
+}
+
+static std::string pattern(size_t len, size_t seed = 0)
+{
+    std::string data(len, '\0');
+    for (size_t i = 0; i < len; ++i)
+        data[i] = static_cast<char>((i + seed) % 251);
+    return data;
+}
+
+static bool writeAll(int fd, const std::string &data)
+{
+    return ::write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+}
+
+static std::string contents(const MsgBuffer &buffer)
+{
+    return std::string(buffer.peek(), buffer.readableBytes());
+}
+
+// The size of the buffer, without the space reserved in front.
+static size_t capacity(const MsgBuffer &buffer)
+{
+    return buffer.prependableBytes() + buffer.readableBytes() + buffer.writableBytes() - 8;
+}
+
+int main()
+{
+    int fds[2];
+    if (::pipe(fds) < 0)
+    {
+        perror("pipe");
+        return 1;
+    }
+    // Large enough for the bursts below.
+    ::fcntl(fds[1], F_SETPIPE_SZ, 1 << 20);
+    int err = 0;
+
+    // More than the buffer holds: the rest lands in the stack area and is
+    // appended, the buffer grows by what was read only.
+    MsgBuffer spill;
+    auto data = pattern(10000);
+    writeAll(fds[1], data);
+    check(spill.readFd(fds[0], &err) == 10000 && contents(spill) == data,
+          "spill a read into the stack area");
+    check(capacity(spill) < 2 * 10000, "grow by what was read");
+
+    // Everything fits, nothing spills.
+    MsgBuffer fits;
+    data = pattern(1000, 1);
+    writeAll(fds[1], data);
+    check(fits.readFd(fds[0], &err) == 1000 && contents(fits) == data &&
+              capacity(fits) == 2048,
+          "read into the writable part");
+
+    // The consumed space in front is reused instead of growing.
+    MsgBuffer compacting;
+    compacting.append(pattern(1500));
+    compacting.retrieve(1000);
+    auto before = compacting.peek();
+    compacting.ensureWritableBytes(1000);
+    check(capacity(compacting) == 2048 && compacting.peek() < before &&
+              contents(compacting) == pattern(1500).substr(1000),
+          "move the data to the front rather than grow");
+    compacting.ensureWritableBytes(4000);
+    check(capacity(compacting) >= 4500 && contents(compacting) == pattern(1500).substr(1000),
+          "grow when the space in front is not enough");
+
+    // readFd() reclaims the space in front when the data left is smaller.
+    MsgBuffer reading;
+    reading.append(pattern(2000));
+    reading.retrieve(1900);
+    data = pattern(1500, 2);
+    writeAll(fds[1], data);
+    check(reading.readFd(fds[0], &err) == 1500 && capacity(reading) == 2048 &&
+              contents(reading) == pattern(2000).substr(1900) + data,
+          "reclaim the consumed space before reading");
+
+    // A header fitting in front is written there, a longer one moves the data
+    // within the buffer, or into a new buffer when it is full.
+    MsgBuffer front;
+    front.append("body");
+    before = front.peek();
+    front.addInFrontInt32(4);
+    check(front.peek() + 4 == before &&
+              contents(front) == std::string("\0\0\0\4body", 8),
+          "add a header in the space in front");
+    front.retrieveAll();
+    front.append("body");
+    auto longHeader = pattern(20, 3);
+    front.addInFront(longHeader.data(), longHeader.size());
+    check(contents(front) == longHeader + "body" && capacity(front) == 2048,
+          "move the data for a longer header");
+    MsgBuffer full(16);
+    full.append(pattern(16));
+    full.addInFront(longHeader.data(), longHeader.size());
+    check(contents(full) == longHeader + pattern(16), "grow a full buffer for a header");
+
+    // A burst grows the buffer beyond the size kept, emptying it releases the
+    // memory, a smaller one is kept.
+    MsgBuffer burst;
+    data = pattern(300000, 4);
+    writeAll(fds[1], data);
+    size_t read = 0;
+    while (read < data.size())
+    {
+        auto n = burst.readFd(fds[0], &err);
+        if (n <= 0)
+            break;
+        read += n;
+    }
+    check(contents(burst) == data, "read a burst");
+    burst.retrieveAll();
+    check(capacity(burst) == 2048 && burst.readableBytes() == 0,
+          "release the memory of a burst");
+    MsgBuffer kept;
+    kept.append(pattern(100000));
+    auto keptCapacity = capacity(kept);
+    kept.retrieveAll();
+    check(capacity(kept) == keptCapacity, "keep the memory below the limit");
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return failures == 0 ? 0 : 1;
+}
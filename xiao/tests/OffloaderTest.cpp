@@ -0,0 +1,117 @@
+/**
+ * @file OffloaderTest.cpp
+ * @author xiao guo
+ * @brief Test the offloader while its loop is busy: the completions finished
+ * meanwhile are run by one drain, a cancelled task doesn't complete, and the
+ * completions of a destroyed offloader are dropped.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopThread.h>
+#include <xiao/net/Offloader.h>
+#include <xiao/utils/ConcurrentTaskQueue.h>
+#include <atomic>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <vector>
+
+using namespace xiao;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok)
+        ++failures;
+}
+
+// Keep the loop busy until the returned promise is set, the function runs in
+// the loop before it returns.
+static std::shared_ptr<std::promise<void>> block(EventLoop *loop,
+                                                 std::function<void()> before = {})
+{
+    auto release = std::make_shared<std::promise<void>>();
+    auto released = release->get_future().share();
+    loop->queueInLoop([released, before]() {
+        released.wait();
+        if (before)
+            before();
+    });
+    return release;
+}
+
+// Wait until the functions queued in the loop so far have run.
+static void sync(EventLoop *loop)
+{
+    std::promise<void> done;
+    loop->queueInLoop([&done]() { done.set_value(); });
+    done.get_future().wait();
+}
+
+int main()
+{
+    EventLoopThread loopThread("offload");
+    loopThread.run();
+    auto loop = loopThread.getLoop();
+    // One thread, so a task queued after another finds it completed.
+    ConcurrentTaskQueue queue(1, "offload");
+    std::unique_ptr<Offloader> offloader(new Offloader(loop, &queue));
+
+    // The function queued after the first completion runs after all of them:
+    // the later completions are picked up by the drain queued by the first.
+    const int tasks = 100;
+    std::vector<int> order;
+    auto release = block(loop);
+    for (int i = 0; i < tasks; ++i)
+    {
+        offloader->submit([i]() { return i; }, [&order](int n) { order.push_back(n); });
+        queue.syncTaskInQueue([]() {});
+        if (i == 0)
+            loop->queueInLoop([&order]() { order.push_back(-1); });
+    }
+    release->set_value();
+    sync(loop);
+    bool batched = order.size() == static_cast<size_t>(tasks) + 1 && order.back() == -1;
+    for (int i = 0; batched && i < tasks; ++i)
+        batched = order[i] == i;
+    check(batched, "run the completions finished meanwhile in one drain");
+
+    // Cancelled in the loop after the work is done, before the completion.
+    bool completed = false;
+    OffloadHandle handle;
+    release = block(loop, [&handle]() { handle.cancel(); });
+    handle = offloader->submit([]() { return 0; }, [&completed](int) { completed = true; });
+    queue.syncTaskInQueue([]() {});
+    release->set_value();
+    sync(loop);
+    check(!completed, "skip the completion of a task cancelled after its work");
+
+    // Cancelled before the work starts.
+    std::atomic<bool> worked{false};
+    auto queueRelease = std::make_shared<std::promise<void>>();
+    auto queueReleased = queueRelease->get_future().share();
+    queue.runTaskInQueue([queueReleased]() { queueReleased.wait(); });
+    handle = offloader->submit([&worked]() { worked = true; }, [&completed]() { completed = true; });
+    handle.cancel();
+    queueRelease->set_value();
+    queue.syncTaskInQueue([]() {});
+    sync(loop);
+    check(!worked && !completed, "skip the work of a task cancelled before it starts");
+
+    // Destroyed in the loop while a drain is queued.
+    release = block(loop, [&offloader]() { offloader.reset(); });
+    offloader->submit([]() { return 0; }, [&completed](int) { completed = true; });
+    queue.syncTaskInQueue([]() {});
+    release->set_value();
+    sync(loop);
+    check(!offloader && !completed, "drop the completions of a destroyed offloader");
+
+    queue.stop();
+    return failures == 0 ? 0 : 1;
+}
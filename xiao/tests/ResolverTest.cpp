@@ -0,0 +1,128 @@
+/**
+ * @file ResolverTest.cpp
+ * @author xiao guo
+ * @brief Test the caching of the resolver with a hosts file standing in for
+ * the DNS: the results are cached, the failures expire sooner, and the
+ * lookups of a name in flight share one query.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/Resolver.h>
+#include <chrono>
+#include <cstdio>
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <future>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace xiao;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok)
+        ++failures;
+}
+
+static void writeHosts(const std::string &path, const std::string &content)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file << content;
+}
+
+// Resolve the name and wait for the result, or return "timeout".
+static std::string resolve(const std::shared_ptr<Resolver> &resolver,
+                           const std::string &name)
+{
+    auto done = std::make_shared<std::promise<std::string>>();
+    auto result = done->get_future();
+    resolver->resolve(name, [done](const std::vector<InetAddress> &addrs) {
+        done->set_value(addrs.empty() ? std::string() : addrs[0].toIp());
+    });
+    if (result.wait_for(std::chrono::seconds(5)) != std::future_status::ready)
+        return "timeout";
+    return result.get();
+}
+
+int main()
+{
+    char dir[] = "/tmp/xiao_resolver_XXXXXX";
+    if (!::mkdtemp(dir))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string hosts = std::string(dir) + "/hosts";
+
+    // The result is kept for the timeout, the edit is not seen.
+    writeHosts(hosts, "10.0.0.1 cached.test\n");
+    auto resolver = Resolver::newResolver(nullptr, 60, hosts);
+    check(resolve(resolver, "cached.test") == "10.0.0.1", "resolve from the hosts file");
+    writeHosts(hosts, "10.0.0.2 cached.test\n");
+    check(resolve(resolver, "CACHED.test") == "10.0.0.1", "cache the result");
+
+    // A failure is cached for the shorter negative timeout.
+    writeHosts(hosts, "0.0.0.0 late.test\n");
+    resolver = Resolver::newResolver(nullptr, 1, hosts);
+    check(resolve(resolver, "late.test").empty(), "fail on a blocked name");
+    writeHosts(hosts, "10.0.0.3 late.test\n");
+    check(resolve(resolver, "late.test").empty(), "cache the failure");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    check(resolve(resolver, "late.test") == "10.0.0.3", "expire the failure");
+
+    // The hosts file is a FIFO, a query blocks reading it until it is
+    // written, so all the lookups are made while the first query is in
+    // flight.
+    std::string fifo = std::string(dir) + "/fifo";
+    if (::mkfifo(fifo.c_str(), 0600) < 0)
+    {
+        perror("mkfifo");
+        return 1;
+    }
+    resolver = Resolver::newResolver(nullptr, 60, fifo);
+    const int lookups = 3;
+    std::vector<std::future<std::string>> results;
+    for (int i = 0; i < lookups; ++i)
+    {
+        auto done = std::make_shared<std::promise<std::string>>();
+        results.push_back(done->get_future());
+        resolver->resolve("shared.test", [done](const std::vector<InetAddress> &addrs) {
+            done->set_value(addrs.empty() ? std::string() : addrs[0].toIp());
+        });
+    }
+    // Blocks until the query opens the FIFO.
+    writeHosts(fifo, "10.0.0.4 shared.test\n");
+    bool same = true;
+    for (auto &result : results)
+    {
+        same = same &&
+               result.wait_for(std::chrono::seconds(5)) == std::future_status::ready &&
+               result.get() == "10.0.0.4";
+    }
+    check(same, "deliver the shared query to every lookup");
+    // Other queries would have read nothing and cached a failure, or would
+    // be waiting for a writer.
+    check(resolve(resolver, "shared.test") == "10.0.0.4", "cache the shared result");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int fd = ::open(fifo.c_str(), O_WRONLY | O_NONBLOCK);
+    check(fd < 0 && errno == ENXIO, "make one query for the lookups in flight");
+    // Release a query left waiting.
+    if (fd >= 0)
+        ::close(fd);
+
+    ::unlink(fifo.c_str());
+    ::unlink(hosts.c_str());
+    ::rmdir(dir);
+    return failures == 0 ? 0 : 1;
+}
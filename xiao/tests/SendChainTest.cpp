@@ -0,0 +1,475 @@
+/**
+ * @file SendChainTest.cpp
+ * @author xiao guo
+ * @brief Send through a connection with small socket buffers to a client
+ * reading behind, and check the client receives the bytes in order: the
+ * partial writes of the chain, more nodes than one writev() takes, the
+ * memory, file and stream nodes mixed, the files sent from the page cache,
+ * whole or truncated, the buffers sent with MSG_ZEROCOPY, kept until the
+ * kernel is done with them, and a proxy throttling its input by its output.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopThread.h>
+#include <xiao/net/TcpServer.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace xiao;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok)
+        ++failures;
+}
+
+// The socket buffers of both ends, so a few KB fill them.
+static const int xSmallBuffer = 4096;
+
+template <typename F>
+static auto runIn(EventLoop *loop, F f) -> decltype(f())
+{
+    std::promise<decltype(f())> done;
+    loop->runInLoop([&]() { done.set_value(f()); });
+    return done.get_future().get();
+}
+
+// Bytes without a short period, so a chunk sent out of place shows.
+static std::string pattern(size_t len, uint32_t seed)
+{
+    std::string data(len, '\0');
+    uint32_t state = seed * 2654435761u + 1;
+    for (size_t i = 0; i < len; ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        data[i] = static_cast<char>(state >> 24);
+    }
+    return data;
+}
+
+// A server handing its connections over to the test, sending with small
+// socket buffers.
+class Server
+{
+public:
+    Server() : thread_("send")
+    {
+        thread_.run();
+        loop_ = thread_.getLoop();
+        runIn(loop_, [this]() {
+            server_.reset(
+                new TcpServer(loop_, InetAddress("127.0.0.1", 0), "send", true, false));
+            server_->setConnectionCallback([this](const TcpConnectionPtr &conn) {
+                if (!conn->connected())
+                    return;
+                std::lock_guard<std::mutex> lock(mutex_);
+                accepted_.push_back(conn);
+                cond_.notify_one();
+            });
+            server_->start();
+            // Inherited by the accepted sockets.
+            int size = xSmallBuffer;
+            ::setsockopt(server_->listenFd(), SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+            ::setsockopt(server_->listenFd(), SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+            return 0;
+        });
+    }
+    ~Server()
+    {
+        runIn(loop_, [this]() {
+            server_.reset();
+            return 0;
+        });
+    }
+
+    EventLoop *loop() const
+    {
+        return loop_;
+    }
+
+    // Connect a blocking client with small socket buffers, return the
+    // client socket and the connection of the server.
+    TcpConnectionPtr connect(int &fd)
+    {
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int size = xSmallBuffer;
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        struct timeval tv = {5, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(server_->address().toPort());
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            perror("connect");
+            return nullptr;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!cond_.wait_for(lock, std::chrono::seconds(5), [this]() {
+                return !accepted_.empty();
+            }))
+            return nullptr;
+        auto conn = accepted_.front();
+        accepted_.pop_front();
+        return conn;
+    }
+
+private:
+    EventLoopThread thread_;
+    EventLoop *loop_;
+    std::unique_ptr<TcpServer> server_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<TcpConnectionPtr> accepted_;
+};
+
+// Read the given number of bytes, fewer on timeout or end of stream.
+static std::string readExactly(int fd, size_t len)
+{
+    std::string data(len, '\0');
+    size_t got = 0;
+    while (got < len)
+    {
+        auto n = ::recv(fd, &data[got], len - got, 0);
+        if (n <= 0)
+            break;
+        got += static_cast<size_t>(n);
+    }
+    data.resize(got);
+    return data;
+}
+
+static std::string tempFile(const std::string &content)
+{
+    char path[] = "/tmp/xiao_send_XXXXXX";
+    int fd = ::mkstemp(path);
+    if (fd < 0 || ::write(fd, content.data(), content.size()) !=
+                      static_cast<ssize_t>(content.size()))
+        perror("temp file");
+    ::close(fd);
+    return path;
+}
+
+// A large chain is only partly written at first, the rest is flushed by the
+// write events as the client reads.
+static void testPartialWrites(Server &server)
+{
+    int fd;
+    auto conn = server.connect(fd);
+    if (!conn)
+    {
+        check(false, "connect");
+        return;
+    }
+    std::atomic<bool> completed{false};
+    auto data = pattern(1 << 20, 1);
+    runIn(server.loop(), [&]() {
+        conn->setWriteCompleteCallback(
+            [&completed](const TcpConnectionPtr &) { completed = true; });
+        conn->send(data.data(), data.size() / 2);
+        conn->send(std::string(data, data.size() / 2));
+        return 0;
+    });
+    ::usleep(100000);
+    check(!completed, "keep the chain while the socket is full");
+    check(readExactly(fd, data.size()) == data, "send a partly written chain in order");
+    for (int i = 0; i < 100 && !completed; ++i)
+        ::usleep(10000);
+    check(completed, "complete the write once the chain is drained");
+    ::close(fd);
+}
+
+// More shared nodes than IOV_MAX are gathered by several writev() calls.
+static void testManyNodes(Server &server)
+{
+    int fd;
+    auto conn = server.connect(fd);
+    if (!conn)
+    {
+        check(false, "connect");
+        return;
+    }
+    const size_t nodes = IOV_MAX + IOV_MAX / 2;
+    std::string expected;
+    runIn(server.loop(), [&]() {
+        for (size_t i = 0; i < nodes; ++i)
+        {
+            auto chunk = std::make_shared<std::string>(pattern(100 + i % 50, static_cast<uint32_t>(i)));
+            expected += *chunk;
+            conn->send(chunk);
+        }
+        return 0;
+    });
+    check(readExactly(fd, expected.size()) == expected,
+          "send more nodes than one writev() takes, in order");
+    ::close(fd);
+}
+
+// Memory, shared, file, stream and async stream nodes in one chain.
+static void testMixedNodes(Server &server)
+{
+    int fd;
+    auto conn = server.connect(fd);
+    if (!conn)
+    {
+        check(false, "connect");
+        return;
+    }
+    auto fileContent = pattern(100000, 2);
+    auto path = tempFile(fileContent);
+    auto streamContent = pattern(10000, 3);
+    auto asyncContent = pattern(20000, 4);
+    MsgBuffer buffer;
+    buffer.append(pattern(6000, 5));
+    std::string expected = "head" + fileContent.substr(10, 50000) + pattern(8192, 6) +
+                           streamContent + std::string(buffer.peek(), buffer.readableBytes()) +
+                           asyncContent + "tail";
+    auto async = runIn(server.loop(), [&]() {
+        conn->send("head", 4);
+        conn->sendFile(path, 10, 50000);
+        conn->send(pattern(8192, 6));
+        auto offset = std::make_shared<size_t>(0);
+        conn->sendStream([streamContent, offset](char *buf, size_t len) -> size_t {
+            if (!buf)
+                return 0;
+            // Small pieces, so the stream node is read several times.
+            len = (std::min)((std::min)(len, size_t(3000)), streamContent.size() - *offset);
+            memcpy(buf, streamContent.data() + *offset, len);
+            *offset += len;
+            return len;
+        });
+        conn->send(std::move(buffer));
+        auto stream = conn->sendAsyncStream();
+        conn->send("tail", 4);
+        return stream;
+    });
+    // The data after the async stream waits for it to be closed.
+    async->send(asyncContent.substr(0, 5000));
+    ::usleep(50000);
+    async->send(asyncContent.substr(5000));
+    async->close();
+    check(readExactly(fd, expected.size()) == expected,
+          "send memory, file and stream nodes in order");
+    async.reset();
+    ::unlink(path.c_str());
+    ::close(fd);
+}
+
+// A file is sent from the page cache over a full socket, resuming from its
+// offset. The rest of a file truncated meanwhile, or shorter than its size, is
+// dropped and the chain goes on.
+static void testFileNodes(Server &server)
+{
+    int fd;
+    auto conn = server.connect(fd);
+    if (!conn)
+    {
+        check(false, "connect");
+        return;
+    }
+    auto fileContent = pattern(1 << 20, 7);
+    auto path = tempFile(fileContent);
+    runIn(server.loop(), [&]() {
+        conn->sendFile(path, 1000);
+        conn->send("tail", 4);
+        return 0;
+    });
+    check(readExactly(fd, fileContent.size() - 1000 + 4) == fileContent.substr(1000) + "tail",
+          "send a file over a full socket");
+
+    // Only the socket buffers are sent before the truncation.
+    const size_t truncated = 200000;
+    runIn(server.loop(), [&]() {
+        conn->sendFile(path);
+        conn->send("tail", 4);
+        return 0;
+    });
+    ::usleep(100000);
+    if (::truncate(path.c_str(), truncated) < 0)
+        perror("truncate");
+    check(readExactly(fd, truncated + 4) == fileContent.substr(0, truncated) + "tail",
+          "drop the rest of a file truncated while it is sent");
+
+    // A sysfs file is one page long by its size, its content is shorter.
+    const char *sysfsFile = "/sys/devices/system/cpu/online";
+    struct stat st;
+    if (::stat(sysfsFile, &st) == 0 && st.st_size > 0)
+    {
+        std::string content;
+        FILE *file = ::fopen(sysfsFile, "r");
+        char buf[256];
+        size_t n;
+        while (file && (n = ::fread(buf, 1, sizeof(buf), file)) > 0)
+            content.append(buf, n);
+        if (file)
+            ::fclose(file);
+        runIn(server.loop(), [&]() {
+            conn->sendFile(sysfsFile);
+            conn->send("tail", 4);
+            return 0;
+        });
+        check(readExactly(fd, content.size() + 4) == content + "tail",
+              "send a file shorter than its size");
+    }
+    ::unlink(path.c_str());
+    ::close(fd);
+}
+
+// Wait until the buffer handed over to the connection is released.
+static bool released(const std::weak_ptr<std::string> &weak)
+{
+    for (int i = 0; i < 300 && !weak.expired(); ++i)
+        ::usleep(10000);
+    return weak.expired();
+}
+
+// A large shared buffer is sent with MSG_ZEROCOPY and kept until its
+// completion is read, the loopback copies it and turns the mode off.
+static void testZeroCopy(Server &server)
+{
+    int fd;
+    auto conn = server.connect(fd);
+    if (!conn)
+    {
+        check(false, "connect");
+        return;
+    }
+    if (!runIn(server.loop(), [&]() { return conn->setZeroCopy(true); }))
+    {
+        printf("skipped: MSG_ZEROCOPY is not supported\n");
+        ::close(fd);
+        return;
+    }
+    for (int round = 0; round < 2; ++round)
+    {
+        auto data = std::make_shared<std::string>(pattern(256 * 1024, 8 + round));
+        std::weak_ptr<std::string> weak = data;
+        std::string expected = *data + "tail";
+        runIn(server.loop(), [&]() {
+            conn->send(data);
+            conn->send("tail", 4);
+            return 0;
+        });
+        data.reset();
+        check(readExactly(fd, expected.size()) == expected,
+              round == 0 ? "send a zero copy buffer in order"
+                         : "send in order after the mode is turned off");
+        check(released(weak), "release a zero copy buffer once the kernel is done");
+    }
+
+    // Closed with a zero copy send pending, the buffer is released by the
+    // completions read after the close, or by the reset at the end.
+    int other;
+    auto closing = server.connect(other);
+    if (!closing)
+    {
+        check(false, "connect");
+        ::close(fd);
+        return;
+    }
+    runIn(server.loop(), [&]() { return closing->setZeroCopy(true); });
+    auto data = std::make_shared<std::string>(pattern(1 << 20, 10));
+    std::weak_ptr<std::string> weak = data;
+    runIn(server.loop(), [&]() {
+        closing->send(data);
+        closing->forceClose();
+        return 0;
+    });
+    data.reset();
+    closing.reset();
+    check(released(weak), "release the zero copy buffers of a closed connection");
+    ::close(other);
+    ::close(fd);
+}
+
+// A proxy forwards the input of one connection to another, whose client
+// doesn't read: the input stops being read above the high mark, and is read
+// again once the output drains.
+static void testBackpressure(Server &server)
+{
+    int producer, consumer;
+    auto in = server.connect(producer);
+    auto out = server.connect(consumer);
+    if (!in || !out)
+    {
+        check(false, "connect");
+        return;
+    }
+    const size_t highMark = 64 * 1024;
+    const size_t lowMark = 16 * 1024;
+    runIn(server.loop(), [&]() {
+        out->setBackpressure(in, highMark, lowMark);
+        in->setRecvMsgCallback([out](const TcpConnectionPtr &, MsgBuffer *buf) {
+            out->send(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        });
+        return 0;
+    });
+    auto data = pattern(4 << 20, 11);
+    std::atomic<bool> written{false};
+    std::thread writer([&]() {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            auto n = ::send(producer, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                break;
+            sent += static_cast<size_t>(n);
+        }
+        written = true;
+    });
+    ::usleep(300000);
+    auto received = runIn(server.loop(), [&]() { return in->bytesReceived(); });
+    // One read past the mark at most: the buffer and the stack area.
+    check(!written && received <= highMark + 256 * 1024,
+          "stop reading the input above the high mark");
+    check(readExactly(consumer, data.size()) == data,
+          "read the input again as the output drains, in order");
+    writer.join();
+    check(written, "take all the input");
+    runIn(server.loop(), [&]() {
+        out->setBackpressure(nullptr, 0, 0);
+        return 0;
+    });
+    ::close(producer);
+    ::close(consumer);
+}
+
+int main()
+{
+    Server server;
+    testPartialWrites(server);
+    testManyNodes(server);
+    testMixedNodes(server);
+    testFileNodes(server);
+    testZeroCopy(server);
+    testBackpressure(server);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file TimingWheelTest.cpp
+ * @author xiao guo
+ * @brief Run a timing wheel with a short tick: a refreshed object is moved to
+ * its new deadline, the objects idle together expire in one batch, and the
+ * objects destroyed in the wheel are dropped. Then check a server keeps an
+ * active connection and closes an idle one once.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopThread.h>
+#include <xiao/net/TcpServer.h>
+#include <xiao/utils/TimingWheel.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace xiao;
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok)
+        ++failures;
+}
+
+struct Object
+{
+    TimingWheel::Entry entry;
+    int expired{0};
+    Clock::time_point expiredAt;
+};
+
+static void testWheel()
+{
+    EventLoop loop;
+    // 5 ticks of 10ms.
+    TimingWheel wheel(&loop, 0.05, 0.01);
+    std::vector<size_t> batches;
+    wheel.setExpireCallback([&batches](const std::vector<TimingWheel::EntryPtr> &expired) {
+        batches.push_back(expired.size());
+        for (auto &obj : expired)
+        {
+            auto object = static_cast<Object *>(obj.get());
+            ++object->expired;
+            object->expiredAt = Clock::now();
+        }
+    });
+
+    auto start = Clock::now();
+    // Refreshed every 20ms for 200ms, then left idle.
+    auto refreshed = std::make_shared<Object>();
+    wheel.insertEntry(refreshed, &refreshed->entry);
+    auto lastRefresh = start;
+    auto refreshTimer = loop.runEvery(0.02, [&]() {
+        refreshed->entry.refresh();
+        lastRefresh = Clock::now();
+    });
+    loop.runAfter(0.2, [&]() { loop.invalidateTimer(refreshTimer); });
+
+    // Ten objects idle together, one of them destroyed in the wheel.
+    std::vector<std::shared_ptr<Object>> batch;
+    for (int i = 0; i < 10; ++i)
+    {
+        batch.push_back(std::make_shared<Object>());
+        wheel.insertEntry(batch.back(), &batch.back()->entry);
+    }
+    std::weak_ptr<Object> destroyed = batch.back();
+    batch.pop_back();
+    check(wheel.size() == 11, "count the objects in the wheel");
+
+    loop.runAfter(0.5, [&]() { loop.quit(); });
+    loop.loop();
+
+    bool once = true;
+    for (auto &object : batch)
+        once = once && object->expired == 1 && !object->entry.inWheel();
+    check(once && destroyed.expired(), "expire the idle objects once");
+    check(!batches.empty() && batches[0] == batch.size(),
+          "expire the objects idle together in one batch");
+    // The deadline is in 5 to 6 ticks, the current one has partly elapsed.
+    auto idleFor = std::chrono::duration<double>(refreshed->expiredAt - lastRefresh).count();
+    check(refreshed->expired == 1 && lastRefresh - start >= std::chrono::milliseconds(150) &&
+              idleFor >= 0.04 && idleFor < 0.1,
+          "keep a refreshed object until it is idle for the timeout");
+    check(wheel.size() == 0, "drop the destroyed object");
+}
+
+static int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+template <typename F>
+static auto runIn(EventLoop *loop, F f) -> decltype(f())
+{
+    std::promise<decltype(f())> done;
+    loop->runInLoop([&]() { done.set_value(f()); });
+    return done.get_future().get();
+}
+
+static void testServer()
+{
+    EventLoopThread loopThread("idle");
+    loopThread.run();
+    auto loop = loopThread.getLoop();
+    std::unique_ptr<TcpServer> server;
+    // The closes seen by the server, by client port.
+    std::map<uint16_t, int> closes;
+    auto port = runIn(loop, [&]() {
+        server.reset(new TcpServer(loop, InetAddress("127.0.0.1", 0), "idle", true, false));
+        server->kickoffIdleConnections(1);
+        server->setRecvMessageCallback(
+            [](const TcpConnectionPtr &, MsgBuffer *buf) { buf->retrieveAll(); });
+        server->setConnectionCallback([&closes](const TcpConnectionPtr &conn) {
+            if (!conn->connected())
+                ++closes[conn->peerAddr().toPort()];
+        });
+        server->start();
+        return server->address().toPort();
+    });
+
+    int active = connectTo(port);
+    int idle = connectTo(port);
+    if (active < 0 || idle < 0)
+    {
+        check(false, "connect");
+        return;
+    }
+    // The timeout is 1s with ticks of 1s, so an idle connection is closed
+    // within 2s.
+    for (int i = 0; i < 10; ++i)
+    {
+        if (::send(active, "x", 1, MSG_NOSIGNAL) != 1)
+            break;
+        ::usleep(250000);
+    }
+    char c;
+    check(::recv(idle, &c, 1, MSG_DONTWAIT) == 0, "close the idle connection");
+    check(::send(active, "x", 1, MSG_NOSIGNAL) == 1 &&
+              ::recv(active, &c, 1, MSG_DONTWAIT) < 0 && errno == EAGAIN,
+          "keep the active connection");
+
+    auto portOf = [](int fd) {
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        ::getsockname(fd, (struct sockaddr *)&addr, &len);
+        return ntohs(addr.sin_port);
+    };
+    auto idleCloses = runIn(loop, [&]() { return closes[portOf(idle)]; });
+    auto activeCloses = runIn(loop, [&]() { return closes[portOf(active)]; });
+    check(idleCloses == 1 && activeCloses == 0, "close the idle connection once");
+
+    ::close(active);
+    ::close(idle);
+    runIn(loop, [&]() {
+        server.reset();
+        return 0;
+    });
+}
+
+int main()
+{
+    testWheel();
+    testServer();
+    return failures == 0 ? 0 : 1;
+}
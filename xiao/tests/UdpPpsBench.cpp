@@ -0,0 +1,112 @@
+/**
+ * @file UdpPpsBench.cpp
+ * @author xiao guo
+ * @brief Measure the datagrams per second a UdpSocket receives from another
+ * one on the loopback, each in its own loop, with small datagrams sent as
+ * fast as the sender's loop can batch them. Run it with --no-offload to
+ * disable GSO on the sender and GRO on the receiver.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopThread.h>
+#include <xiao/net/UdpSocket.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+
+using namespace xiao;
+using Clock = std::chrono::steady_clock;
+
+static const size_t xDatagramSize = 64;
+// The datagrams sent in an iteration of the sender's loop.
+static const int xBurst = 256;
+static const double xWarmUpSeconds = 1.0;
+static const double xRunSeconds = 3.0;
+
+int main(int argc, char *argv[])
+{
+    bool offload = !(argc > 1 && strcmp(argv[1], "--no-offload") == 0);
+    EventLoopThread receiverThread("receiver");
+    EventLoopThread senderThread("sender");
+    receiverThread.run();
+    senderThread.run();
+
+    std::atomic<uint64_t> received{0};
+    auto receiver =
+        std::make_shared<UdpSocket>(receiverThread.getLoop(), InetAddress("127.0.0.1", 0));
+    receiver->setGro(offload);
+    receiver->setMessageCallback(
+        [&received](const char *, size_t, const InetAddress &) {
+            received.fetch_add(1, std::memory_order_relaxed);
+        });
+    receiver->start();
+
+    auto senderLoop = senderThread.getLoop();
+    auto sender = std::make_shared<UdpSocket>(senderLoop, InetAddress("127.0.0.1", 0));
+    sender->setGso(offload);
+    sender->start();
+    std::atomic<bool> stop{false};
+    // The datagrams sent out by sendmmsg(), read in the sender's loop.
+    std::atomic<uint64_t> sent{0};
+    std::string payload(xDatagramSize, 'x');
+    InetAddress peer = receiver->localAddr();
+    std::function<void()> pump = [&]() {
+        if (stop)
+            return;
+        for (int i = 0; i < xBurst; ++i)
+        {
+            if (!sender->send(payload, peer))
+                break;
+        }
+        sent.store(sender->sentCount(), std::memory_order_relaxed);
+        senderLoop->queueInLoop(pump);
+    };
+    senderLoop->queueInLoop(pump);
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(xWarmUpSeconds));
+    uint64_t receivedBefore = received.load();
+    uint64_t sentBefore = sent.load();
+    auto start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(xRunSeconds));
+    uint64_t datagrams = received.load() - receivedBefore;
+    uint64_t sentOut = sent.load() - sentBefore;
+    auto secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    bool gso = sender->gsoEnabled();
+    bool gro = receiver->groEnabled();
+
+    // The sockets are destroyed in their loops.
+    stop = true;
+    std::promise<void> senderDone, receiverDone;
+    senderLoop->runInLoop([&]() {
+        sender.reset();
+        senderDone.set_value();
+    });
+    receiverThread.getLoop()->runInLoop([&]() {
+        receiver.reset();
+        receiverDone.set_value();
+    });
+    senderDone.get_future().wait();
+    receiverDone.get_future().wait();
+    senderLoop->quit();
+    receiverThread.getLoop()->quit();
+    senderThread.wait();
+    receiverThread.wait();
+
+    printf("%zu-byte datagrams, GSO %s, GRO %s\n",
+           xDatagramSize,
+           gso ? "on" : "off",
+           gro ? "on" : "off");
+    printf("%.0f datagrams sent per second\n", sentOut / secs);
+    printf("%.0f datagrams received per second\n", datagrams / secs);
+    return 0;
+}
@@ -0,0 +1,233 @@
+/**
+ * @file UnixSocketTest.cpp
+ * @author xiao guo
+ * @brief Echo over Unix domain sockets, on a path and on an abstract name:
+ * the stale socket file of a server gone is removed, and file descriptors
+ * are passed along with the data.
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/net/EventLoopThread.h>
+#include <xiao/net/TcpClient.h>
+#include <xiao/net/TcpServer.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+
+using namespace xiao;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok)
+        ++failures;
+}
+
+template <typename F>
+static auto runIn(EventLoop *loop, F f) -> decltype(f())
+{
+    std::promise<decltype(f())> done;
+    loop->runInLoop([&]() { done.set_value(f()); });
+    return done.get_future().get();
+}
+
+// An echo server. The fds received are answered by writing the data into
+// them instead.
+static std::unique_ptr<TcpServer> echoServer(EventLoop *loop, const InetAddress &addr)
+{
+    return runIn(loop, [&]() {
+        std::unique_ptr<TcpServer> server(new TcpServer(loop, addr, "echo"));
+        server->setConnectionCallback([](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+                conn->setRecvFds(true);
+        });
+        server->setRecvMessageCallback([](const TcpConnectionPtr &conn, MsgBuffer *buf) {
+            auto fds = conn->takeRecvFds();
+            if (fds.empty())
+            {
+                conn->send(buf->peek(), buf->readableBytes());
+            }
+            else
+            {
+                for (auto fd : fds)
+                {
+                    if (::write(fd, buf->peek(), buf->readableBytes()) < 0)
+                        perror("write");
+                    ::close(fd);
+                }
+            }
+            buf->retrieveAll();
+        });
+        server->start();
+        return server;
+    });
+}
+
+// A client connected to the server, what it receives is gathered.
+struct Client
+{
+    Client(EventLoop *loop, const InetAddress &addr) : loop_(loop)
+    {
+        auto connected = std::make_shared<std::promise<void>>();
+        auto future = connected->get_future();
+        runIn(loop, [&]() {
+            client_ = std::make_shared<TcpClient>(loop, addr, "unix");
+            client_->setConnectionCallback([connected](const TcpConnectionPtr &conn) {
+                if (conn->connected())
+                    connected->set_value();
+            });
+            client_->setMessageCallback([this](const TcpConnectionPtr &, MsgBuffer *buf) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                received_.append(buf->peek(), buf->readableBytes());
+                buf->retrieveAll();
+            });
+            client_->connect();
+            return 0;
+        });
+        connected_ = future.wait_for(std::chrono::seconds(2)) == std::future_status::ready;
+    }
+    ~Client()
+    {
+        runIn(loop_, [this]() {
+            client_.reset();
+            return 0;
+        });
+    }
+
+    // Send the message and wait for as many bytes back.
+    std::string echo(const std::string &msg)
+    {
+        if (!connected_)
+            return std::string();
+        client_->connection()->send(msg);
+        for (int i = 0; i < 200; ++i)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (received_.size() >= msg.size())
+                    return std::move(received_);
+            }
+            ::usleep(10000);
+        }
+        return std::string();
+    }
+
+    EventLoop *loop_;
+    TcpClientPtr client_;
+    bool connected_{false};
+    std::mutex mutex_;
+    std::string received_;
+};
+
+static bool isSocketFile(const std::string &path)
+{
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode);
+}
+
+int main()
+{
+    char dir[] = "/tmp/xiao_unix_XXXXXX";
+    if (!::mkdtemp(dir))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string path = std::string(dir) + "/echo.sock";
+
+    EventLoopThread serverThread("server");
+    serverThread.run();
+    auto serverLoop = serverThread.getLoop();
+    EventLoopThread clientThread("client");
+    clientThread.run();
+    auto clientLoop = clientThread.getLoop();
+
+    // The socket file of a server that is gone, nothing listens on it.
+    int stale = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un un;
+    memset(&un, 0, sizeof(un));
+    un.sun_family = AF_UNIX;
+    strncpy(un.sun_path, path.c_str(), sizeof(un.sun_path) - 1);
+    ::bind(stale, (struct sockaddr *)&un, sizeof(un));
+    ::close(stale);
+    check(isSocketFile(path), "leave a stale socket file");
+
+    auto pathAddr = InetAddress::fromUnixPath(path);
+    check(pathAddr.isUnixDomain() && pathAddr.toIp() == path, "make an address of a path");
+    auto server = echoServer(serverLoop, pathAddr);
+    {
+        Client client(clientLoop, pathAddr);
+        check(client.echo("over a path") == "over a path",
+              "echo on a path, over the stale socket file");
+
+        // The fd of a pipe passed to the server, which writes into it.
+        int fds[2];
+        if (::pipe(fds) < 0)
+        {
+            perror("pipe");
+            return 1;
+        }
+        auto passed = runIn(clientLoop, [&]() {
+            return client.client_->connection()->sendFds("fd", 2, {fds[1]});
+        });
+        // The connection has its own copy.
+        ::close(fds[1]);
+        char buf[8] = {0};
+        struct pollfd pfd = {fds[0], POLLIN, 0};
+        check(passed && ::poll(&pfd, 1, 2000) == 1 && ::read(fds[0], buf, sizeof(buf)) == 2 &&
+                  std::string(buf) == "fd",
+              "pass an fd with the data");
+        ::close(fds[0]);
+    }
+    runIn(serverLoop, [&]() {
+        server.reset();
+        return 0;
+    });
+    check(isSocketFile(path), "keep the socket file after the server");
+
+    // A server restarted on the same path.
+    server = echoServer(serverLoop, pathAddr);
+    {
+        Client client(clientLoop, pathAddr);
+        check(client.echo("restarted") == "restarted", "restart a server on the same path");
+    }
+    runIn(serverLoop, [&]() {
+        server.reset();
+        return 0;
+    });
+
+    // The abstract namespace has no file.
+    auto name = "xiao_unix_test_" + std::to_string(::getpid());
+    auto abstractAddr = InetAddress::fromAbstractName(name);
+    check(abstractAddr.isUnixDomain() && abstractAddr.toIp() == "@" + name,
+          "make an address of an abstract name");
+    server = echoServer(serverLoop, abstractAddr);
+    {
+        Client client(clientLoop, abstractAddr);
+        check(client.echo("over an abstract name") == "over an abstract name",
+              "echo on an abstract name");
+    }
+    runIn(serverLoop, [&]() {
+        server.reset();
+        return 0;
+    });
+
+    ::unlink(path.c_str());
+    ::rmdir(dir);
+    return failures == 0 ? 0 : 1;
+}
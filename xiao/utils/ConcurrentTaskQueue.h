@@ -14,6 +14,11 @@
 #include <xiao/utils/TaskQueue.h>
 #include <xiao/exports.h>
 #include <queue>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 namespace xiao
 {
@@ -0,0 +1,153 @@
+/**
+ * @file CpuAffinity.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/utils/CpuAffinity.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace xiao
+{
+    namespace utils
+    {
+#ifdef __linux__
+        namespace
+        {
+            // MPOL_LOCAL from <linux/mempolicy.h>
+            const int xMpolLocal = 4;
+
+            // Parse a cpulist (also used for node lists) like "0-3,8,10-11".
+            std::vector<int> parseCpuList(const std::string &list)
+            {
+                std::vector<int> cpus;
+                size_t pos = 0;
+                while (pos < list.size())
+                {
+                    size_t next = list.find(',', pos);
+                    if (next == std::string::npos)
+                        next = list.size();
+                    std::string range = list.substr(pos, next - pos);
+                    size_t dash = range.find('-');
+                    try
+                    {
+                        if (dash == std::string::npos)
+                        {
+                            cpus.push_back(std::stoi(range));
+                        }
+                        else
+                        {
+                            int first = std::stoi(range.substr(0, dash));
+                            int last = std::stoi(range.substr(dash + 1));
+                            for (int cpu = first; cpu <= last; ++cpu)
+                                cpus.push_back(cpu);
+                        }
+                    }
+                    catch (const std::exception &)
+                    {
+                        // ignore the trailing newline and malformed ranges
+                    }
+                    pos = next + 1;
+                }
+                return cpus;
+            }
+        } // namespace
+
+        std::vector<std::vector<int>> numaNodeCpus()
+        {
+            cpu_set_t allowed;
+            CPU_ZERO(&allowed);
+            if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            {
+                for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                    CPU_SET(cpu, &allowed);
+            }
+            std::vector<std::vector<int>> nodes;
+            std::string onlineNodes;
+            std::ifstream online("/sys/devices/system/node/online");
+            if (online)
+                std::getline(online, onlineNodes);
+            for (int node : parseCpuList(onlineNodes))
+            {
+                std::ifstream file("/sys/devices/system/node/node" +
+                                   std::to_string(node) + "/cpulist");
+                if (!file)
+                    continue;
+                std::string list;
+                std::getline(file, list);
+                std::vector<int> cpus;
+                for (int cpu : parseCpuList(list))
+                {
+                    if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+                        cpus.push_back(cpu);
+                }
+                if (!cpus.empty())
+                    nodes.push_back(std::move(cpus));
+            }
+            if (nodes.empty())
+            {
+                std::vector<int> cpus;
+                for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                {
+                    if (CPU_ISSET(cpu, &allowed))
+                        cpus.push_back(cpu);
+                }
+                nodes.push_back(std::move(cpus));
+            }
+            return nodes;
+        }
+
+        bool setCurrentThreadCpu(int cpu)
+        {
+            if (cpu < 0 || cpu >= CPU_SETSIZE)
+                return false;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+        }
+
+        bool useLocalNumaMemory()
+        {
+#ifdef SYS_set_mempolicy
+            return syscall(SYS_set_mempolicy, xMpolLocal, nullptr, 0) == 0;
+#else
+            return false;
+#endif
+        }
+#else
+        std::vector<std::vector<int>> numaNodeCpus()
+        {
+            std::vector<int> cpus;
+            unsigned int count = std::max(std::thread::hardware_concurrency(), 1u);
+            for (unsigned int cpu = 0; cpu < count; ++cpu)
+                cpus.push_back(static_cast<int>(cpu));
+            return {cpus};
+        }
+
+        bool setCurrentThreadCpu(int)
+        {
+            return false;
+        }
+
+        bool useLocalNumaMemory()
+        {
+            return false;
+        }
+#endif
+    } // namespace utils
+} // namespace xiao
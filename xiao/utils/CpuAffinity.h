@@ -0,0 +1,50 @@
+/**
+ * @file CpuAffinity.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/exports.h>
+#include <vector>
+
+namespace xiao
+{
+    namespace utils
+    {
+        /**
+         * @brief Get the CPUs this process may run on, grouped by NUMA node.
+         *
+         * @return std::vector<std::vector<int>> The i-th element holds the CPUs
+         * of the i-th node that has any. When the topology is unknown, all the
+         * CPUs are returned as a single node.
+         */
+        XIAO_EXPORT std::vector<std::vector<int>> numaNodeCpus();
+
+        /**
+         * @brief Pin the current thread to a CPU.
+         *
+         * @param cpu
+         * @return true if the thread is pinned.
+         * @return false if it failed or the platform does not support it.
+         */
+        XIAO_EXPORT bool setCurrentThreadCpu(int cpu);
+
+        /**
+         * @brief Make the memory allocated by the current thread come from the
+         * NUMA node of the CPU it runs on, even when the kernel would default
+         * to another policy.
+         *
+         * @return true if the policy is set.
+         * @return false if it failed or the platform does not support it.
+         * @note Call it after setCurrentThreadCpu(), the policy affects pages
+         * first touched afterwards.
+         */
+        XIAO_EXPORT bool useLocalNumaMemory();
+    } // namespace utils
+} // namespace xiao
@@ -12,6 +12,7 @@
 #include "Funcs.h"
 #include <iostream>
 #include <chrono>
+#include <string.h>
 
 namespace xiao
 {
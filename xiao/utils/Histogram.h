@@ -0,0 +1,141 @@
+/**
+ * @file Histogram.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/exports.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace xiao
+{
+    /**
+     * @brief This class implements a histogram with power-of-two buckets. The
+     * bucket i counts the samples in [2^(i-1), 2^i), the bucket 0 counts the
+     * zero samples and the last bucket counts everything above.
+     *
+     * @note There must be only one writer (usually the thread of an event
+     * loop), so a sample costs a few relaxed loads and stores and no locked
+     * instruction. Any thread can take a snapshot at any time, the snapshot is
+     * not atomic as a whole but each field is consistent.
+     */
+    class XIAO_EXPORT Histogram : public NonCopyable
+    {
+    public:
+        static constexpr size_t xBucketCount = 40;
+
+        /**
+         * @brief A copy of the histogram that can be inspected freely.
+         *
+         */
+        struct Snapshot
+        {
+            uint64_t count{0};
+            uint64_t sum{0};
+            uint64_t max{0};
+            std::array<uint64_t, xBucketCount> buckets{};
+
+            double mean() const
+            {
+                return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+            }
+
+            /**
+             * @brief Return the upper bound of the bucket which contains the
+             * given percentile.
+             *
+             * @param p The percentile in [0, 100].
+             * @return uint64_t
+             */
+            uint64_t percentile(double p) const
+            {
+                if (count == 0)
+                    return 0;
+                auto rank = static_cast<uint64_t>(p / 100.0 * count);
+                if (rank >= count)
+                    rank = count - 1;
+                uint64_t seen = 0;
+                for (size_t i = 0; i < xBucketCount; ++i)
+                {
+                    seen += buckets[i];
+                    if (seen > rank)
+                    {
+                        return i == 0 ? 0 : ((uint64_t(1) << i) - 1);
+                    }
+                }
+                return max;
+            }
+        };
+
+        /**
+         * @brief Record a sample. Only one thread may call this method.
+         *
+         * @param value
+         */
+        void record(uint64_t value)
+        {
+            increase(buckets_[bucketOf(value)], 1);
+            increase(count_, 1);
+            increase(sum_, value);
+            if (value > max_.load(std::memory_order_relaxed))
+                max_.store(value, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Take a snapshot of the histogram. This method can be called in
+         * any thread.
+         *
+         * @return Snapshot
+         */
+        Snapshot snapshot() const
+        {
+            Snapshot s;
+            s.count = count_.load(std::memory_order_relaxed);
+            s.sum = sum_.load(std::memory_order_relaxed);
+            s.max = max_.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < xBucketCount; ++i)
+            {
+                s.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+            }
+            return s;
+        }
+
+        static size_t bucketOf(uint64_t value)
+        {
+            size_t bits = 0;
+#if defined __GNUC__ || defined __clang__
+            if (value)
+                bits = 64 - static_cast<size_t>(__builtin_clzll(value));
+#else
+            while (value)
+            {
+                ++bits;
+                value >>= 1;
+            }
+#endif
+            return bits < xBucketCount ? bits : xBucketCount - 1;
+        }
+
+    private:
+        static void increase(std::atomic<uint64_t> &counter, uint64_t n)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + n,
+                          std::memory_order_relaxed);
+        }
+
+        std::array<std::atomic<uint64_t>, xBucketCount> buckets_{};
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> sum_{0};
+        std::atomic<uint64_t> max_{0};
+    };
+} // namespace xiao
@@ -103,4 +103,99 @@ namespace xiao
         std::atomic<BufferNode *> head_;
         std::atomic<BufferNode *> tail_;
     };
+
+    /**
+     * @brief The link embedded in the items of an IntrusiveMpscQueue.
+     *
+     */
+    struct MpscHook
+    {
+        std::atomic<MpscHook *> mpscNext_{nullptr};
+    };
+
+    /**
+     * @brief This class template represents a lock-free multiple producers
+     * single consumer queue of items linked through the MpscHook they derive
+     * from, so queuing an item doesn't allocate.
+     *
+     * @tparam T the type of the items, derived from MpscHook.
+     * @note An item can be in the queue once at a time, and must outlive its
+     * stay in the queue. A dequeue() racing with an enqueue() may not see the
+     * item yet, the producer is expected to wake the consumer up after it.
+     */
+    template <typename T>
+    class IntrusiveMpscQueue : public NonCopyable
+    {
+    public:
+        IntrusiveMpscQueue() : head_(&stub_), tail_(&stub_)
+        {
+        }
+
+        /**
+         * @brief Put an item into the queue
+         *
+         * @param item
+         * @note This method can be called in multiple threads.
+         */
+        void enqueue(T *item)
+        {
+            push(item);
+        }
+
+        /**
+         * @brief Get an item from the queue
+         *
+         * @return T* nullptr if the queue is empty.
+         * @note This method must be called in a single thread.
+         */
+        T *dequeue()
+        {
+            MpscHook *tail = tail_;
+            MpscHook *next = tail->mpscNext_.load(std::memory_order_acquire);
+            if (tail == &stub_)
+            {
+                if (next == nullptr)
+                    return nullptr;
+                tail_ = next;
+                tail = next;
+                next = next->mpscNext_.load(std::memory_order_acquire);
+            }
+            if (next != nullptr)
+            {
+                tail_ = next;
+                return static_cast<T *>(tail);
+            }
+            // The last item is only taken once another one follows it, the
+            // stub is queued behind it for that.
+            if (tail != head_.load(std::memory_order_acquire))
+                return nullptr;
+            push(&stub_);
+            next = tail->mpscNext_.load(std::memory_order_acquire);
+            if (next != nullptr)
+            {
+                tail_ = next;
+                return static_cast<T *>(tail);
+            }
+            return nullptr;
+        }
+
+        bool empty() const
+        {
+            return tail_ == &stub_ &&
+                   stub_.mpscNext_.load(std::memory_order_acquire) == nullptr;
+        }
+
+    private:
+        void push(MpscHook *node)
+        {
+            node->mpscNext_.store(nullptr, std::memory_order_relaxed);
+            MpscHook *prev = head_.exchange(node, std::memory_order_acq_rel);
+            prev->mpscNext_.store(node, std::memory_order_release);
+        }
+
+        MpscHook stub_;
+        std::atomic<MpscHook *> head_;
+        // Only used by the consumer.
+        MpscHook *tail_;
+    };
 }
\ No newline at end of file
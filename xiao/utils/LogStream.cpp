@@ -9,6 +9,10 @@
  *
  */
 #include <xiao/utils/LogStream.h>
+#include <algorithm>
+#include <limits>
+#include <stdint.h>
+#include <stdio.h>
 
 using namespace xiao;
 using namespace xiao::detail;
@@ -62,17 +66,13 @@ namespace xiao
 
             return p - buf;
         }
-
-        // 显示实例化
-        template class FixedBuffer<kSmallBuffer>;
-        template class FixedBuffer<kLargeBuffer>;
     }
 }
 
 template <int SIZE>
 const char *FixedBuffer<SIZE>::debugString()
 {
-    *cur = '\0';
+    *cur_ = '\0';
     return data_;
 }
 
@@ -86,6 +86,16 @@ void FixedBuffer<SIZE>::cookieEnd()
 {
 }
 
+namespace xiao
+{
+    namespace detail
+    {
+        // 显示实例化
+        template class FixedBuffer<kSmallBuffer>;
+        template class FixedBuffer<kLargeBuffer>;
+    }
+}
+
 template <typename T>
 void LogStream::formatInteger(T v)
 {
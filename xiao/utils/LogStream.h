@@ -14,6 +14,8 @@
 #include <xiao/utils/NonCopyable.h>
 #include <xiao/exports.h>
 
+#include <cassert>
+#include <cstring>
 #include <string>
 
 namespace xiao
@@ -76,7 +78,7 @@ namespace xiao
             }
             void zeroBuffer()
             {
-                memset(data_, 0, sizeof(data_))；
+                memset(data_, 0, sizeof(data_));
             }
 
             // for used by GDB
@@ -11,6 +11,17 @@
 
 #include <xiao/utils/Logger.h>
 #include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined _WIN32
+#include <windows.h>
+#else
+#include <thread>
+#endif
 
 namespace xiao
 {
@@ -99,4 +110,152 @@ void Logger::formatTime()
         }
     }
     logStream_ << T(lastTimeString_, 17);
-}
\ No newline at end of file
+    char tmp[32];
+    if (displayLocalTime_())
+    {
+        snprintf(tmp, sizeof(tmp), ".%06llu ", static_cast<long long unsigned int>(microSec));
+        logStream_ << T(tmp, 8);
+    }
+    else
+    {
+        snprintf(tmp,
+                 sizeof(tmp),
+                 ".%06llu UTC ",
+                 static_cast<long long unsigned int>(microSec));
+        logStream_ << T(tmp, 12);
+    }
+    if (threadId_ == 0)
+    {
+#ifdef __linux__
+        threadId_ = static_cast<pid_t>(::syscall(SYS_gettid));
+#elif defined _WIN32
+        threadId_ = GetCurrentThreadId();
+#else
+        threadId_ = std::hash<std::thread::id>()(std::this_thread::get_id());
+#endif
+    }
+    logStream_ << threadId_;
+}
+
+static const char *logLevelStr[Logger::LogLevel::xNumberofLogLevels] = {
+    " TRACE ",
+    " DEBUG ",
+    " INFO  ",
+    " WARN  ",
+    " ERROR ",
+    " FATAL ",
+};
+
+Logger::Logger(SourceFile file, int line)
+    : sourceFile_(file), fileLine_(line), level_(xInfo)
+{
+    formatTime();
+    logStream_ << T(logLevelStr[level_], 7);
+}
+
+Logger::Logger(SourceFile file, int line, LogLevel level)
+    : sourceFile_(file), fileLine_(line), level_(level)
+{
+    formatTime();
+    logStream_ << T(logLevelStr[level_], 7);
+}
+
+Logger::Logger(SourceFile file, int line, LogLevel level, const char *func)
+    : sourceFile_(file), fileLine_(line), level_(level)
+{
+    formatTime();
+    logStream_ << T(logLevelStr[level_], 7) << "[" << func << "] ";
+}
+
+Logger::Logger(SourceFile file, int line, bool)
+    : sourceFile_(file), fileLine_(line), level_(xError)
+{
+    int savedErrno = errno;
+    formatTime();
+    logStream_ << T(logLevelStr[level_], 7);
+    if (savedErrno != 0)
+    {
+        logStream_ << strerror_tl(savedErrno) << " (errno=" << savedErrno << ") ";
+    }
+}
+
+Logger::Logger() : level_(xInfo)
+{
+    formatTime();
+    logStream_ << T(logLevelStr[level_], 7);
+}
+
+Logger::Logger(LogLevel level) : level_(level)
+{
+    formatTime();
+    logStream_ << T(logLevelStr[level_], 7);
+}
+
+Logger::Logger(bool) : level_(xError)
+{
+    int savedErrno = errno;
+    formatTime();
+    logStream_ << T(logLevelStr[level_], 7);
+    if (savedErrno != 0)
+    {
+        logStream_ << strerror_tl(savedErrno) << " (errno=" << savedErrno << ") ";
+    }
+}
+
+RawLogger::~RawLogger()
+{
+    auto &oFunc = index_ < 0 ? Logger::outputFunc_()
+                             : Logger::outputFunc_(static_cast<size_t>(index_));
+    if (!oFunc)
+        return;
+    oFunc(logStream_.bufferData(), logStream_.bufferLength());
+}
+
+Logger::~Logger()
+{
+    if (sourceFile_.data_)
+        logStream_ << T(" - ", 3) << sourceFile_ << ':' << fileLine_ << '\n';
+    else
+        logStream_ << '\n';
+    auto &oFunc = index_ < 0 ? Logger::outputFunc_()
+                             : Logger::outputFunc_(static_cast<size_t>(index_));
+    if (!oFunc)
+        return;
+    oFunc(logStream_.bufferData(), logStream_.bufferLength());
+    if (level_ >= xError)
+    {
+        auto &fFunc = index_ < 0 ? Logger::flushFunc_()
+                                 : Logger::flushFunc_(static_cast<size_t>(index_));
+        if (fFunc)
+            fFunc();
+    }
+}
+
+LogStream &Logger::stream()
+{
+    return logStream_;
+}
+
+bool Logger::hasSpdLogSupport()
+{
+    return false;
+}
+
+// xiao is built without spdlog, these are no-ops.
+void Logger::enableSpdLog(int, std::shared_ptr<spdlog::logger>)
+{
+}
+
+void Logger::disableSpdLog(int)
+{
+}
+
+std::shared_ptr<spdlog::logger> Logger::getSpdLogger(int)
+{
+    return nullptr;
+}
+
+std::shared_ptr<spdlog::logger> Logger::getDefaultSpdLogger(int)
+{
+    return nullptr;
+}
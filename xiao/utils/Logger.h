@@ -15,8 +15,11 @@
 #include <xiao/utils/Date.h>
 #include <xiao/exports.h>
 #include <xiao/utils/LogStream.h>
+#include <cstdio>
+#include <cstring>
 #include <functional>
 #include <memory>
+#include <vector>
 
 namespace spdlog
 {
@@ -52,6 +55,10 @@ namespace xiao
         class SourceFile
         {
         public:
+            SourceFile() : data_(nullptr), size_(0)
+            {
+            }
+
             template <int N>
             inline SourceFile(const char (&arr)[N]) : data_(arr), size_(N - 1)
             {
@@ -139,7 +146,7 @@ namespace xiao
          */
         static bool displayLocalTime()
         {
-            return displayLocalTime_;
+            return displayLocalTime_();
         }
 
         /**
@@ -311,6 +318,8 @@ namespace xiao
         friend class RawLogger;
         LogStream logStream_;
         Date date_{Date::now()};
+        SourceFile sourceFile_;
+        int fileLine_{0};
         LogLevel level_;
         int index_{-1};
     };
@@ -335,10 +344,28 @@ namespace xiao
 
 #ifdef NDEBUG
 #define LOG_TRACE                                                    \
-    XIAO_IF(0)                                                       \
+    XIAO_IF_(0)                                                      \
     xiao::Logger(__FILE__, __LINE__, xiao::Logger::xTrace, __func__) \
         .stream()
 
 #else
+#define LOG_TRACE                                                    \
+    XIAO_IF_(xiao::Logger::logLevel() <= xiao::Logger::xTrace)       \
+    xiao::Logger(__FILE__, __LINE__, xiao::Logger::xTrace, __func__) \
+        .stream()
 #endif
+#define LOG_DEBUG                                                    \
+    XIAO_IF_(xiao::Logger::logLevel() <= xiao::Logger::xDebug)       \
+    xiao::Logger(__FILE__, __LINE__, xiao::Logger::xDebug, __func__) \
+        .stream()
+#define LOG_INFO                                               \
+    XIAO_IF_(xiao::Logger::logLevel() <= xiao::Logger::xInfo)  \
+    xiao::Logger(__FILE__, __LINE__).stream()
+#define LOG_WARN \
+    xiao::Logger(__FILE__, __LINE__, xiao::Logger::xWarn).stream()
+#define LOG_ERROR \
+    xiao::Logger(__FILE__, __LINE__, xiao::Logger::xError).stream()
+#define LOG_FATAL \
+    xiao::Logger(__FILE__, __LINE__, xiao::Logger::xFatal).stream()
+#define LOG_SYSERR xiao::Logger(__FILE__, __LINE__, true).stream()
 }
\ No newline at end of file
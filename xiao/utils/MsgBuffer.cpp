@@ -0,0 +1,280 @@
+/**
+ * @file MsgBuffer.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/utils/MsgBuffer.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#include <sys/uio.h>
+#endif
+
+namespace xiao
+{
+    namespace
+    {
+        // The space always reserved in front of the data.
+        const size_t xBufferOffset{8};
+        // The stack area readFd() spills into.
+        const size_t xExtraBufferSize{65536};
+        // A buffer grown beyond this size by a burst is released when it is
+        // emptied, so idle connections do not keep it.
+        const size_t xMaxKeptSize{4 * xExtraBufferSize};
+    } // namespace
+
+    MsgBuffer::MsgBuffer(size_t len)
+        : head_(xBufferOffset), initCap_(len), buffer_(len + head_), tail_(head_)
+    {
+    }
+
+    void MsgBuffer::compact()
+    {
+        size_t readable = readableBytes();
+        memmove(begin() + xBufferOffset, begin() + head_, readable);
+        head_ = xBufferOffset;
+        tail_ = head_ + readable;
+    }
+
+    void MsgBuffer::ensureWritableBytes(size_t len)
+    {
+        if (writableBytes() >= len)
+            return;
+        size_t readable = readableBytes();
+        // Moving the data is cheaper than growing when the space freed in
+        // front is enough, and it only happens once the back is full.
+        if (head_ - xBufferOffset + writableBytes() >= len)
+        {
+            compact();
+            return;
+        }
+        size_t newLen = (std::max)(buffer_.size() * 2, xBufferOffset + readable + len);
+        if (newLen <= buffer_.capacity())
+        {
+            compact();
+            buffer_.resize(newLen);
+            return;
+        }
+        // Copy the data only, not the consumed bytes in front of it.
+        std::vector<char> newBuffer(newLen);
+        memcpy(newBuffer.data() + xBufferOffset, peek(), readable);
+        buffer_.swap(newBuffer);
+        head_ = xBufferOffset;
+        tail_ = head_ + readable;
+    }
+
+    void MsgBuffer::swap(MsgBuffer &buf) noexcept
+    {
+        buffer_.swap(buf.buffer_);
+        std::swap(head_, buf.head_);
+        std::swap(tail_, buf.tail_);
+        std::swap(initCap_, buf.initCap_);
+    }
+
+    void MsgBuffer::append(const MsgBuffer &buf)
+    {
+        append(buf.peek(), buf.readableBytes());
+    }
+
+    void MsgBuffer::append(const char *buf, size_t len)
+    {
+        ensureWritableBytes(len);
+        memcpy(begin() + tail_, buf, len);
+        tail_ += len;
+    }
+
+    void MsgBuffer::appendInt16(const uint16_t s)
+    {
+        uint16_t ss = htons(s);
+        append(static_cast<const char *>((void *)&ss), 2);
+    }
+
+    void MsgBuffer::appendInt32(const uint32_t i)
+    {
+        uint32_t ii = htonl(i);
+        append(static_cast<const char *>((void *)&ii), 4);
+    }
+
+    void MsgBuffer::appendInt64(const uint64_t l)
+    {
+        uint64_t ll = hton64(l);
+        append(static_cast<const char *>((void *)&ll), 8);
+    }
+
+    void MsgBuffer::addInFront(const char *buf, size_t len)
+    {
+        if (head_ >= len)
+        {
+            memcpy(begin() + head_ - len, buf, len);
+            head_ -= len;
+            return;
+        }
+        if (len <= writableBytes())
+        {
+            memmove(begin() + head_ + len, begin() + head_, readableBytes());
+            memcpy(begin() + head_, buf, len);
+            tail_ += len;
+            return;
+        }
+        size_t newLen = (std::max)(initCap_, len + readableBytes());
+        MsgBuffer newBuf(newLen);
+        newBuf.append(buf, len);
+        newBuf.append(*this);
+        swap(newBuf);
+    }
+
+    void MsgBuffer::addInFrontInt16(const uint16_t s)
+    {
+        uint16_t ss = htons(s);
+        addInFront(static_cast<const char *>((void *)&ss), 2);
+    }
+
+    void MsgBuffer::addInFrontInt32(const uint32_t i)
+    {
+        uint32_t ii = htonl(i);
+        addInFront(static_cast<const char *>((void *)&ii), 4);
+    }
+
+    void MsgBuffer::addInFrontInt64(const uint64_t l)
+    {
+        uint64_t ll = hton64(l);
+        addInFront(static_cast<const char *>((void *)&ll), 8);
+    }
+
+    uint16_t MsgBuffer::peekInt16() const
+    {
+        assert(readableBytes() >= 2);
+        uint16_t rs;
+        memcpy(&rs, peek(), 2);
+        return ntohs(rs);
+    }
+
+    uint32_t MsgBuffer::peekInt32() const
+    {
+        assert(readableBytes() >= 4);
+        uint32_t rl;
+        memcpy(&rl, peek(), 4);
+        return ntohl(rl);
+    }
+
+    uint64_t MsgBuffer::peekInt64() const
+    {
+        assert(readableBytes() >= 8);
+        uint64_t rll;
+        memcpy(&rll, peek(), 8);
+        return ntoh64(rll);
+    }
+
+    std::string MsgBuffer::read(size_t len)
+    {
+        if (len > readableBytes())
+            len = readableBytes();
+        std::string ret(peek(), len);
+        retrieve(len);
+        return ret;
+    }
+
+    uint8_t MsgBuffer::readInt8()
+    {
+        uint8_t ret = peekInt8();
+        retrieve(1);
+        return ret;
+    }
+
+    uint16_t MsgBuffer::readInt16()
+    {
+        uint16_t ret = peekInt16();
+        retrieve(2);
+        return ret;
+    }
+
+    uint32_t MsgBuffer::readInt32()
+    {
+        uint32_t ret = peekInt32();
+        retrieve(4);
+        return ret;
+    }
+
+    uint64_t MsgBuffer::readInt64()
+    {
+        uint64_t ret = peekInt64();
+        retrieve(8);
+        return ret;
+    }
+
+    void MsgBuffer::retrieveAll()
+    {
+        if (buffer_.size() > (std::max)(initCap_ * 2, xMaxKeptSize))
+        {
+            std::vector<char>(initCap_ + xBufferOffset).swap(buffer_);
+        }
+        tail_ = head_ = xBufferOffset;
+    }
+
+    void MsgBuffer::retrieve(size_t len)
+    {
+        if (len >= readableBytes())
+        {
+            retrieveAll();
+            return;
+        }
+        head_ += len;
+    }
+
+    ssize_t MsgBuffer::readFd(int fd, int *retErrno)
+    {
+        // Reclaim the consumed space in front when it is at least as large as
+        // the data to move, so the copies cost no more than the reads did.
+        if (head_ > xBufferOffset && head_ - xBufferOffset >= readableBytes())
+            compact();
+        char extBuffer[xExtraBufferSize];
+        size_t writable = writableBytes();
+#ifdef _WIN32
+        // A zero length recv() would look like the end of the stream.
+        if (writable == 0)
+        {
+            ensureWritableBytes(1);
+            writable = writableBytes();
+        }
+        ssize_t n = ::recv(fd, begin() + tail_, static_cast<int>(writable), 0);
+        if (n == static_cast<ssize_t>(writable))
+        {
+            auto m = ::recv(fd, extBuffer, static_cast<int>(sizeof(extBuffer)), 0);
+            if (m > 0)
+                n += m;
+        }
+        if (n < 0)
+            *retErrno = WSAGetLastError();
+#else
+        struct iovec vec[2];
+        vec[0].iov_base = begin() + tail_;
+        vec[0].iov_len = writable;
+        vec[1].iov_base = extBuffer;
+        vec[1].iov_len = sizeof(extBuffer);
+        const int iovcnt = (writable < sizeof(extBuffer)) ? 2 : 1;
+        ssize_t n = ::readv(fd, vec, iovcnt);
+        if (n < 0)
+            *retErrno = errno;
+#endif
+        if (n <= 0)
+            return n;
+        if (static_cast<size_t>(n) <= writable)
+        {
+            tail_ += n;
+        }
+        else
+        {
+            tail_ = buffer_.size();
+            append(extBuffer, n - writable);
+        }
+        return n;
+    }
+} // namespace xiao
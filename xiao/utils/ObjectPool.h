@@ -0,0 +1,237 @@
+/**
+ * @file ObjectPool.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <xiao/utils/NonCopyable.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace xiao
+{
+    /**
+     * @brief This class template keeps the released objects to reuse them,
+     * together with the control blocks of the shared pointers to them, so that
+     * getting an object doesn't allocate once the pool is warmed up.
+     *
+     * @tparam T the type of the objects in the pool.
+     * @note A pool is meant to be used in one event loop, the objects can be
+     * released in any thread. The objects released after the pool is
+     * destroyed are deleted.
+     */
+    template <typename T>
+    class ObjectPool : public NonCopyable
+    {
+    public:
+        /**
+         * @brief Called with an object released, before it is kept in the
+         * pool. Return false to delete the object instead.
+         */
+        using RecycleCallback = std::function<bool(T *)>;
+
+        /**
+         * @brief Construct a new pool.
+         *
+         * @param maxIdle The maximum number of idle objects kept.
+         * @param cb
+         */
+        explicit ObjectPool(size_t maxIdle = 1024, RecycleCallback cb = RecycleCallback())
+            : storage_(std::make_shared<Storage>(maxIdle, std::move(cb)))
+        {
+        }
+        ~ObjectPool()
+        {
+            storage_->close();
+        }
+
+        /**
+         * @brief Get an idle object, or a new one if there is none.
+         *
+         * @param create Return a new object allocated by new.
+         * @param reuse Called with an idle object to prepare it for the caller.
+         * @return std::shared_ptr<T> The object returns to the pool when the
+         * last shared pointer to it is released.
+         */
+        template <typename Create, typename Reuse>
+        std::shared_ptr<T> getObject(Create &&create, Reuse &&reuse)
+        {
+            static_assert(!std::is_pointer<T>::value,
+                          "The parameter type of the ObjectPool template can't be pointer type");
+            T *p = storage_->take();
+            if (p)
+                reuse(p);
+            else
+                p = create();
+            return std::shared_ptr<T>(p, Recycler{storage_}, BlockAllocator<T>(storage_));
+        }
+        std::shared_ptr<T> getObject()
+        {
+            return getObject([]() { return new T; }, [](T *) {});
+        }
+
+        /**
+         * @brief Get the number of idle objects in the pool.
+         *
+         * @return size_t
+         */
+        size_t idleCount() const
+        {
+            std::lock_guard<std::mutex> lock(storage_->mutex_);
+            return storage_->idle_.size();
+        }
+
+    private:
+        // Shared with the deleters and the allocators of the control blocks,
+        // which can outlive the pool.
+        struct Storage
+        {
+            Storage(size_t maxIdle, RecycleCallback cb)
+                : maxIdle_(maxIdle), recycleCallback_(std::move(cb))
+            {
+            }
+            ~Storage()
+            {
+                for (auto p : idle_)
+                    delete p;
+                for (auto block : blocks_)
+                    ::operator delete(block);
+            }
+
+            T *take()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (idle_.empty())
+                    return nullptr;
+                T *p = idle_.back();
+                idle_.pop_back();
+                return p;
+            }
+            void release(T *p)
+            {
+                if (!recycleCallback_ || recycleCallback_(p))
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!closed_ && idle_.size() < maxIdle_)
+                    {
+                        idle_.push_back(p);
+                        return;
+                    }
+                }
+                delete p;
+            }
+            void close()
+            {
+                std::vector<T *> idle;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    closed_ = true;
+                    idle.swap(idle_);
+                }
+                // Outside the lock, deleting an object can release a block.
+                for (auto p : idle)
+                    delete p;
+            }
+
+            // All the control blocks have the same size, the first one
+            // allocated gives it.
+            void *allocate(size_t bytes)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (blockSize_ == 0)
+                        blockSize_ = bytes;
+                    if (bytes == blockSize_ && !blocks_.empty())
+                    {
+                        void *block = blocks_.back();
+                        blocks_.pop_back();
+                        return block;
+                    }
+                }
+                return ::operator new(bytes);
+            }
+            void deallocate(void *block, size_t bytes)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (bytes == blockSize_ && blocks_.size() < maxIdle_)
+                    {
+                        blocks_.push_back(block);
+                        return;
+                    }
+                }
+                ::operator delete(block);
+            }
+
+            std::mutex mutex_;
+            std::vector<T *> idle_;
+            std::vector<void *> blocks_;
+            size_t blockSize_{0};
+            const size_t maxIdle_;
+            bool closed_{false};
+            RecycleCallback recycleCallback_;
+        };
+
+        struct Recycler
+        {
+            std::shared_ptr<Storage> storage_;
+            void operator()(T *p) const
+            {
+                storage_->release(p);
+            }
+        };
+
+        template <typename U>
+        struct BlockAllocator
+        {
+            using value_type = U;
+            template <typename V>
+            struct rebind
+            {
+                using other = BlockAllocator<V>;
+            };
+
+            explicit BlockAllocator(const std::shared_ptr<Storage> &storage)
+                : storage_(storage)
+            {
+            }
+            template <typename V>
+            BlockAllocator(const BlockAllocator<V> &other) : storage_(other.storage_)
+            {
+            }
+            U *allocate(size_t n)
+            {
+                return static_cast<U *>(storage_->allocate(n * sizeof(U)));
+            }
+            void deallocate(U *p, size_t n)
+            {
+                storage_->deallocate(p, n * sizeof(U));
+            }
+            template <typename V>
+            bool operator==(const BlockAllocator<V> &other) const
+            {
+                return storage_ == other.storage_;
+            }
+            template <typename V>
+            bool operator!=(const BlockAllocator<V> &other) const
+            {
+                return storage_ != other.storage_;
+            }
+
+            std::shared_ptr<Storage> storage_;
+        };
+
+        std::shared_ptr<Storage> storage_;
+    };
+} // namespace xiao
@@ -26,7 +26,7 @@ namespace xiao
     {
     public:
         virtual void runTaskInQueue(const std::function<void()> &task) = 0;
-        virtual void runTaskInQueue(std::function<void> &&task) = 0;
+        virtual void runTaskInQueue(std::function<void()> &&task) = 0;
         virtual std::string getName() const
         {
             return "";
@@ -0,0 +1,88 @@
+/**
+ * @file TimingWheel.cpp
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <xiao/utils/TimingWheel.h>
+#include <assert.h>
+#include <math.h>
+
+namespace xiao
+{
+    TimingWheel::TimingWheel(EventLoop *loop, double timeout, double ticksInterval)
+        : loop_(loop)
+    {
+        assert(timeout > 0);
+        assert(ticksInterval > 0);
+        timeoutTicks_ = static_cast<uint64_t>(ceil(timeout / ticksInterval));
+        if (timeoutTicks_ == 0)
+            timeoutTicks_ = 1;
+        // A deadline is at most timeoutTicks_ + 1 ticks ahead, its bucket
+        // comes before the current one comes again.
+        buckets_.resize(timeoutTicks_ + 2);
+        timerId_ = loop_->runEvery(ticksInterval, [this]() { onTick(); });
+    }
+
+    TimingWheel::~TimingWheel()
+    {
+        loop_->assertInLoopThread();
+        loop_->invalidateTimer(timerId_);
+        for (auto &bucket : buckets_)
+        {
+            for (auto &slot : bucket)
+            {
+                // The entries of the objects still alive stop refreshing.
+                auto obj = slot.obj_.lock();
+                if (obj && slot.entry_->wheel_ == this)
+                    slot.entry_->wheel_ = nullptr;
+            }
+        }
+    }
+
+    void TimingWheel::insertEntry(const EntryPtr &obj, Entry *entry)
+    {
+        loop_->assertInLoopThread();
+        assert(!entry->wheel_);
+        entry->wheel_ = this;
+        entry->deadline_ = deadline();
+        buckets_[entry->deadline_ % buckets_.size()].push_back(Slot{obj, entry});
+        ++size_;
+    }
+
+    void TimingWheel::onTick()
+    {
+        ++tick_;
+        due_.swap(buckets_[tick_ % buckets_.size()]);
+        for (auto &slot : due_)
+        {
+            auto obj = slot.obj_.lock();
+            if (!obj || slot.entry_->wheel_ != this)
+            {
+                --size_;
+                continue;
+            }
+            auto deadline = slot.entry_->deadline_;
+            if (deadline > tick_)
+            {
+                // Refreshed since it was put in this bucket.
+                buckets_[deadline % buckets_.size()].push_back(std::move(slot));
+                continue;
+            }
+            --size_;
+            slot.entry_->wheel_ = nullptr;
+            expired_.push_back(std::move(obj));
+        }
+        due_.clear();
+        if (expired_.empty())
+            return;
+        if (expireCallback_)
+            expireCallback_(expired_);
+        expired_.clear();
+    }
+} // namespace xiao
@@ -0,0 +1,139 @@
+/**
+ * @file TimingWheel.h
+ * @author xiao guo
+ * @brief
+ * @version 0.1
+ * @date 2024-05-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <xiao/net/EventLoop.h>
+#include <xiao/utils/NonCopyable.h>
+#include <xiao/exports.h>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+namespace xiao
+{
+    /**
+     * @brief This class expires the objects idle for a timeout, with one
+     * timer for all of them. The wheel keeps weak pointers to the objects in
+     * buckets, one per tick of the timeout. The objects keep an entry, which
+     * is refreshed by setting its deadline, the entries are only moved to the
+     * bucket of their deadline when the tick of their former bucket comes.
+     *
+     * @note All the methods, including the refreshing of the entries, must be
+     * called in the loop of the wheel.
+     */
+    class XIAO_EXPORT TimingWheel : NonCopyable
+    {
+    public:
+        /**
+         * @brief The state of an object in the wheel, a member of the object.
+         *
+         */
+        class Entry
+        {
+        public:
+            /**
+             * @brief Restart the timeout of the object, O(1).
+             *
+             */
+            void refresh()
+            {
+                if (wheel_)
+                    deadline_ = wheel_->deadline();
+            }
+            bool inWheel() const
+            {
+                return wheel_ != nullptr;
+            }
+
+        private:
+            friend class TimingWheel;
+            TimingWheel *wheel_{nullptr};
+            uint64_t deadline_{0};
+        };
+
+        using EntryPtr = std::shared_ptr<void>;
+
+        /**
+         * @brief Called once per tick with the objects expired in the tick.
+         *
+         */
+        using ExpireCallback = std::function<void(const std::vector<EntryPtr> &)>;
+
+        /**
+         * @brief Construct a new timing wheel.
+         *
+         * @param loop
+         * @param timeout The idle time after which an object expires, in
+         * seconds.
+         * @param ticksInterval The resolution of the timeout, in seconds.
+         */
+        TimingWheel(EventLoop *loop, double timeout, double ticksInterval = 1.0);
+        ~TimingWheel();
+
+        void setExpireCallback(const ExpireCallback &cb)
+        {
+            expireCallback_ = cb;
+        }
+
+        /**
+         * @brief Add an object to the wheel.
+         *
+         * @param obj The owner of the entry, the wheel only keeps a weak
+         * pointer to it.
+         * @param entry The entry of the object, valid as long as the object.
+         */
+        void insertEntry(const EntryPtr &obj, Entry *entry);
+
+        /**
+         * @brief Get the number of objects in the wheel, including the ones
+         * destroyed but not yet removed.
+         *
+         * @return size_t
+         */
+        size_t size() const
+        {
+            return size_;
+        }
+
+        EventLoop *getLoop() const
+        {
+            return loop_;
+        }
+
+    private:
+        struct Slot
+        {
+            std::weak_ptr<void> obj_;
+            Entry *entry_;
+        };
+
+        // The deadline of an object active now. One more tick, as the
+        // current one has partly elapsed.
+        uint64_t deadline() const
+        {
+            return tick_ + timeoutTicks_ + 1;
+        }
+        void onTick();
+
+        EventLoop *loop_;
+        uint64_t timeoutTicks_;
+        uint64_t tick_{0};
+        size_t size_{0};
+        std::vector<std::vector<Slot>> buckets_;
+        // Reused from tick to tick.
+        std::vector<Slot> due_;
+        std::vector<EntryPtr> expired_;
+        ExpireCallback expireCallback_;
+        TimerId timerId_;
+    };
+} // namespace xiao